@@ -0,0 +1,191 @@
+// Measure how collective operations scale with the size of the group.
+//
+// For each group size N (powers of two up to MAX_MEMBERS, plus MAX_MEMBERS
+// itself), N loopback processes are started, each with its own listening
+// engine, and they run ITERATIONS barriers, allgathers of SIZE bytes per
+// member and all-to-all exchanges of SIZE bytes per pair of members. Rank
+// 0 reports the average latency of each operation. Parts larger than
+// engine_config::collectives::eager_limit (64 KiB by default) are exchanged
+// through bulk transfers.
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <hermes.hpp>
+
+#include "rpcs.hpp"
+#include "benchmark.hpp"
+
+namespace {
+
+void
+usage(const char* progname) {
+    std::cerr << "Usage: " << progname
+              << " PROTOCOL://HOST:PORT [MAX_MEMBERS] [ITERATIONS] [SIZE]\n";
+    exit(1);
+}
+
+/** Look up a member that may not be listening yet */
+hermes::endpoint
+lookup_member(hermes::async_engine& hg, const std::string& address) {
+
+    for(int attempt = 0; ; ++attempt) {
+        try {
+            return hg.lookup(address);
+        }
+        catch(const std::exception&) {
+            if(attempt == 500) {
+                throw;
+            }
+
+            ::usleep(10000);
+        }
+    }
+}
+
+void
+member(const bench::server_address& address,
+       std::size_t first_port,
+       std::size_t rank,
+       std::size_t members,
+       std::size_t iterations,
+       std::size_t size,
+       const bench::server_process::notify_function& notify) {
+
+    hermes::async_engine hg(address.m_transport,
+                            hermes::none,
+                            hermes::engine_config(),
+                            address.bind_address(first_port + rank),
+                            true);
+
+    hg.run();
+
+    notify();
+
+    hermes::endpoint_set group;
+
+    for(std::size_t i = 0; i < members; ++i) {
+        group.emplace_back(
+                lookup_member(hg, address.lookup_address(first_port + i)));
+    }
+
+    // warm up connections
+    for(std::size_t i = 0; i < 10; ++i) {
+        hg.barrier(group, rank);
+    }
+
+    auto start = bench::clock::now();
+
+    for(std::size_t i = 0; i < iterations; ++i) {
+        hg.barrier(group, rank);
+    }
+
+    const double barrier_us = bench::seconds_since(start) * 1e6 / iterations;
+
+    start = bench::clock::now();
+
+    for(std::size_t i = 0; i < iterations; ++i) {
+        const auto all = hg.allgather(group, rank, std::vector<char>(size));
+
+        if(all.size() != members) {
+            throw std::runtime_error("Unexpected allgather result");
+        }
+    }
+
+    const double allgather_us =
+        bench::seconds_since(start) * 1e6 / iterations;
+
+    start = bench::clock::now();
+
+    for(std::size_t i = 0; i < iterations; ++i) {
+        const auto parts = hg.alltoall(group, rank,
+                std::vector<std::vector<char>>(members,
+                                               std::vector<char>(size)));
+
+        if(parts.size() != members) {
+            throw std::runtime_error("Unexpected alltoall result");
+        }
+    }
+
+    const double alltoall_us =
+        bench::seconds_since(start) * 1e6 / iterations;
+
+    // make sure nobody leaves while others still need it
+    hg.barrier(group, rank);
+
+    if(rank == 0) {
+        std::printf("%-10s %8zu %10zu %14.2f\n", "barrier", members,
+                    std::size_t(0), barrier_us);
+        std::printf("%-10s %8zu %10zu %14.2f\n", "allgather", members,
+                    size, allgather_us);
+        std::printf("%-10s %8zu %10zu %14.2f\n", "alltoall", members,
+                    size, alltoall_us);
+        std::fflush(stdout);
+    }
+}
+
+} // anonymous namespace
+
+int
+main(int argc, char* argv[]) {
+
+    if(argc < 2) {
+        usage(argv[0]);
+    }
+
+    try {
+        const auto address = bench::parse_address(argv[1]);
+        const auto max_members = bench::numeric_arg(argc, argv, 2, 32);
+        const auto iterations = bench::numeric_arg(argc, argv, 3, 100);
+        const auto size = bench::numeric_arg(argc, argv, 4, 1024);
+
+        if(max_members < 2 || iterations == 0) {
+            usage(argv[0]);
+        }
+
+        std::vector<std::size_t> group_sizes;
+
+        for(std::size_t n = 2; n < max_members; n <<= 1) {
+            group_sizes.push_back(n);
+        }
+
+        group_sizes.push_back(max_members);
+
+        std::printf("%-10s %8s %10s %14s\n", "operation", "members",
+                    "size", "latency(us)");
+        std::fflush(stdout);
+
+        // each group uses its own ports so that they are not reused while
+        // the previous group's connections are being torn down
+        std::size_t first_port = 0;
+
+        for(const auto n : group_sizes) {
+
+            std::vector<std::unique_ptr<bench::server_process>> members;
+
+            for(std::size_t rank = 0; rank < n; ++rank) {
+                members.emplace_back(new bench::server_process(
+                    [&](const bench::server_process::notify_function&
+                            notify) {
+                        member(address, first_port, rank, n, iterations,
+                               size, notify);
+                    }));
+            }
+
+            // wait for the whole group to finish
+            members.clear();
+            first_port += n;
+        }
+    }
+    catch(const std::exception& ex) {
+        std::cerr << ex.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
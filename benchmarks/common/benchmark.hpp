@@ -0,0 +1,209 @@
+#ifndef __HERMES_BENCH_BENCHMARK_HPP__
+#define __HERMES_BENCH_BENCHMARK_HPP__
+
+// C includes
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// C++ includes
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+// hermes includes
+#include <hermes.hpp>
+
+#include "rpcs.hpp"
+
+namespace bench {
+
+using clock = std::chrono::steady_clock;
+
+/** Seconds elapsed since @a start */
+inline double
+seconds_since(const clock::time_point& start) {
+    return std::chrono::duration<double>(clock::now() - start).count();
+}
+
+/**
+ * Address of the loopback servers launched by a benchmark. Since benchmarks
+ * may need several servers (or restart them with different settings), the
+ * i-th server listens on HOST:(PORT + i)
+ */
+struct server_address {
+
+    std::string
+    bind_address(std::size_t i) const {
+        return m_host + ":" + std::to_string(m_port + i);
+    }
+
+    std::string
+    lookup_address(std::size_t i) const {
+        return hermes::get_transport_prefix(m_transport) + bind_address(i);
+    }
+
+    hermes::transport m_transport;
+    std::string m_host;
+    unsigned int m_port;
+};
+
+/** Parse an address in the form PROTOCOL://HOST:PORT */
+inline server_address
+parse_address(const std::string& address) {
+
+    const auto pos = address.find("://");
+    const auto colon = address.rfind(':');
+
+    if(pos == std::string::npos || colon == std::string::npos ||
+       colon < pos + 3) {
+        throw std::invalid_argument("Address '" + address + "' is not in the "
+                                    "form PROTOCOL://HOST:PORT");
+    }
+
+    return {hermes::get_transport_type(address.substr(0, pos)),
+            address.substr(pos + 3, colon - (pos + 3)),
+            static_cast<unsigned int>(std::stoul(address.substr(colon + 1)))};
+}
+
+/** Return argv[i] converted to a number if present, or @a def otherwise */
+inline std::size_t
+numeric_arg(int argc, char* argv[], int i, std::size_t def) {
+    return i < argc ? std::stoul(argv[i]) : def;
+}
+
+/**
+ * A server running in a child process. The constructor forks and runs
+ * @a fn in the child, and only returns once the child has called the
+ * notification function passed to @a fn (i.e. once the server is listening).
+ * The destructor waits for the child to exit, so benchmarks must send it a
+ * shutdown RPC beforehand.
+ *
+ * IMPORTANT: servers must be started before creating any async_engine in
+ * the parent process.
+ */
+class server_process {
+
+public:
+    using notify_function = std::function<void()>;
+
+    template <typename Callable>
+    explicit server_process(Callable&& fn) {
+
+        int fds[2];
+
+        if(::pipe(fds) != 0) {
+            throw std::runtime_error("Failed to create pipe");
+        }
+
+        m_pid = ::fork();
+
+        if(m_pid < 0) {
+            throw std::runtime_error("Failed to fork server process");
+        }
+
+        if(m_pid == 0) {
+            ::close(fds[0]);
+
+            const int fd = fds[1];
+            int rv = 0;
+
+            try {
+                fn(notify_function([fd]() {
+                    const char c = 1;
+                    (void) !::write(fd, &c, 1);
+                }));
+            }
+            catch(const std::exception& ex) {
+                std::fprintf(stderr, "server: %s\n", ex.what());
+                rv = 1;
+            }
+
+            ::close(fd);
+            ::_exit(rv);
+        }
+
+        ::close(fds[1]);
+
+        char c;
+        const auto n = ::read(fds[0], &c, 1);
+        ::close(fds[0]);
+
+        if(n != 1) {
+            wait();
+            throw std::runtime_error("Server process failed to start");
+        }
+    }
+
+    server_process(const server_process&) = delete;
+    server_process& operator=(const server_process&) = delete;
+
+    ~server_process() {
+        wait();
+    }
+
+    void
+    wait() {
+        if(m_pid > 0) {
+            int status;
+            ::waitpid(m_pid, &status, 0);
+            m_pid = -1;
+        }
+    }
+
+private:
+    pid_t m_pid;
+};
+
+/**
+ * Run a listening engine on the i-th server address that answers ping RPCs
+ * until it receives a shutdown RPC
+ */
+inline void
+serve(const server_address& address,
+      std::size_t i,
+      const hermes::engine_config& config,
+      const server_process::notify_function& notify_ready) {
+
+    std::atomic<bool> shutdown_requested(false);
+
+    hermes::async_engine hg(address.m_transport,
+                            hermes::none,
+                            config,
+                            address.bind_address(i),
+                            true);
+
+    hg.register_handler<bench_rpcs::ping>(
+        [&hg](hermes::request<bench_rpcs::ping>&& req) {
+            const auto seqno = req.args_view().seqno;
+            hg.respond<bench_rpcs::ping>(std::move(req), seqno);
+        });
+
+    hg.register_handler<bench_rpcs::shutdown>(
+        [&hg, &shutdown_requested](
+                hermes::request<bench_rpcs::shutdown>&& req) {
+            hg.respond<bench_rpcs::shutdown>(std::move(req), 0);
+            shutdown_requested = true;
+        });
+
+    hg.run();
+
+    notify_ready();
+
+    while(!shutdown_requested) {
+        ::usleep(1000);
+    }
+}
+
+/** Ask a server started with serve() to shut down */
+inline void
+shutdown(hermes::async_engine& hg, const hermes::endpoint& endp) {
+    (void) hg.post<bench_rpcs::shutdown>(endp).get();
+}
+
+} // namespace bench
+
+#endif // __HERMES_BENCH_BENCHMARK_HPP__
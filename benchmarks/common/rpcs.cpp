@@ -0,0 +1,15 @@
+#include <hermes.hpp>
+#include "rpcs.hpp"
+
+namespace hermes { namespace detail {
+
+//==============================================================================
+// register request types so that they can be used by users and the engine
+//
+void
+register_user_request_types() {
+    (void) registered_requests().add<bench_rpcs::ping>();
+    (void) registered_requests().add<bench_rpcs::shutdown>();
+}
+
+}} // namespace hermes::detail
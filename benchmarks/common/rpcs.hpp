@@ -0,0 +1,245 @@
+#ifndef __HERMES_BENCH_RPCS_HPP__
+#define __HERMES_BENCH_RPCS_HPP__
+
+// C includes
+#include <mercury.h>
+#include <mercury_proc_string.h>
+#include <mercury_macros.h>
+
+// C++ includes
+#include <string>
+
+// hermes includes
+#include <hermes.hpp>
+
+#ifndef HG_GEN_PROC_NAME
+#define HG_GEN_PROC_NAME(struct_type_name) \
+    hermes::detail::hg_proc_ ## struct_type_name
+#endif
+
+// forward declarations
+namespace hermes { namespace detail {
+
+template <typename ExecutionContext>
+hg_return_t post_to_mercury(ExecutionContext* ctx);
+
+}} // namespace hermes::detail
+
+//==============================================================================
+// definitions for bench_rpcs::ping
+namespace hermes { namespace detail {
+
+// Generate Mercury types and serialization functions (field names match
+// those defined in ping::input and ping::output). These definitions are
+// internal and should not be used directly. Classes ping::input and
+// ping::output are provided for public use.
+MERCURY_GEN_PROC(ping_in_t,
+        ((hg_uint64_t) (seqno)))
+
+MERCURY_GEN_PROC(ping_out_t,
+        ((hg_uint64_t) (seqno)))
+
+}} // namespace hermes::detail
+
+namespace bench_rpcs {
+
+struct ping {
+
+    // forward declarations of public input/output types for this RPC
+    class input;
+    class output;
+
+    // traits used so that the engine knows what to do with the RPC
+    using self_type = ping;
+    using handle_type = hermes::rpc_handle<self_type>;
+    using input_type = input;
+    using output_type = output;
+    using mercury_input_type = hermes::detail::ping_in_t;
+    using mercury_output_type = hermes::detail::ping_out_t;
+
+    // RPC public identifier
+    constexpr static const uint16_t public_id = 142;
+
+    // RPC internal Mercury identifier
+    constexpr static const uint16_t mercury_id = public_id;
+
+    // RPC name
+    constexpr static const auto name = "ping";
+
+    // requires response?
+    constexpr static const auto requires_response = true;
+
+    // Mercury callback to serialize input arguments
+    constexpr static const auto mercury_in_proc_cb =
+        HG_GEN_PROC_NAME(ping_in_t);
+
+    // Mercury callback to serialize output arguments
+    constexpr static const auto mercury_out_proc_cb =
+        HG_GEN_PROC_NAME(ping_out_t);
+
+
+    class input {
+
+        template <typename ExecutionContext>
+        friend hg_return_t hermes::detail::post_to_mercury(ExecutionContext*);
+
+    public:
+        input(std::uint64_t seqno) :
+            m_seqno(seqno) { }
+
+        std::uint64_t
+        seqno() const {
+            return m_seqno;
+        }
+
+        explicit
+        input(const hermes::detail::ping_in_t& other) :
+            m_seqno(other.seqno) { }
+
+        explicit
+        operator hermes::detail::ping_in_t() {
+            return {m_seqno};
+        }
+
+    private:
+        std::uint64_t m_seqno;
+    };
+
+    class output {
+
+        template <typename ExecutionContext>
+        friend hg_return_t hermes::detail::post_to_mercury(ExecutionContext*);
+
+    public:
+        output(std::uint64_t seqno) :
+            m_seqno(seqno) { }
+
+        std::uint64_t
+        seqno() const {
+            return m_seqno;
+        }
+
+        explicit
+        output(const hermes::detail::ping_out_t& out) {
+            m_seqno = out.seqno;
+        }
+
+        explicit
+        operator hermes::detail::ping_out_t() {
+            return {m_seqno};
+        }
+
+    private:
+        std::uint64_t m_seqno;
+    };
+};
+
+} // namespace bench_rpcs
+
+
+//==============================================================================
+// definitions for bench_rpcs::shutdown
+namespace hermes { namespace detail {
+
+// Generate Mercury types and serialization functions (field names match
+// those defined by shutdown::input and shutdown::output). These
+// definitions are internal and should not be used directly. Classes
+// shutdown::input and shutdown::output are provided for public use.
+MERCURY_GEN_PROC(bench_shutdown_in_t,
+        ((int32_t) (foo)))
+
+MERCURY_GEN_PROC(bench_shutdown_out_t,
+        ((int32_t) (retval)))
+
+}} // namespace hermes::detail
+
+namespace bench_rpcs {
+
+struct shutdown {
+
+    // forward declarations of public input/output types for this RPC
+    class input;
+    class output;
+
+    // traits used so that the engine knows what to do with the RPC
+    using self_type = shutdown;
+    using handle_type = hermes::rpc_handle<self_type>;
+    using input_type = input;
+    using output_type = output;
+    using mercury_input_type = hermes::detail::bench_shutdown_in_t;
+    using mercury_output_type = hermes::detail::bench_shutdown_out_t;
+
+    // RPC public identifier
+    constexpr static const uint16_t public_id = 143;
+
+    // RPC internal Mercury identifier
+    constexpr static const uint16_t mercury_id = public_id;
+
+    // RPC name
+    constexpr static const auto name = "shutdown";
+
+    // requires response? (benchmarks wait for it to make sure that the
+    // server has been notified before destroying their engines)
+    constexpr static const auto requires_response = true;
+
+    // Mercury callback to serialize input arguments
+    constexpr static const auto mercury_in_proc_cb =
+        HG_GEN_PROC_NAME(bench_shutdown_in_t);
+
+    // Mercury callback to serialize output arguments
+    constexpr static const auto mercury_out_proc_cb =
+        HG_GEN_PROC_NAME(bench_shutdown_out_t);
+
+    class input {
+
+        template <typename ExecutionContext>
+        friend hg_return_t hermes::detail::post_to_mercury(ExecutionContext*);
+
+    public:
+        input() { }
+
+        explicit
+        input(const hermes::detail::bench_shutdown_in_t& other) {
+            (void) other;
+        }
+
+        explicit
+        operator hermes::detail::bench_shutdown_in_t() {
+            return {0};
+        }
+    };
+
+    class output {
+
+        template <typename ExecutionContext>
+        friend hg_return_t hermes::detail::post_to_mercury(ExecutionContext*);
+
+    public:
+        output(int32_t retval) :
+            m_retval(retval) { }
+
+        int32_t
+        retval() const {
+            return m_retval;
+        }
+
+        explicit
+        output(const hermes::detail::bench_shutdown_out_t& out) {
+            m_retval = out.retval;
+        }
+
+        explicit
+        operator hermes::detail::bench_shutdown_out_t() {
+            return {m_retval};
+        }
+
+    private:
+        int32_t m_retval;
+    };
+};
+
+} // namespace bench_rpcs
+
+#undef HG_GEN_PROC_NAME
+
+#endif // __HERMES_BENCH_RPCS_HPP__
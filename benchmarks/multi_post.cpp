@@ -0,0 +1,146 @@
+// Compare sending a different input to each of several servers with one
+// post() per server and with a single post_many().
+//
+// NUM_SERVERS loopback servers are started and the client sends ITERATIONS
+// batches of ping RPCs, one per server and each with its own sequence
+// number, and waits for all of their outputs. It reports the average
+// latency of a whole batch for each variant.
+
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <hermes.hpp>
+
+#include "rpcs.hpp"
+#include "benchmark.hpp"
+
+namespace {
+
+void
+usage(const char* progname) {
+    std::cerr << "Usage: " << progname
+              << " PROTOCOL://HOST:PORT [NUM_SERVERS] [ITERATIONS]\n";
+    exit(1);
+}
+
+void
+send_post(hermes::async_engine& hg,
+          const std::vector<hermes::endpoint>& endps,
+          std::size_t seqno) {
+
+    std::vector<hermes::rpc_handle<bench_rpcs::ping>> handles;
+    handles.reserve(endps.size());
+
+    for(std::size_t i = 0; i < endps.size(); ++i) {
+        handles.emplace_back(hg.post<bench_rpcs::ping>(endps[i], seqno + i));
+    }
+
+    for(std::size_t i = 0; i < handles.size(); ++i) {
+        if(handles[i].get().at(0).seqno() != seqno + i) {
+            throw std::runtime_error("Unexpected response");
+        }
+    }
+}
+
+void
+send_post_many(hermes::async_engine& hg,
+               const std::vector<hermes::endpoint>& endps,
+               std::size_t seqno) {
+
+    std::vector<std::pair<hermes::endpoint, std::size_t>> items;
+    items.reserve(endps.size());
+
+    for(std::size_t i = 0; i < endps.size(); ++i) {
+        items.emplace_back(endps[i], seqno + i);
+    }
+
+    auto handle = hg.post_many<bench_rpcs::ping>(std::move(items));
+
+    for(std::size_t i = 0; i < handle.size(); ++i) {
+        if(handle.get(i).seqno() != seqno + i) {
+            throw std::runtime_error("Unexpected response");
+        }
+    }
+}
+
+} // anonymous namespace
+
+int
+main(int argc, char* argv[]) {
+
+    if(argc < 2) {
+        usage(argv[0]);
+    }
+
+    try {
+        const auto address = bench::parse_address(argv[1]);
+        const auto num_servers = bench::numeric_arg(argc, argv, 2, 8);
+        const auto iterations = bench::numeric_arg(argc, argv, 3, 1000);
+
+        if(num_servers == 0 || iterations == 0) {
+            usage(argv[0]);
+        }
+
+        hermes::engine_config server_config;
+
+        std::vector<std::unique_ptr<bench::server_process>> servers;
+
+        for(std::size_t i = 0; i < num_servers; ++i) {
+            servers.emplace_back(new bench::server_process(
+                [&](const bench::server_process::notify_function& notify) {
+                    bench::serve(address, i, server_config, notify);
+                }));
+        }
+
+        hermes::async_engine hg(address.m_transport);
+
+        std::vector<hermes::endpoint> endps;
+
+        for(std::size_t i = 0; i < num_servers; ++i) {
+            endps.emplace_back(hg.lookup(address.lookup_address(i)));
+        }
+
+        hg.run();
+
+        using variant = void (*)(hermes::async_engine&,
+                                 const std::vector<hermes::endpoint>&,
+                                 std::size_t);
+
+        const std::vector<std::pair<const char*, variant>> variants = {
+            {"post", send_post},
+            {"post_many", send_post_many},
+        };
+
+        std::printf("%-10s %8s %14s\n", "variant", "servers", "latency(us)");
+
+        for(auto&& v : variants) {
+
+            // warm up connections and handle caches
+            for(std::size_t i = 0; i < 100; ++i) {
+                v.second(hg, endps, i);
+            }
+
+            const auto start = bench::clock::now();
+
+            for(std::size_t i = 0; i < iterations; ++i) {
+                v.second(hg, endps, i);
+            }
+
+            std::printf("%-10s %8zu %14.2f\n", v.first, num_servers,
+                        bench::seconds_since(start) * 1e6 / iterations);
+        }
+
+        for(auto&& endp : endps) {
+            bench::shutdown(hg, endp);
+        }
+    }
+    catch(const std::exception& ex) {
+        std::cerr << ex.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
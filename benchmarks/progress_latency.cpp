@@ -0,0 +1,127 @@
+// Measure the round-trip latency of a small RPC under each progress policy.
+//
+// For each policy, a loopback server is started using that policy and a
+// client engine using the same policy sends ITERATIONS ping RPCs to it, one
+// at a time, waiting for each response before sending the next one.
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <hermes.hpp>
+
+#include "rpcs.hpp"
+#include "benchmark.hpp"
+
+namespace {
+
+struct policy {
+    std::string m_name;
+    hermes::progress_mode m_mode;
+    unsigned int m_trigger_batch;
+    std::chrono::microseconds m_spin_window;
+};
+
+void
+usage(const char* progname) {
+    std::cerr << "Usage: " << progname
+              << " PROTOCOL://HOST:PORT [ITERATIONS] [SPIN_WINDOW_US]\n";
+    exit(1);
+}
+
+double
+percentile(const std::vector<double>& sorted, double p) {
+    const auto idx = static_cast<std::size_t>(p * (sorted.size() - 1));
+    return sorted[idx];
+}
+
+} // anonymous namespace
+
+int
+main(int argc, char* argv[]) {
+
+    if(argc < 2) {
+        usage(argv[0]);
+    }
+
+    try {
+        const auto address = bench::parse_address(argv[1]);
+        const auto iterations = bench::numeric_arg(argc, argv, 2, 100000);
+        const auto spin_us = bench::numeric_arg(argc, argv, 3, 50);
+        const std::size_t warmup = std::min<std::size_t>(1000, iterations);
+
+        const std::vector<policy> policies = {
+            {"blocking", hermes::progress_mode::blocking, 1,
+                std::chrono::microseconds(0)},
+            {"blocking/batch=16", hermes::progress_mode::blocking, 16,
+                std::chrono::microseconds(0)},
+            {"spin_then_block", hermes::progress_mode::spin_then_block, 16,
+                std::chrono::microseconds(spin_us)},
+            {"busy_poll", hermes::progress_mode::busy_poll, 16,
+                std::chrono::microseconds(0)},
+        };
+
+        std::printf("%-20s %10s %10s %10s %10s %10s\n", "policy", "avg(us)",
+                    "p50(us)", "p99(us)", "p99.9(us)", "max(us)");
+
+        for(std::size_t i = 0; i < policies.size(); ++i) {
+
+            const auto& p = policies[i];
+
+            hermes::engine_config config;
+            config.progress.mode = p.m_mode;
+            config.progress.trigger_batch = p.m_trigger_batch;
+            config.progress.spin_window = p.m_spin_window;
+
+            bench::server_process server(
+                [&](const bench::server_process::notify_function& notify) {
+                    bench::serve(address, i, config, notify);
+                });
+
+            std::vector<double> latencies;
+            latencies.reserve(iterations);
+
+            {
+                hermes::async_engine hg(address.m_transport, hermes::none,
+                                        config);
+
+                const auto endp = hg.lookup(address.lookup_address(i));
+
+                hg.run();
+
+                for(std::size_t j = 0; j < warmup; ++j) {
+                    (void) hg.post<bench_rpcs::ping>(endp, j).get();
+                }
+
+                for(std::size_t j = 0; j < iterations; ++j) {
+                    const auto start = bench::clock::now();
+                    (void) hg.post<bench_rpcs::ping>(endp, j).get();
+                    latencies.push_back(bench::seconds_since(start) * 1e6);
+                }
+
+                bench::shutdown(hg, endp);
+            }
+
+            std::sort(latencies.begin(), latencies.end());
+
+            double sum = 0.0;
+            for(const auto l : latencies) {
+                sum += l;
+            }
+
+            std::printf("%-20s %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+                        p.m_name.c_str(), sum / latencies.size(),
+                        percentile(latencies, 0.5),
+                        percentile(latencies, 0.99),
+                        percentile(latencies, 0.999),
+                        latencies.back());
+        }
+    }
+    catch(const std::exception& ex) {
+        std::cerr << ex.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,187 @@
+// Count the heap allocations made by the client for each RPC.
+//
+// A loopback server is started and, after a warmup, the client sends
+// ITERATIONS ping RPCs using each completion mechanism (post(), post_one(),
+// callbacks and completion queues), one at a time, and reports how many
+// times operator new was called per RPC (by any thread of the client
+// process, including its progress threads) along with the average
+// round-trip time. Each variant is measured with Mercury handle
+// reuse enabled and disabled (engine_config::client::cached_handles).
+//
+// NOTE: allocations done by Mercury itself (e.g. in HG_Create()) use malloc
+// and are not counted, but their cost shows up in the round-trip time.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <hermes.hpp>
+
+#include "rpcs.hpp"
+#include "benchmark.hpp"
+
+namespace {
+
+std::atomic<std::size_t> allocations(0);
+
+} // anonymous namespace
+
+void*
+operator new(std::size_t size) {
+
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if(void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+
+    throw std::bad_alloc();
+}
+
+void
+operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void
+operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+void
+usage(const char* progname) {
+    std::cerr << "Usage: " << progname
+              << " PROTOCOL://HOST:PORT [ITERATIONS]\n";
+    exit(1);
+}
+
+void
+send_future(hermes::async_engine& hg, const hermes::endpoint& endp,
+            std::size_t seqno) {
+    // get() would allocate the vector of outputs
+    (void) hg.post<bench_rpcs::ping>(endp, seqno).get(0);
+}
+
+void
+send_single(hermes::async_engine& hg, const hermes::endpoint& endp,
+            std::size_t seqno) {
+    (void) hg.post_one<bench_rpcs::ping>(endp, seqno).get();
+}
+
+void
+send_callback(hermes::async_engine& hg, const hermes::endpoint& endp,
+              std::size_t seqno) {
+
+    std::atomic<bool> done(false);
+
+    hg.post<bench_rpcs::ping>(endp,
+        [&done](hermes::result<bench_rpcs::ping::output>&& rv) {
+            (void) rv;
+            done.store(true, std::memory_order_release);
+        }, seqno);
+
+    while(!done.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+}
+
+void
+send_queue(hermes::async_engine& hg, const hermes::endpoint& endp,
+           std::size_t seqno) {
+
+    // a single queue for the whole run, so that its (one-time) allocations
+    // are not attributed to the RPCs
+    static hermes::completion_queue<bench_rpcs::ping> queue;
+
+    (void) hg.post<bench_rpcs::ping>(queue, endp, seqno);
+    (void) queue.pop().output.value();
+}
+
+} // anonymous namespace
+
+int
+main(int argc, char* argv[]) {
+
+    if(argc < 2) {
+        usage(argv[0]);
+    }
+
+    try {
+        const auto address = bench::parse_address(argv[1]);
+        const auto iterations = bench::numeric_arg(argc, argv, 2, 100000);
+        const std::size_t warmup = 1000;
+
+        hermes::engine_config server_config;
+
+        bench::server_process server(
+            [&](const bench::server_process::notify_function& notify) {
+                bench::serve(address, 0, server_config, notify);
+            });
+
+        using variant = void (*)(hermes::async_engine&,
+                                 const hermes::endpoint&, std::size_t);
+
+        const std::vector<std::pair<std::string, variant>> variants = {
+            {"future", send_future},
+            {"single", send_single},
+            {"callback", send_callback},
+            {"queue", send_queue},
+        };
+
+        std::printf("%-10s %-8s %12s %12s\n", "variant", "handles",
+                    "allocs/rpc", "rtt(us)");
+
+        for(const std::size_t cached_handles : {std::size_t(0),
+                                                std::size_t(1024)}) {
+
+            hermes::engine_config config;
+            config.client.cached_handles = cached_handles;
+
+            hermes::async_engine hg(address.m_transport, hermes::none,
+                                    config);
+
+            const auto endp = hg.lookup(address.lookup_address(0));
+
+            hg.run();
+
+            for(auto&& v : variants) {
+
+                for(std::size_t i = 0; i < warmup; ++i) {
+                    v.second(hg, endp, i);
+                }
+
+                const auto before = allocations.load();
+                const auto start = bench::clock::now();
+
+                for(std::size_t i = 0; i < iterations; ++i) {
+                    v.second(hg, endp, i);
+                }
+
+                const double elapsed = bench::seconds_since(start);
+                const auto count = allocations.load() - before;
+
+                std::printf("%-10s %-8s %12.2f %12.2f\n", v.first.c_str(),
+                            cached_handles != 0 ? "reused" : "created",
+                            static_cast<double>(count) / iterations,
+                            elapsed * 1e6 / iterations);
+            }
+
+            if(cached_handles != 0) {
+                bench::shutdown(hg, endp);
+            }
+        }
+    }
+    catch(const std::exception& ex) {
+        std::cerr << ex.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,197 @@
+// Compare the per-RPC cost of the different ways of retrieving RPC results.
+//
+// A loopback server is started and a client sends ITERATIONS ping RPCs to
+// it, keeping at most WINDOW of them in flight, using:
+//   - future: post() and rpc_handle::get() (promise/future per RPC)
+//   - callback: post() with a completion callback (no promise/future)
+//   - queue: post() targeting a completion_queue
+// Each variant is run ROUNDS times and the best result is reported.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <hermes.hpp>
+
+#include "rpcs.hpp"
+#include "benchmark.hpp"
+
+namespace {
+
+void
+usage(const char* progname) {
+    std::cerr << "Usage: " << progname
+              << " PROTOCOL://HOST:PORT [ITERATIONS] [WINDOW] [ROUNDS]\n";
+    exit(1);
+}
+
+double
+run_futures(hermes::async_engine& hg,
+            const hermes::endpoint& endp,
+            std::size_t iterations,
+            std::size_t window) {
+
+    std::vector<bench_rpcs::ping::handle_type> handles;
+    handles.reserve(window);
+
+    const auto start = bench::clock::now();
+
+    for(std::size_t i = 0; i < iterations; i += window) {
+
+        const auto n = std::min(window, iterations - i);
+
+        for(std::size_t j = 0; j < n; ++j) {
+            handles.emplace_back(hg.post<bench_rpcs::ping>(endp, i + j));
+        }
+
+        for(auto&& h : handles) {
+            (void) h.get();
+        }
+
+        handles.clear();
+    }
+
+    return bench::seconds_since(start);
+}
+
+double
+run_callbacks(hermes::async_engine& hg,
+              const hermes::endpoint& endp,
+              std::size_t iterations,
+              std::size_t window) {
+
+    std::atomic<std::size_t> completed(0);
+    std::atomic<std::size_t> errors(0);
+
+    const auto start = bench::clock::now();
+
+    for(std::size_t i = 0; i < iterations; i += window) {
+
+        const auto n = std::min(window, iterations - i);
+
+        for(std::size_t j = 0; j < n; ++j) {
+            hg.post<bench_rpcs::ping>(endp,
+                [&](hermes::result<bench_rpcs::ping::output>&& rv) {
+                    if(!rv) {
+                        ++errors;
+                    }
+                    completed.fetch_add(1, std::memory_order_release);
+                }, i + j);
+        }
+
+        while(completed.load(std::memory_order_acquire) != i + n) {
+            std::this_thread::yield();
+        }
+    }
+
+    const double elapsed = bench::seconds_since(start);
+
+    if(errors != 0) {
+        throw std::runtime_error(std::to_string(errors.load()) +
+                                 " RPCs failed");
+    }
+
+    return elapsed;
+}
+
+double
+run_queue(hermes::async_engine& hg,
+          const hermes::endpoint& endp,
+          std::size_t iterations,
+          std::size_t window) {
+
+    hermes::completion_queue<bench_rpcs::ping> queue;
+
+    const auto start = bench::clock::now();
+
+    for(std::size_t i = 0; i < iterations; i += window) {
+
+        const auto n = std::min(window, iterations - i);
+
+        for(std::size_t j = 0; j < n; ++j) {
+            (void) hg.post<bench_rpcs::ping>(queue, endp, i + j);
+        }
+
+        for(std::size_t j = 0; j < n; ++j) {
+            (void) queue.pop().output.value();
+        }
+    }
+
+    return bench::seconds_since(start);
+}
+
+} // anonymous namespace
+
+int
+main(int argc, char* argv[]) {
+
+    if(argc < 2) {
+        usage(argv[0]);
+    }
+
+    try {
+        const auto address = bench::parse_address(argv[1]);
+        const auto iterations = bench::numeric_arg(argc, argv, 2, 200000);
+        const auto window = bench::numeric_arg(argc, argv, 3, 1);
+        const auto rounds = bench::numeric_arg(argc, argv, 4, 3);
+
+        if(window == 0 || rounds == 0) {
+            usage(argv[0]);
+        }
+
+        hermes::engine_config config;
+
+        bench::server_process server(
+            [&](const bench::server_process::notify_function& notify) {
+                bench::serve(address, 0, config, notify);
+            });
+
+        hermes::async_engine hg(address.m_transport, hermes::none, config);
+
+        const auto endp = hg.lookup(address.lookup_address(0));
+
+        hg.run();
+
+        // warm up connections and allocator caches
+        (void) run_futures(hg, endp, std::min<std::size_t>(iterations, 1000),
+                           window);
+
+        using variant = double (*)(hermes::async_engine&,
+                                   const hermes::endpoint&,
+                                   std::size_t, std::size_t);
+
+        const std::vector<std::pair<std::string, variant>> variants = {
+            {"future", run_futures},
+            {"callback", run_callbacks},
+            {"queue", run_queue},
+        };
+
+        std::printf("%-10s %8s %12s %12s\n", "variant", "window",
+                    "ns/rpc", "rpc/s");
+
+        for(auto&& v : variants) {
+
+            double best = 0.0;
+
+            for(std::size_t r = 0; r < rounds; ++r) {
+                const double elapsed = v.second(hg, endp, iterations, window);
+                best = (r == 0) ? elapsed : std::min(best, elapsed);
+            }
+
+            std::printf("%-10s %8zu %12.1f %12.0f\n", v.first.c_str(),
+                        window, best * 1e9 / iterations, iterations / best);
+        }
+
+        bench::shutdown(hg, endp);
+    }
+    catch(const std::exception& ex) {
+        std::cerr << ex.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
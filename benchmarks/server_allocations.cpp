@@ -0,0 +1,251 @@
+// Count the heap allocations made by a server for each RPC it serves.
+//
+// One loopback server is started for each way of serving a ping RPC:
+// reading its arguments with args() or args_view(), running the handler in
+// the engine's handler thread pool, and responding with respond_async().
+// The client sends WARMUP + ITERATIONS pings to each server, one at a time,
+// and each server reports how many times operator new was called per RPC
+// (by any of its threads, including its progress threads) once the warmup
+// is over, along with the average round-trip time seen by the client.
+//
+// NOTE: allocations done by Mercury itself (e.g. when decoding inputs) use
+// malloc and are not counted.
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include <hermes.hpp>
+
+#include "rpcs.hpp"
+#include "benchmark.hpp"
+
+namespace {
+
+std::atomic<std::size_t> allocations(0);
+
+} // anonymous namespace
+
+void*
+operator new(std::size_t size) {
+
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if(void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+
+    throw std::bad_alloc();
+}
+
+void
+operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void
+operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+enum class variant {
+    args,
+    view,
+    pool,
+    async
+};
+
+const char*
+variant_name(variant v) {
+    switch(v) {
+        case variant::args:
+            return "args";
+        case variant::view:
+            return "view";
+        case variant::pool:
+            return "pool";
+        default:
+            return "async";
+    }
+}
+
+void
+usage(const char* progname) {
+    std::cerr << "Usage: " << progname
+              << " PROTOCOL://HOST:PORT [ITERATIONS]\n";
+    exit(1);
+}
+
+/**
+ * Serve pings in the way described by @a v until a shutdown RPC arrives,
+ * and then print the allocations per RPC made after the first @a warmup
+ * pings
+ */
+void
+serve(const bench::server_address& address,
+      std::size_t i,
+      variant v,
+      std::size_t warmup,
+      const bench::server_process::notify_function& notify_ready) {
+
+    std::atomic<bool> shutdown_requested(false);
+    std::atomic<std::size_t> served(0);
+    std::atomic<std::size_t> baseline(0);
+
+    hermes::async_engine hg(address.m_transport,
+                            hermes::none,
+                            hermes::engine_config(),
+                            address.bind_address(i),
+                            true);
+
+    const auto count = [&]() {
+        if(served.fetch_add(1) == warmup) {
+            baseline = allocations.load();
+        }
+    };
+
+    using ping_request = hermes::request<bench_rpcs::ping>;
+
+    switch(v) {
+        case variant::args:
+            hg.register_handler<bench_rpcs::ping>(
+                [&](ping_request&& req) {
+                    count();
+                    const auto seqno = req.args().seqno();
+                    hg.respond<bench_rpcs::ping>(std::move(req), seqno);
+                });
+            break;
+
+        case variant::view:
+            hg.register_handler<bench_rpcs::ping>(
+                [&](ping_request&& req) {
+                    count();
+                    const auto seqno = req.args_view().seqno;
+                    hg.respond<bench_rpcs::ping>(std::move(req), seqno);
+                });
+            break;
+
+        case variant::pool:
+            hg.register_handler<bench_rpcs::ping>(
+                [&](ping_request&& req) {
+                    count();
+                    const auto seqno = req.args().seqno();
+                    hg.respond<bench_rpcs::ping>(std::move(req), seqno);
+                }, hermes::dispatch_policy::handler_pool);
+            break;
+
+        case variant::async:
+            hg.register_handler<bench_rpcs::ping>(
+                [&](ping_request&& req) {
+                    count();
+                    const auto seqno = req.args_view().seqno;
+                    hg.respond_async(std::move(req),
+                                     [](ping_request&&, bool) { }, seqno);
+                });
+            break;
+    }
+
+    hg.register_handler<bench_rpcs::shutdown>(
+        [&](hermes::request<bench_rpcs::shutdown>&& req) {
+
+            const auto allocs = allocations.load() - baseline.load();
+            const auto measured = served.load() - warmup;
+
+            std::printf("%-10s %12.2f", variant_name(v),
+                        measured != 0 ?
+                            static_cast<double>(allocs) / measured : 0.0);
+            std::fflush(stdout);
+
+            hg.respond<bench_rpcs::shutdown>(std::move(req), 0);
+            shutdown_requested = true;
+        });
+
+    hg.run();
+
+    notify_ready();
+
+    while(!shutdown_requested) {
+        ::usleep(1000);
+    }
+}
+
+} // anonymous namespace
+
+int
+main(int argc, char* argv[]) {
+
+    if(argc < 2) {
+        usage(argv[0]);
+    }
+
+    try {
+        const auto address = bench::parse_address(argv[1]);
+        const auto iterations = bench::numeric_arg(argc, argv, 2, 100000);
+        const std::size_t warmup = 1000;
+
+        if(iterations == 0) {
+            usage(argv[0]);
+        }
+
+        const std::vector<variant> variants = {
+            variant::args, variant::view, variant::pool, variant::async
+        };
+
+        std::vector<std::unique_ptr<bench::server_process>> servers;
+
+        for(std::size_t i = 0; i < variants.size(); ++i) {
+            servers.emplace_back(new bench::server_process(
+                [&](const bench::server_process::notify_function& notify) {
+                    serve(address, i, variants[i], warmup, notify);
+                }));
+        }
+
+        hermes::async_engine hg(address.m_transport);
+
+        std::vector<hermes::endpoint> endps;
+
+        for(std::size_t i = 0; i < variants.size(); ++i) {
+            endps.emplace_back(hg.lookup(address.lookup_address(i)));
+        }
+
+        hg.run();
+
+        std::printf("%-10s %12s %12s\n", "variant", "allocs/rpc", "rtt(us)");
+        std::fflush(stdout);
+
+        for(std::size_t i = 0; i < variants.size(); ++i) {
+
+            for(std::size_t j = 0; j < warmup; ++j) {
+                (void) hg.post<bench_rpcs::ping>(endps[i], j).get();
+            }
+
+            const auto start = bench::clock::now();
+
+            for(std::size_t j = 0; j < iterations; ++j) {
+                (void) hg.post<bench_rpcs::ping>(endps[i], j).get();
+            }
+
+            const double elapsed = bench::seconds_since(start);
+
+            // the server prints its own columns before acknowledging this
+            bench::shutdown(hg, endps[i]);
+
+            std::printf(" %12.2f\n", elapsed * 1e6 / iterations);
+            std::fflush(stdout);
+        }
+    }
+    catch(const std::exception& ex) {
+        std::cerr << ex.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,145 @@
+// Measure how RPC throughput scales with the number of Mercury contexts
+// (and progress threads) used by an async_engine.
+//
+// For each context count N in {1, 2, 4, ..., MAX_CONTEXTS}, a loopback server
+// is started with N contexts and a client engine with N contexts sends ping
+// RPCs to it from THREADS threads, each one keeping up to WINDOW RPCs in
+// flight, for SECONDS seconds.
+
+#include <deque>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <hermes.hpp>
+
+#include "rpcs.hpp"
+#include "benchmark.hpp"
+
+namespace {
+
+void
+usage(const char* progname) {
+    std::cerr << "Usage: " << progname
+              << " PROTOCOL://HOST:PORT [MAX_CONTEXTS] [SECONDS] [THREADS] "
+                 "[WINDOW]\n";
+    exit(1);
+}
+
+double
+measure_throughput(hermes::async_engine& hg,
+                   const hermes::endpoint& endp,
+                   std::size_t num_threads,
+                   std::size_t window,
+                   double seconds) {
+
+    std::atomic<bool> stop(false);
+    std::atomic<std::uint64_t> completed(0);
+    std::vector<std::thread> clients;
+
+    const auto start = bench::clock::now();
+
+    for(std::size_t i = 0; i < num_threads; ++i) {
+        clients.emplace_back([&]() {
+
+            std::deque<bench_rpcs::ping::handle_type> inflight;
+            std::uint64_t seqno = 0;
+            std::uint64_t count = 0;
+
+            while(!stop) {
+                while(inflight.size() < window) {
+                    inflight.emplace_back(
+                            hg.post<bench_rpcs::ping>(endp, seqno++));
+                }
+
+                (void) inflight.front().get();
+                inflight.pop_front();
+                ++count;
+            }
+
+            for(auto&& h : inflight) {
+                (void) h.get();
+                ++count;
+            }
+
+            inflight.clear();
+            completed += count;
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+
+    for(auto&& t : clients) {
+        t.join();
+    }
+
+    return completed / bench::seconds_since(start);
+}
+
+} // anonymous namespace
+
+int
+main(int argc, char* argv[]) {
+
+    if(argc < 2) {
+        usage(argv[0]);
+    }
+
+    try {
+        const auto address = bench::parse_address(argv[1]);
+        const auto max_contexts = bench::numeric_arg(argc, argv, 2, 8);
+        const auto seconds = bench::numeric_arg(argc, argv, 3, 5);
+        const auto num_threads = bench::numeric_arg(argc, argv, 4,
+                std::max(2u, std::thread::hardware_concurrency() / 2));
+        const auto window = bench::numeric_arg(argc, argv, 5, 16);
+
+        std::printf("%10s %10s %10s %14s %10s\n",
+                    "contexts", "threads", "window", "rpcs/s", "speedup");
+
+        double baseline = 0.0;
+
+        for(std::size_t n = 1; n <= max_contexts; n *= 2) {
+
+            hermes::engine_config config;
+            config.progress.contexts = n;
+            config.progress.target_contexts = n;
+
+            // use a different port for each run so that we don't have to
+            // wait for the previous server's socket to be released
+            bench::server_process server(
+                [&](const bench::server_process::notify_function& notify) {
+                    bench::serve(address, n, config, notify);
+                });
+
+            double rate = 0.0;
+
+            {
+                hermes::async_engine hg(address.m_transport, hermes::none,
+                                        config);
+
+                const auto endp = hg.lookup(address.lookup_address(n));
+
+                hg.run();
+
+                rate = measure_throughput(hg, endp, num_threads, window,
+                                          seconds);
+
+                bench::shutdown(hg, endp);
+            }
+
+            if(n == 1) {
+                baseline = rate;
+            }
+
+            std::printf("%10zu %10zu %10zu %14.0f %9.2fx\n",
+                        n, num_threads, window, rate, rate / baseline);
+        }
+    }
+    catch(const std::exception& ex) {
+        std::cerr << ex.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
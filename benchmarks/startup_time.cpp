@@ -0,0 +1,126 @@
+// Measure how long a client takes to become ready to send RPCs to a set of
+// servers with and without a persisted address cache.
+//
+// NUM_SERVERS loopback servers are started and then, for ROUNDS rounds, a
+// client engine configured to persist its address cache is created, looks
+// up every server and is destroyed. The first round starts without a cache
+// file (cold start), whereas the rest reload the addresses stored by the
+// previous round (warm start).
+
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <hermes.hpp>
+
+#include "rpcs.hpp"
+#include "benchmark.hpp"
+
+namespace {
+
+void
+usage(const char* progname) {
+    std::cerr << "Usage: " << progname
+              << " PROTOCOL://HOST:PORT [NUM_SERVERS] [ROUNDS] "
+                 "[CACHE_FILE]\n";
+    exit(1);
+}
+
+} // anonymous namespace
+
+int
+main(int argc, char* argv[]) {
+
+    if(argc < 2) {
+        usage(argv[0]);
+    }
+
+    try {
+        const auto address = bench::parse_address(argv[1]);
+        const auto num_servers = bench::numeric_arg(argc, argv, 2, 16);
+        const auto rounds = bench::numeric_arg(argc, argv, 3, 5);
+        const std::string cache_file =
+            argc > 4 ? argv[4] : "hermes_startup_time.cache";
+
+        if(num_servers == 0 || rounds == 0) {
+            usage(argv[0]);
+        }
+
+        hermes::engine_config server_config;
+
+        std::vector<std::unique_ptr<bench::server_process>> servers;
+
+        for(std::size_t i = 0; i < num_servers; ++i) {
+            servers.emplace_back(new bench::server_process(
+                [&](const bench::server_process::notify_function& notify) {
+                    bench::serve(address, i, server_config, notify);
+                }));
+        }
+
+        std::vector<std::string> addrs;
+
+        for(std::size_t i = 0; i < num_servers; ++i) {
+            addrs.emplace_back(address.lookup_address(i));
+        }
+
+        (void) std::remove(cache_file.c_str());
+
+        hermes::engine_config config;
+        config.address_cache.persist_path = cache_file;
+
+        std::printf("%-6s %-5s %12s %12s %12s %8s %8s\n", "round", "start",
+                    "init(ms)", "lookup(ms)", "first(ms)", "hits",
+                    "misses");
+
+        for(std::size_t r = 0; r < rounds; ++r) {
+
+            const auto start = bench::clock::now();
+
+            hermes::async_engine hg(address.m_transport, hermes::none,
+                                    config);
+
+            const double init = bench::seconds_since(start) * 1e3;
+            const auto lookup_start = bench::clock::now();
+
+            std::vector<hermes::endpoint> endps;
+
+            for(auto&& rv : hg.lookup_batch(addrs)) {
+                endps.emplace_back(std::move(rv).value());
+            }
+
+            const double lookup = bench::seconds_since(lookup_start) * 1e3;
+
+            // time until every server has answered an RPC, so that warm
+            // starts are not credited for deferring work to the first RPC
+            hg.run();
+
+            for(std::size_t i = 0; i < endps.size(); ++i) {
+                (void) hg.post<bench_rpcs::ping>(endps[i], i).get();
+            }
+
+            const double first = bench::seconds_since(start) * 1e3;
+            const auto stats = hg.cache_stats();
+
+            std::printf("%-6zu %-5s %12.3f %12.3f %12.3f %8llu %8llu\n", r,
+                        r == 0 ? "cold" : "warm", init, lookup, first,
+                        static_cast<unsigned long long>(stats.hits),
+                        static_cast<unsigned long long>(stats.misses));
+
+            if(r + 1 == rounds) {
+                for(auto&& endp : endps) {
+                    bench::shutdown(hg, endp);
+                }
+            }
+        }
+
+        (void) std::remove(cache_file.c_str());
+    }
+    catch(const std::exception& ex) {
+        std::cerr << ex.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
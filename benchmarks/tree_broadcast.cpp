@@ -0,0 +1,154 @@
+// Compare flat and tree-based broadcasts to a set of servers.
+//
+// NUM_SERVERS loopback servers are started and the client sends ITERATIONS
+// ping RPCs to all of them, one broadcast at a time, using:
+//   - flat: broadcast(), which sends every RPC from the client
+//   - tree: tree_broadcast() with each of the given FANOUTS, where the
+//     client only sends the RPC to FANOUT servers that relay it to the rest
+// and reports the average latency of a whole broadcast.
+
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <hermes.hpp>
+
+#include "rpcs.hpp"
+#include "benchmark.hpp"
+
+namespace {
+
+void
+usage(const char* progname) {
+    std::cerr << "Usage: " << progname
+              << " PROTOCOL://HOST:PORT [NUM_SERVERS] [ITERATIONS] "
+                 "[FANOUTS]\n"
+              << "  FANOUTS is a comma-separated list (default: 2,4,8)\n";
+    exit(1);
+}
+
+std::vector<std::size_t>
+parse_fanouts(const std::string& arg) {
+
+    std::vector<std::size_t> fanouts;
+    std::istringstream ss(arg);
+    std::string item;
+
+    while(std::getline(ss, item, ',')) {
+        fanouts.push_back(std::stoul(item));
+
+        if(fanouts.back() == 0) {
+            throw std::invalid_argument("Invalid fanout: 0");
+        }
+    }
+
+    return fanouts;
+}
+
+void
+check(const std::vector<bench_rpcs::ping::output>& outputs,
+      std::size_t expected, std::size_t seqno) {
+
+    if(outputs.size() != expected) {
+        throw std::runtime_error("Unexpected number of responses");
+    }
+
+    for(auto&& out : outputs) {
+        if(out.seqno() != seqno) {
+            throw std::runtime_error("Unexpected response");
+        }
+    }
+}
+
+} // anonymous namespace
+
+int
+main(int argc, char* argv[]) {
+
+    if(argc < 2) {
+        usage(argv[0]);
+    }
+
+    try {
+        const auto address = bench::parse_address(argv[1]);
+        const auto num_servers = bench::numeric_arg(argc, argv, 2, 32);
+        const auto iterations = bench::numeric_arg(argc, argv, 3, 1000);
+        const auto fanouts = parse_fanouts(argc > 4 ? argv[4] : "2,4,8");
+
+        if(num_servers == 0 || iterations == 0) {
+            usage(argv[0]);
+        }
+
+        hermes::engine_config server_config;
+
+        std::vector<std::unique_ptr<bench::server_process>> servers;
+
+        for(std::size_t i = 0; i < num_servers; ++i) {
+            servers.emplace_back(new bench::server_process(
+                [&](const bench::server_process::notify_function& notify) {
+                    bench::serve(address, i, server_config, notify);
+                }));
+        }
+
+        hermes::async_engine hg(address.m_transport);
+
+        std::vector<hermes::endpoint> endps;
+
+        for(std::size_t i = 0; i < num_servers; ++i) {
+            endps.emplace_back(hg.lookup(address.lookup_address(i)));
+        }
+
+        hg.run();
+
+        // warm up connections (including those between relays)
+        for(std::size_t i = 0; i < 10; ++i) {
+            check(hg.broadcast<bench_rpcs::ping>(endps, i).get(),
+                  num_servers, i);
+
+            for(const auto fanout : fanouts) {
+                check(hg.tree_broadcast<bench_rpcs::ping>(
+                            endps, fanout, i).get(), num_servers, i);
+            }
+        }
+
+        std::printf("%-8s %8s %8s %14s\n", "mode", "servers", "fanout",
+                    "latency(us)");
+
+        auto start = bench::clock::now();
+
+        for(std::size_t i = 0; i < iterations; ++i) {
+            check(hg.broadcast<bench_rpcs::ping>(endps, i).get(),
+                  num_servers, i);
+        }
+
+        std::printf("%-8s %8zu %8s %14.2f\n", "flat", num_servers, "-",
+                    bench::seconds_since(start) * 1e6 / iterations);
+
+        for(const auto fanout : fanouts) {
+
+            start = bench::clock::now();
+
+            for(std::size_t i = 0; i < iterations; ++i) {
+                check(hg.tree_broadcast<bench_rpcs::ping>(
+                            endps, fanout, i).get(), num_servers, i);
+            }
+
+            std::printf("%-8s %8zu %8zu %14.2f\n", "tree", num_servers,
+                        fanout,
+                        bench::seconds_since(start) * 1e6 / iterations);
+        }
+
+        for(auto&& endp : endps) {
+            bench::shutdown(hg, endp);
+        }
+    }
+    catch(const std::exception& ex) {
+        std::cerr << ex.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -2,6 +2,7 @@ include(CMakeDependentOption)
 
 # Options that control how to build
 option(HERMES_BUILD_EXAMPLES "Build the examples." OFF)
+option(HERMES_BUILD_BENCHMARKS "Build the benchmarks." OFF)
 
 # Options controlling optional features
 option(HERMES_LOGGING "Enable logging messages (using the fmt library)" OFF)
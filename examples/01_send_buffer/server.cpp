@@ -165,7 +165,11 @@ main(int argc, char* argv[]) {
                               do_pull_completion);
             };
 
-        hg.register_handler<example_rpcs::send_buffer>(send_buffer_handler);
+        // allocating buffers and printing their contents is slow, so
+        // send_buffer requests are served by the engine's handler pool
+        // rather than by the progress thread
+        hg.register_handler<example_rpcs::send_buffer>(
+                send_buffer_handler, hermes::dispatch_policy::handler_pool);
 
         hg.register_handler<example_rpcs::shutdown>(shutdown_handler);
 
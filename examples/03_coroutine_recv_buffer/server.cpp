@@ -0,0 +1,206 @@
+#include <unistd.h>
+
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include <hermes.hpp>
+#include <hermes/coroutine.hpp>
+
+#include "rpcs.hpp"
+#include "common.hpp"
+
+#if !defined(__cpp_impl_coroutine)
+#error "This example requires C++20 coroutines"
+#endif
+
+std::atomic<bool> shutdown_requested(false);
+
+void
+shutdown_handler(hermes::request<example_rpcs::shutdown>&& req) {
+
+    std::cout << "RPC received:\n";
+    std::cout << "    type: shutdown\n";
+    std::cout << "  requires_response? " 
+              << std::boolalpha << req.requires_response() << "\n"; 
+
+    bool expected = false;
+    while(!shutdown_requested.compare_exchange_weak(expected, true) 
+            && !expected);
+}
+
+void
+respond(hermes::async_engine& hg,
+        hermes::request<example_rpcs::recv_buffer>&& req,
+        int32_t retval) {
+
+    if(req.requires_response()) {
+
+        std::cout << "  Sending response...\n";
+
+        example_rpcs::recv_buffer::output rv(retval);
+        hg.respond<example_rpcs::recv_buffer>(std::move(req), rv);
+
+        std::cout << "  Response sent with value " << rv.retval() << "\n";
+    }
+}
+
+// the same handler as in 02_recv_buffer, written as a coroutine: the push
+// transfer suspends it instead of requiring a completion callback, and
+// everything it needs (e.g. the mapped file) simply lives in its frame
+// until it finishes
+hermes::coro::detached
+recv_buffer_handler(hermes::async_engine& hg,
+                    hermes::request<example_rpcs::recv_buffer> req) {
+
+    example_rpcs::recv_buffer::input args = req.args();
+
+    hermes::exposed_memory remote_buffers = args.buffers();
+
+    std::cout << "RPC received:\n";
+    std::cout << "    type: recv_buffer,\n"; 
+    std::cout << "    args: remote_buffers{count="
+              << remote_buffers.count() 
+              << ", total_size=" << remote_buffers.size() << " }\n"; 
+
+    char data[] = {"These are the contents of an example buffer"};
+
+    std::error_code ec;
+
+    hermes::mapped_buffer mapped_file("examples/02_recv_buffer/lipsum.txt",
+                                      hermes::access_mode::read_only, 
+                                      &ec);
+
+    if(ec) {
+        std::cerr << "Failed to map file: " << ec.message() << "\n";
+        respond(hg, std::move(req), -1);
+        co_return;
+    }
+
+    // let's prepare some local buffers
+    std::vector<hermes::mutable_buffer> bufvec {
+        hermes::mutable_buffer{data, sizeof(data)},
+        hermes::mutable_buffer{mapped_file.data(), mapped_file.size()},
+    };
+
+    hermes::exposed_memory local_buffers =
+        hg.expose(bufvec, hermes::access_mode::read_only);
+
+    std::cout << "  Pushing local buffers\n";
+
+    // local -> remote
+    try {
+        req = co_await hermes::coro::push(hg, local_buffers, remote_buffers,
+                                          std::move(req));
+    }
+    catch(const hermes::coro::transfer_error<example_rpcs::recv_buffer>& ex) {
+        std::cerr << "    Push failed!\n";
+        respond(hg, ex.take_request(), -1);
+        co_return;
+    }
+
+    std::cout << "    Push successful!\n";
+
+    respond(hg, std::move(req), 42);
+}
+
+std::tuple<hermes::transport, std::string>
+parse_args(int argc, char* argv[]) {
+
+    if(argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " ADDRESS\n";
+
+        std::cerr << 
+            "Address formats:\n"                                           <<
+            "  [BMI plugin]\n"                                             <<
+            "    tcp:      bmi+tcp[://<hostname,IP>:<port>]\n\n"           <<
+            "  [MPI plugin]\n"                                             <<
+            "    static:   mpi+static\n"                                   <<
+            "    dynamic:  mpi+dynamic\n\n"                                <<
+            "  [SM plugin]\n"                                              <<
+            "    sm:       na+sm\n\n"                                      <<
+            "  [OFI/libfabric plugin]\n"                                   <<
+            "    tcp:      ofi+tcp[://<hostname,IP,interface>:<port>]\n"   <<
+            "    verbs:    ofi+verbs[://<hostname,IP,interface>:<port>]\n" <<
+            "    psm2:     ofi+psm2\n"                                     <<
+            "    gni:      ofi+gni[://<hostname,IP,interface>]\n\n"        <<
+            "  [CCI (deprecated)]\n"                                       <<
+            "    tcp:      cci+tcp[://<hostname,IP,interface>:<port>]\n"   <<
+            "    verbs:    cci+verbs[://<hostname,IP,interface>:<port>]\n" <<
+            "    sm:       cci+sm[://<PID>/<ID>]\n";
+
+        exit(1);
+    }
+
+    const std::string address(argv[1]);
+
+    std::size_t pos = address.find("://");
+
+    if(pos == std::string::npos) {
+        std::cout << "WARNING: Address does not include a transport prefix. "
+                     "Defaulting to ofi+tcp\n";
+
+        return std::make_tuple(hermes::transport::ofi_tcp, address);
+    }
+    else {
+        return std::make_tuple(
+                hermes::get_transport_type(address.substr(0, pos)),
+                address.substr(pos+3));
+    }
+}
+
+int
+main(int argc, char* argv[]) {
+
+#ifdef HERMES_ENABLE_LOGGING
+    hermes::log::logger::register_callback(hermes::log::info, common::log_info);
+    hermes::log::logger::register_callback(hermes::log::warning, common::log_warning);
+    hermes::log::logger::register_callback(hermes::log::error, common::log_error);
+    hermes::log::logger::register_callback(hermes::log::fatal, common::log_fatal);
+
+#ifdef HERMES_DEBUG_BUILD
+    hermes::log::logger::register_callback(hermes::log::debug, common::log_debug);
+#endif // HERMES_DEBUG_BUILD
+
+    hermes::log::logger::register_callback(hermes::log::mercury, common::log_mercury);
+#endif // HERMES_ENABLE_LOGGING
+
+    try {
+
+        hermes::transport tr;
+        std::string bind_address;
+
+        std::tie(tr, bind_address) = parse_args(argc, argv);
+
+        // initialize the engine with the provided address
+        hermes::async_engine hg(tr, bind_address, true);
+
+        // define and register handlers for any defined rpcs
+        hg.register_handler<example_rpcs::recv_buffer>(
+            [&](hermes::request<example_rpcs::recv_buffer>&& req) {
+                // the coroutine runs until its first co_await and then
+                // returns control to the engine
+                recv_buffer_handler(hg, std::move(req));
+            });
+
+        hg.register_handler<example_rpcs::shutdown>(shutdown_handler);
+
+        std::cout << "Listening for requests\n";
+
+        // start the engine
+        hg.run();
+
+        while(!shutdown_requested) {
+            // the server could do actual useful work here while the
+            // engine processes rpcs and invokes handlers
+            sleep(1);
+        }
+
+        std::cout << "Shutting down\n";
+    } 
+    catch(const std::exception& ex) {
+        std::cerr << ex.what() << "\n";
+    }
+
+    return 0;
+}
@@ -3,11 +3,17 @@
 
 #include <hermes/async_engine.hpp>
 #include <hermes/buffer.hpp>
+#include <hermes/completion_queue.hpp>
+#include <hermes/coroutine.hpp>
 #include <hermes/endpoint.hpp>
+#include <hermes/engine_config.hpp>
 #include <hermes/exposed_memory.hpp>
 #include <hermes/handle.hpp>
 #include <hermes/logging.hpp>
+#include <hermes/reduce.hpp>
 #include <hermes/request.hpp>
+#include <hermes/result.hpp>
+#include <hermes/thread_pool.hpp>
 #include <hermes/transport.hpp>
 
 #endif // __HERMES_HPP__
@@ -8,6 +8,8 @@
 #include <cassert>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <functional>
 #include <set>
 #include <vector>
 #include <utility>
@@ -16,6 +18,8 @@
 #include <algorithm>
 #include <cstring>
 #include <array>
+#include <iterator>
+#include <tuple>
 
 // C includes
 #include <mercury.h>
@@ -28,11 +32,21 @@
 #include <hermes/endpoint.hpp>
 #include <hermes/exposed_memory.hpp>
 #include <hermes/logging.hpp>
+#include <hermes/completion_queue.hpp>
 #include <hermes/transport.hpp>
 #include <hermes/options.hpp>
+#include <hermes/engine_config.hpp>
+#include <hermes/result.hpp>
+#include <hermes/thread_pool.hpp>
 
 #include <hermes/detail/address.hpp>
+#include <hermes/detail/address_cache.hpp>
+#include <hermes/detail/address_cache_file.hpp>
+#include <hermes/detail/execution_context.hpp>
+#include <hermes/detail/handle_cache.hpp>
 #include <hermes/detail/mercury_utils.hpp>
+#include <hermes/detail/collective.hpp>
+#include <hermes/detail/relay.hpp>
 #include <hermes/detail/request_registrar.hpp>
 #include <hermes/detail/request_status.hpp>
 
@@ -42,6 +56,9 @@ namespace hermes {
 
 // defined elsewhere
 template <typename Request> class rpc_handle;
+template <typename Request> class single_rpc_handle;
+template <typename Request> class tree_rpc_handle;
+template <typename Request> class multi_rpc_handle;
 template <typename Request> class request;
 
 using endpoint_set = std::vector<endpoint>;
@@ -51,24 +68,95 @@ using output_set = std::vector<typename Request::output_type>;
 
 namespace detail {
 void register_user_request_types();
+
+/** Forward an element of @a Range as an rvalue if the range itself was 
+ * passed as an rvalue (i.e. its elements may be moved from) */
+template <typename Range, typename T>
+inline typename std::conditional<std::is_lvalue_reference<Range>::value,
+                                 T&, T&&>::type
+forward_element(T& element) {
+    return static_cast<typename std::conditional<
+        std::is_lvalue_reference<Range>::value, T&, T&&>::type>(element);
+}
+
+/**
+ * Whether Callable wants to know about failed bulk transfers, i.e. whether
+ * it can be invoked with the request and a bool telling whether the 
+ * transfer succeeded (see async_engine::async_pull())
+ */
+template <typename Request, typename Callable, typename = void>
+struct is_transfer_status_callback : std::false_type { };
+
+template <typename Request, typename Callable>
+struct is_transfer_status_callback<
+    Request, Callable,
+    decltype(std::declval<typename std::decay<Callable>::type&>()(
+                std::declval<request<Request>&&>(), true),
+             void())> : std::true_type { };
+
 } // namespace detail
 
 /** public */
 class async_engine {
 
-    struct lookup_ctx {
+    struct batch_lookup_ctx {
+
+        struct entry {
+            batch_lookup_ctx* m_parent;
+            std::string m_address;
+            hg_addr_t m_hg_addr;
+            hg_return_t m_hg_ret;
+        };
+
+        batch_lookup_ctx() :
+            m_pending(0),
+            m_done(false) { }
+
+        // mark one lookup as completed, waking up the waiting thread if it
+        // was the last one
+        void
+        complete_one() {
+            if(m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_done = true;
+                m_cv.notify_one();
+            }
+        }
 
-        explicit lookup_ctx(const hg_class_t* const hg_class) : 
-            m_lookup_finished(false),
-            m_hg_class(hg_class) { }
+        // once this returns true, no callback references the context
+        bool
+        done() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_done;
+        }
 
-        ~lookup_ctx() {
+        void
+        wait_for(std::chrono::milliseconds timeout) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait_for(lock, timeout, [this]() { return m_done; });
         }
 
-        bool m_lookup_finished;
-        const hg_class_t* const m_hg_class;
-        hg_addr_t m_hg_addr;
-        hg_return_t m_hg_ret;
+        std::vector<entry> m_entries;
+        std::atomic<std::size_t> m_pending;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        bool m_done;
+    };
+
+    struct async_lookup_ctx {
+
+        using callback_type = std::function<void(result<endpoint>&&)>;
+
+        async_lookup_ctx(const async_engine* engine,
+                         std::string address,
+                         callback_type&& callback) :
+            m_engine(engine),
+            m_address(std::move(address)),
+            m_callback(std::move(callback)) { }
+
+        const async_engine* const m_engine;
+        const std::string m_address;
+        callback_type m_callback;
     };
 
 public:
@@ -95,9 +183,50 @@ public:
                  engine_options opts,
                  const std::string& bind_address = "",
                  bool listen = false) :
+        async_engine(transport_type,
+                     opts,
+                     engine_config{},
+                     bind_address,
+                     listen) { }
+
+    /**
+     * Initialize the Hermes asynchronous engine with a custom configuration.
+     **/
+    async_engine(transport transport_type,
+                 engine_options opts,
+                 const engine_config& config,
+                 const std::string& bind_address = "",
+                 bool listen = false) :
         m_shutdown(false),
         m_listen(listen),
-        m_transport(transport_type) {
+        m_external_progress(opts & external_progress),
+        m_transport(transport_type),
+        m_config(config),
+        m_progress_threads_running(false),
+        m_next_slot(0),
+        m_address_cache(m_config.address_cache.capacity,
+                        m_config.address_cache.shards,
+                        m_config.address_cache.negative_ttl),
+        m_handle_cache(m_config.client.cached_handles) {
+
+        // Mercury identifies contexts with an hg_uint8_t, and the NA layer
+        // is told how many there are with a std::uint8_t as well (see 
+        // na_init_info.max_contexts below), so 256 would wrap around to 0
+        constexpr const std::size_t max_contexts = 255;
+
+        if(m_config.progress.contexts == 0 || 
+           m_config.progress.contexts > max_contexts) {
+            throw std::invalid_argument("Invalid number of progress contexts");
+        }
+
+        if(m_config.progress.target_contexts == 0 || 
+           m_config.progress.target_contexts > max_contexts) {
+            throw std::invalid_argument("Invalid number of target contexts");
+        }
+
+        if(m_config.progress.trigger_batch == 0) {
+            throw std::invalid_argument("Invalid trigger batch size");
+        }
 
         // IMPORTANT: this struct needs to be zeroed before use
         struct hg_init_info hg_options = HG_INIT_INFO_INITIALIZER;
@@ -110,7 +239,8 @@ public:
             hg_options.stats = HG_TRUE;
         }
 
-        if (opts & force_no_block_progress) {
+        if ((opts & force_no_block_progress) || 
+            m_config.progress.mode == progress_mode::busy_poll) {
             hg_options.na_init_info.progress_mode = NA_NO_BLOCK;
         }
 
@@ -118,6 +248,13 @@ public:
             m_parent_pid = getpid();
         }
 
+        // a listening engine must let the NA layer know how many contexts
+        // it will create so that incoming requests can be routed to them
+        if(m_config.progress.contexts > 1) {
+            hg_options.na_init_info.max_contexts = 
+                static_cast<std::uint8_t>(m_config.progress.contexts);
+        }
+
         m_hg_class =
                 detail::initialize_mercury(
                         get_transport_prefix(m_transport), 
@@ -127,9 +264,21 @@ public:
 
         HERMES_DEBUG2("m_hg_class: {}", static_cast<void*>(m_hg_class));
 
-        m_hg_context = detail::create_mercury_context(m_hg_class);
+        m_hg_contexts.reserve(m_config.progress.contexts);
+        m_progress_owners = 
+            compat::make_unique<std::atomic<bool>[]>(
+                    m_config.progress.contexts);
+
+        for(std::size_t i = 0; i < m_config.progress.contexts; ++i) {
+            m_hg_contexts.emplace_back(
+                    m_config.progress.contexts == 1 ?
+                        detail::create_mercury_context(m_hg_class) :
+                        detail::create_mercury_context(
+                            m_hg_class, static_cast<hg_uint8_t>(i)));
 
-        HERMES_DEBUG2("m_hg_context: {}", static_cast<void*>(m_hg_context));
+            HERMES_DEBUG2("m_hg_contexts[{}]: {}", 
+                          i, static_cast<void*>(m_hg_contexts.back()));
+        }
 
         if(m_listen) {
             m_self_address = 
@@ -141,6 +290,44 @@ public:
 
         HERMES_DEBUG("Registering RPCs");
         register_rpcs();
+
+        // listening engines act as relays for tree_broadcast() and receive
+        // the messages of collective operations. Since handlers are 
+        // registered for the whole process, only the first listening engine
+        // can do so: relays and collective messages received by any other
+        // engine are answered with an error (see serving_engine())
+        if(m_listen) {
+            async_engine* expected = nullptr;
+
+            if(!serving_engine().compare_exchange_strong(expected, this)) {
+                HERMES_WARNING("Another listening engine already serves "
+                               "relays and collective messages in this "
+                               "process: those received by this engine "
+                               "will be rejected");
+            }
+
+            // the handlers find the serving engine by themselves, so they 
+            // are only registered once: replacing them while another engine
+            // is serving requests would race with its progress threads
+            static std::once_flag internal_handlers_once;
+
+            std::call_once(internal_handlers_once, []() {
+                set_handler<detail::relay_rpc>(&async_engine::relay_handler,
+                                               nullptr);
+                set_handler<detail::collective_rpc>(
+                        &async_engine::collective_handler, nullptr);
+            });
+        }
+
+        if(!m_config.address_cache.persist_path.empty()) {
+            try {
+                load_address_cache(m_config.address_cache.persist_path);
+            }
+            catch(const std::exception& ex) {
+                HERMES_WARNING("Ignoring persisted address cache: {}",
+                               ex.what());
+            }
+        }
     }
 
     /**
@@ -149,27 +336,62 @@ public:
     ~async_engine() {
 
         HERMES_DEBUG("Destroying Mercury asynchronous engine");
+
+        if(m_listen) {
+            async_engine* self = this;
+            (void) serving_engine().compare_exchange_strong(self, nullptr);
+        }
+
         HERMES_DEBUG("  Stopping runners");
 
+        // stop handing requests over to the handler pool. This must happen
+        // before the progress threads are stopped so that none of them is
+        // left holding a pointer to the pool when it is destroyed
+        if(m_handler_pool) {
+            for(auto&& kv : detail::registered_requests()) {
+                kv.second->release_executor(m_handler_pool.get());
+            }
+        }
+
         m_shutdown = true;
 
-        if(m_runner.joinable()) {
-            m_runner.join();
+        for(auto&& runner : m_runners) {
+            if(runner.joinable()) {
+                runner.join();
+            }
+        }
+
+        // any requests still queued are run before the pool is destroyed
+        if(m_handler_pool) {
+            HERMES_DEBUG("  Stopping handler pool");
+            m_handler_pool.reset();
         }
 
-        HERMES_DEBUG("  Cleaning address cache");
-        {
-            std::lock_guard<std::mutex> lock(m_addr_cache_mutex);
-            m_address_cache.clear();
+        if(!m_config.address_cache.persist_path.empty()) {
+            HERMES_DEBUG("  Persisting address cache");
+
+            try {
+                save_address_cache(m_config.address_cache.persist_path);
+            }
+            catch(const std::exception& ex) {
+                HERMES_WARNING("Failed to persist address cache: {}", 
+                               ex.what());
+            }
         }
 
+        HERMES_DEBUG("  Cleaning handle and address caches");
+        m_handle_cache.clear();
+        m_address_cache.clear();
+
         // we need to release the hg_addr_t contained in m_self_address
         // so that HG_Context_destroy() and HG_Finalize() work as expected
         m_self_address.reset();
 
-        if(m_hg_context != NULL) {
+        for(auto it = m_hg_contexts.rbegin(); 
+                 it != m_hg_contexts.rend(); ++it) {
+
             HERMES_DEBUG("  Destroying context");
-            const auto err = HG_Context_destroy(m_hg_context);
+            const auto err = HG_Context_destroy(*it);
 
             if(err != HG_SUCCESS) {
                 // can't throw here
@@ -200,190 +422,406 @@ public:
         return m_self_address->to_string();
     }
 
+    endpoint
+    lookup(const std::string& addr) const {
+        return lookup_endpoint(detail::string_ref(addr));
+    }
 
-    hg_return_t
-    wait_on(const lookup_ctx& ctx) const {
-        hg_return ret;
-        unsigned int actual_count;
+    endpoint
+    lookup(const char* addr) const {
+        return lookup_endpoint(detail::string_ref(addr));
+    }
 
-        while(!ctx.m_lookup_finished) {
-            do {
-                ret = HG_Trigger(m_hg_context,
-                                0,
-                                1,
-                                &actual_count);
-            } while((ret == HG_SUCCESS) &&
-                    (actual_count != 0) &&
-                    !ctx.m_lookup_finished);
+#if __cplusplus >= 201703L
+    endpoint
+    lookup(std::string_view addr) const {
+        return lookup_endpoint(detail::string_ref(addr));
+    }
+#endif // __cplusplus >= 201703L
 
-            if(!ctx.m_lookup_finished) {
-                ret = HG_Progress(m_hg_context,
-                                  100);
+    endpoint_set
+    lookup(std::initializer_list<std::string>&& addrs) const {
 
-                if(ret != HG_SUCCESS && ret != HG_TIMEOUT) {
-                    HERMES_WARNING("Unexpected return code {} from "
-                                   "HG_Progress: {}",
-                                   ret, HG_Error_to_string(ret));
-                    return ret;
-                }
-            }
+        std::set<std::string> unique_addrs(addrs);
+
+        endpoint_set endps;
+        endps.reserve(unique_addrs.size());
+
+        for(auto&& rv : lookup_batch(unique_addrs)) {
+            endps.emplace_back(std::move(rv).value());
         }
 
-        return HG_SUCCESS;
+        return endps;
     }
 
-    endpoint
-    lookup(const std::string& addr) const {
+    /**
+     * Look up all the addresses in @a addrs (any range of elements 
+     * convertible to std::string). All lookups that can't be served from
+     * the address cache are posted to Mercury at once, and the caller waits
+     * a single time for all of them to complete. The i-th element of the 
+     * returned vector contains either the endpoint for the i-th address or
+     * the error that prevented its lookup. A failed lookup does not affect 
+     * the rest of the batch.
+     */
+    template <typename AddressRange>
+    std::vector<result<endpoint>>
+    lookup_batch(const AddressRange& addrs) const {
 
-        HERMES_DEBUG("Looking up endpoint \"{}\"", addr);
+        using std::begin;
+        using std::end;
 
-        // if address contains a prefix, make sure that it matches 
-        // the transport protocol used by the engine
-        const auto pos = addr.rfind("://");
+        HERMES_DEBUG("Looking up a batch of endpoints");
 
-        if (pos != std::string::npos) {
-            // multiple URIs may be part of address string (e.g., if auto_sm is used)
-            // address delimiter defined in private Mercury header: src/mercury_core.c
-            auto pos_delim = addr.rfind('#');
-            if (pos_delim == std::string::npos) {
-                // try address delimiter of older Mercury versions
-                pos_delim = addr.rfind(';');
-            }
-            std::string transport_substr{};
-            if (pos_delim != std::string::npos) {
-                // handle ofi+verbs special cases which uses the `;` character: ofi+verbs;ofi_rxm://
-                if (m_transport == transport::ofi_verbs) {
-                    transport_substr = addr.substr(0, pos_delim) + addr.substr(pos, 3);
-                } else {
-                    // auto_sm address is used
-                    assert(pos_delim < pos);
-                    transport_substr = addr.substr(pos_delim + 1, (pos - pos_delim) + 2);
-                }
-            }
-            else {
-                transport_substr = addr.substr(0, pos + 3);
-            }
+        std::vector<result<endpoint>> results;
 
-            if (transport_substr != get_transport_lookup_prefix(m_transport)) {
-                throw std::runtime_error(
-                    "Transport protocol '" + transport_substr + "' in "
-                    "address does not match engine's configured tranport '" +
-                    get_transport_lookup_prefix(m_transport) + "'");
-            }
-        }
+        // the state lives on the heap so that it can be leaked if we have
+        // to give up while Mercury still holds pointers into it
+        std::unique_ptr<batch_lookup_ctx> ctx_ptr(new batch_lookup_ctx);
+        batch_lookup_ctx& ctx = *ctx_ptr;
+
+        // index of each address in ctx.m_entries, or npos if it was resolved
+        // without contacting Mercury
+        constexpr const std::size_t npos = static_cast<std::size_t>(-1);
+        std::vector<std::size_t> pending_index;
+        std::unordered_map<std::string, std::size_t> unique_lookups;
+
+        for(auto it = begin(addrs); it != end(addrs); ++it) {
+
+            try {
+                const detail::string_ref addr(*it);
+                const detail::address_key key = make_address_key(addr);
+                const auto cached = m_address_cache.find(key);
+
+                if(cached.m_address) {
+                    results.emplace_back(endpoint(cached.m_address));
+                    pending_index.emplace_back(npos);
+                    continue;
+                }
 
-        const std::string transport_address(
-                pos != std::string::npos ? addr :
-                get_transport_lookup_prefix(m_transport) + addr);
+                if(cached.m_error != HG_SUCCESS) {
+                    throw_lookup_error(key.str(), cached.m_error, true);
+                }
 
-        {
-            std::lock_guard<std::mutex> lock(m_addr_cache_mutex);
+                // duplicate addresses share the same lookup
+                const auto rv = unique_lookups.emplace(key.str(),
+                                                       ctx.m_entries.size());
 
-            const auto it = m_address_cache.find(transport_address);
+                if(rv.second) {
+                    ctx.m_entries.push_back({&ctx, rv.first->first, 
+                                             HG_ADDR_NULL, HG_SUCCESS});
+                }
 
-            if(it != m_address_cache.end()) {
-                HERMES_DEBUG("Endpoint \"{}\" cached {}", 
-                             addr, fmt::ptr(it->second.get()));
-                return endpoint(it->second);
+                results.emplace_back(std::exception_ptr{});
+                pending_index.emplace_back(rv.first->second);
             }
+            catch(const std::exception&) {
+                results.emplace_back(std::current_exception());
+                pending_index.emplace_back(npos);
+            }
+        }
+
+        if(ctx.m_entries.empty()) {
+            return results;
         }
 
         assert(m_hg_class);
-        assert(m_hg_context);
+        assert(!m_hg_contexts.empty());
 
-        lookup_ctx ctx(m_hg_class);
+        // ctx.m_entries must not be resized from now on, since Mercury
+        // keeps pointers to its elements
+        ctx.m_pending = ctx.m_entries.size();
 
-        hg_return_t ret = HG_Addr_lookup(
-            // Mercury execution context
-            const_cast<hg_context_t*>(m_hg_context),
-            // pointer to callback
-            [](const struct hg_cb_info* cbi) -> hg_return_t {
+        for(auto&& entry : ctx.m_entries) {
+
+            hg_return_t ret = HG_Addr_lookup(
+                m_hg_contexts.front(),
+                [](const struct hg_cb_info* cbi) -> hg_return_t {
 
-                auto* ctx = static_cast<lookup_ctx*>(cbi->arg);
+                    auto* entry = 
+                        static_cast<batch_lookup_ctx::entry*>(cbi->arg);
 
-                ctx->m_lookup_finished = true;
-                ctx->m_hg_addr = cbi->info.lookup.addr;
-                ctx->m_hg_ret = cbi->ret;
+                    entry->m_hg_addr = cbi->info.lookup.addr;
+                    entry->m_hg_ret = cbi->ret;
+
+                    entry->m_parent->complete_one();
 
-                if(cbi->ret != HG_SUCCESS) {
                     return cbi->ret;
-                }
+                },
+                static_cast<void*>(&entry),
+                entry.m_address.c_str(),
+                HG_OP_ID_IGNORE);
 
-                return HG_SUCCESS;
-            },
-            // pointer to data passed to callback
-            //static_cast<void*>(ctx.get()),
-            static_cast<void*>(&ctx),
-            // name to lookup
-            transport_address.c_str(),
-            // pointer to returned operation ID
-            HG_OP_ID_IGNORE);
+            HERMES_DEBUG2("HG_Addr_lookup({}, {}, {}, {}, HG_OP_ID_IGNORE) "
+                          "= {}", fmt::ptr(m_hg_contexts.front()), 
+                          "lambda::batch_callback", fmt::ptr(&entry), 
+                          entry.m_address, HG_Error_to_string(ret));
 
-        HERMES_DEBUG2("HG_Addr_lookup({}, {}, {}, {}, HG_OP_ID_IGNORE) = {}", 
-                      fmt::ptr(m_hg_context), "foo", fmt::ptr(&ctx), 
-                      transport_address, HG_Error_to_string(ret));
+            if(ret != HG_SUCCESS) {
+                entry.m_hg_ret = ret;
+                ctx.complete_one();
+            }
+        }
+
+        const hg_return_t ret = progress_or_wait(0,
+            [&ctx]() { 
+                return ctx.done(); 
+            },
+            [&ctx](std::chrono::milliseconds timeout) {
+                ctx.wait_for(timeout);
+            });
 
         if(ret != HG_SUCCESS) {
+            HERMES_FATAL("Unexpected return code {} from HG_Progress while "
+                         "waiting for lookups: {}", 
+                         ret, HG_Error_to_string(ret));
+
+            // pending callbacks may still reference ctx (and its entries)
+            // so we can't destroy it
+            (void) ctx_ptr.release();
+
             throw std::runtime_error(HG_Error_to_string(ret));
         }
 
-        ret = wait_on(ctx);
+        // cache successful lookups and build the endpoints/errors
+        std::vector<result<endpoint>> entry_results;
+        entry_results.reserve(ctx.m_entries.size());
 
-        if(ret != HG_SUCCESS) {
-            HERMES_DEBUG("Lookup request failed");
-            throw std::runtime_error(HG_Error_to_string(ret));
+        for(auto&& entry : ctx.m_entries) {
+
+            if(entry.m_hg_ret != HG_SUCCESS) {
+                HERMES_DEBUG("Lookup of \"{}\" failed: {}", 
+                             entry.m_address, 
+                             HG_Error_to_string(entry.m_hg_ret));
+
+                m_address_cache.insert_negative(entry.m_address, 
+                                                entry.m_hg_ret);
+
+                entry_results.emplace_back(
+                        lookup_error(entry.m_address, entry.m_hg_ret, false));
+                continue;
+            }
+
+            entry_results.emplace_back(endpoint(
+                    cache_address(entry.m_address, entry.m_hg_addr)));
+        }
+
+        for(std::size_t i = 0; i < results.size(); ++i) {
+            if(pending_index[i] != npos) {
+                results[i] = entry_results[pending_index[i]];
+            }
         }
 
-        assert(ctx.m_lookup_finished);
-        HERMES_DEBUG("Lookup request succeeded [hg_addr: {}]",
-                     fmt::ptr(ctx.m_hg_addr));
+        return results;
+    }
 
-        
-        std::pair<decltype(m_address_cache)::iterator, bool> rv;
+    /**
+     * Look up @a addr without blocking. @a callback is invoked with a 
+     * result<endpoint> once the lookup completes, from the thread that 
+     * drives progress for the engine (i.e. a progress thread or, with 
+     * external_progress, the thread calling trigger_ready()). If the address
+     * is already cached, @a callback is invoked before lookup_async() 
+     * returns. Callbacks should be short since they delay other completions.
+     */
+    template <typename Callable>
+    void
+    lookup_async(const std::string& addr, Callable&& callback) const {
+
+        HERMES_DEBUG("Looking up endpoint \"{}\" asynchronously", addr);
+
+        std::string transport_address;
+
+        try {
+            const detail::address_key key = make_address_key(addr);
+            const auto cached = m_address_cache.find(key);
+
+            if(cached.m_address) {
+                callback(result<endpoint>(endpoint(cached.m_address)));
+                return;
+            }
 
-        {
-            std::lock_guard<std::mutex> lock(m_addr_cache_mutex);
-            rv = m_address_cache.emplace(
-                    addr,
-                    std::make_shared<detail::address>(
-                        m_hg_class, ctx.m_hg_addr));
+            transport_address = key.str();
+
+            if(cached.m_error != HG_SUCCESS) {
+                throw_lookup_error(transport_address, cached.m_error, true);
+            }
+        }
+        catch(const std::exception&) {
+            callback(result<endpoint>(std::current_exception()));
+            return;
         }
 
-        return endpoint(rv.first->second);
+        post_lookup(std::move(transport_address), 
+                    std::forward<Callable>(callback));
     }
 
-    endpoint_set
-    lookup(std::initializer_list<std::string>&& addrs) const {
+    /**
+     * Look up @a addr without blocking, returning a future for the endpoint
+     * (see the callback version of lookup_async() for details)
+     */
+    std::future<endpoint>
+    lookup_async(const std::string& addr) const {
 
+        const auto promise = std::make_shared<std::promise<endpoint>>();
+        auto future = promise->get_future();
 
-        std::set<std::string> unique_addrs(addrs);
+        lookup_async(addr, [promise](result<endpoint>&& rv) {
+            if(rv) {
+                promise->set_value(std::move(rv).value());
+            }
+            else {
+                promise->set_exception(rv.error());
+            }
+        });
 
-        endpoint_set endps;
+        return future;
+    }
+
+    /**
+     * Return the counters of the engine's address cache
+     */
+    address_cache_stats
+    cache_stats() const {
+        return m_address_cache.stats();
+    }
+
+    /**
+     * Store the resolved addresses in the address cache into the file 
+     * @a path, using Mercury's serialized form of each address. Addresses 
+     * that the transport can't serialize are skipped. Returns the number of
+     * addresses stored.
+     */
+    std::size_t
+    save_address_cache(const std::string& path) const {
+
+#if defined(HG_VERSION_MAJOR) && HG_VERSION_MAJOR >= 2
+        std::vector<detail::address_cache_file::record> records;
+
+        m_address_cache.for_each([&](const std::string& key, 
+                    const std::shared_ptr<detail::address>& addr) {
+
+            const hg_size_t size = 
+                HG_Addr_get_serialize_size(m_hg_class, addr->m_hg_addr);
+
+            if(size == 0) {
+                return;
+            }
+
+            std::vector<char> buffer(size);
+
+            const hg_return_t ret = 
+                HG_Addr_serialize(buffer.data(), size, m_hg_class, 
+                                  addr->m_hg_addr);
+
+            HERMES_DEBUG2("HG_Addr_serialize({}, {}, {}, {}) = {}", 
+                          fmt::ptr(buffer.data()), size, 
+                          fmt::ptr(m_hg_class), fmt::ptr(addr->m_hg_addr), 
+                          HG_Error_to_string(ret));
+
+            if(ret != HG_SUCCESS) {
+                HERMES_DEBUG("Address \"{}\" can't be serialized: {}", 
+                             key, HG_Error_to_string(ret));
+                return;
+            }
+
+            records.emplace_back(key, std::move(buffer));
+        });
+
+        detail::address_cache_file::save(
+                path, get_transport_lookup_prefix(m_transport), records);
+
+        HERMES_DEBUG("Persisted {} addresses to \"{}\"", 
+                     records.size(), path);
+
+        return records.size();
+#else
+        (void) path;
+        throw std::runtime_error("Address serialization is not supported by "
+                                 "this version of Mercury");
+#endif
+    }
+
+    /**
+     * Add the addresses stored in @a path by save_address_cache() to the 
+     * address cache, so that looking them up doesn't require contacting 
+     * Mercury. Files written by engines using a different transport are 
+     * ignored, as are addresses that can't be deserialized. Returns the 
+     * number of addresses loaded.
+     *
+     * Note that a reloaded address is not validated: if the peer is no 
+     * longer listening on it, RPCs sent to it will fail instead of the 
+     * lookup.
+     */
+    std::size_t
+    load_address_cache(const std::string& path) {
+
+#if defined(HG_VERSION_MAJOR) && HG_VERSION_MAJOR >= 2
+        const auto records = detail::address_cache_file::load(
+                path, get_transport_lookup_prefix(m_transport));
 
-        // TODO: this waits on each individual lookup. Make it so that
-        // all lookups are posted to mercury and we only wait once on
-        // total completion
-        for(const auto& addr : unique_addrs) {
-            endps.emplace_back(lookup(addr));
+        std::size_t loaded = 0;
+
+        for(auto&& r : records) {
+
+            hg_addr_t hg_addr = HG_ADDR_NULL;
+
+            const hg_return_t ret = 
+                HG_Addr_deserialize(m_hg_class, &hg_addr, r.second.data(), 
+                                    r.second.size());
+
+            HERMES_DEBUG2("HG_Addr_deserialize({}, {}, {}, {}) = {}", 
+                          fmt::ptr(m_hg_class), fmt::ptr(&hg_addr), 
+                          fmt::ptr(r.second.data()), r.second.size(), 
+                          HG_Error_to_string(ret));
+
+            if(ret != HG_SUCCESS) {
+                HERMES_WARNING("Failed to deserialize address \"{}\": {}", 
+                               r.first, HG_Error_to_string(ret));
+                continue;
+            }
+
+            (void) cache_address(r.first, hg_addr);
+            ++loaded;
         }
 
-        return endps;
+        HERMES_DEBUG("Loaded {} addresses from \"{}\"", loaded, path);
+
+        return loaded;
+#else
+        (void) path;
+        throw std::runtime_error("Address serialization is not supported by "
+                                 "this version of Mercury");
+#endif
     }
 
     template <typename Request, typename Callable>
     void
     register_handler(Callable&& handler) {
+        register_handler<Request>(std::forward<Callable>(handler),
+                                  dispatch_policy::progress_thread);
+    }
 
-        const auto descriptor = 
-            std::static_pointer_cast<detail::request_descriptor<Request>>(
-                detail::registered_requests().at(Request::public_id));
-
-        if(!descriptor) {
-            throw std::runtime_error("Failed to register handler for request "
-                                     "of unknown type");
+    /**
+     * Register a handler for requests of type Request, choosing whether it
+     * should run inline in the progress thread or in the engine's handler
+     * thread pool (see dispatch_policy). In the latter case, the completion
+     * callbacks of async_pull()/async_push() operations for this request
+     * type also run in the pool.
+     */
+    template <typename Request, typename Callable>
+    void
+    register_handler(Callable&& handler, dispatch_policy policy) {
+
+        if(Request::public_id >= detail::first_reserved_public_id) {
+            throw std::invalid_argument(
+                    "Failed to register handler for request '" + 
+                    std::string(Request::name) + "': public ids from " + 
+                    std::to_string(detail::first_reserved_public_id) + 
+                    " onwards are reserved");
         }
 
-        descriptor->set_user_handler(std::forward<Callable>(handler));
+        set_handler<Request>(std::forward<Callable>(handler),
+                             policy == dispatch_policy::handler_pool ? 
+                                handler_pool() : nullptr);
     }
 
     /**
@@ -395,9 +833,149 @@ public:
         HERMES_DEBUG("Starting Mercury asynchronous engine");
 
         assert(m_hg_class);
-        assert(m_hg_context);
+        assert(!m_hg_contexts.empty());
+
+        if(m_external_progress) {
+            HERMES_DEBUG("  External progress mode: not starting progress "
+                         "threads");
+            return;
+        }
+
+        m_runners.reserve(m_hg_contexts.size());
+
+        for(std::size_t i = 0; i < m_hg_contexts.size(); ++i) {
+            m_runners.emplace_back(&async_engine::progress_thread, this, i);
+        }
+
+        m_progress_threads_running.store(true, std::memory_order_release);
+    }
+
+    /**
+     * Number of Mercury contexts managed by the engine
+     */
+    std::size_t
+    num_contexts() const {
+        return m_hg_contexts.size();
+    }
+
+    /**
+     * Return a file descriptor that becomes readable when there are network 
+     * events to process in the context @a index. It is meant to be added to
+     * an external event loop (e.g. epoll) by engines created with the
+     * external_progress option, which never start progress threads. 
+     *
+     * IMPORTANT: Before blocking on the descriptor, the event loop must call
+     * progress_once() and trigger_ready() until both report that there is
+     * nothing left to do, since some events may already have been consumed
+     * from the descriptor.
+     */
+    int
+    wait_fd(std::size_t index = 0) const {
+
+        check_external_progress(index);
+
+#if defined(HG_VERSION_MAJOR) && HG_VERSION_MAJOR >= 2
+        const int fd = HG_Event_get_wait_fd(m_hg_contexts[index]);
+
+        HERMES_DEBUG2("HG_Event_get_wait_fd(context={}) = {}", 
+                      fmt::ptr(m_hg_contexts[index]), fd);
+
+        if(fd < 0) {
+            throw std::runtime_error("Failed to retrieve wait descriptor "
+                                     "(is the NA layer in no-block mode?)");
+        }
+
+        return fd;
+#else
+        throw std::runtime_error("Wait descriptors are not supported by "
+                                 "this version of Mercury");
+#endif
+    }
+
+    /**
+     * Make progress on network operations for the context @a index, waiting
+     * at most @a timeout milliseconds for events to arrive. Returns true if 
+     * any progress was made, in which case trigger_ready() should be called 
+     * to run any completion callbacks.
+     */
+    bool
+    progress_once(std::size_t index = 0, unsigned int timeout = 0) {
+
+        check_external_progress(index);
 
-        m_runner = std::thread(&async_engine::progress_thread, this);
+        const progress_ownership ownership(m_progress_owners[index]);
+
+        // somebody else (e.g. call()) is already driving this context
+        if(!ownership) {
+            return false;
+        }
+
+        const hg_return_t ret = HG_Progress(m_hg_contexts[index], timeout);
+
+        HERMES_DEBUG4("HG_Progress(context={}, timeout={}) = {}", 
+                      fmt::ptr(m_hg_contexts[index]), timeout, 
+                      HG_Error_to_string(ret));
+
+        if(ret == HG_SUCCESS) {
+            return true;
+        }
+
+        if(ret == HG_TIMEOUT) {
+            return false;
+        }
+
+        throw std::runtime_error("Failed to make progress: " + 
+                std::string(HG_Error_to_string(ret)));
+    }
+
+    /**
+     * Run the callbacks of all operations completed in the context 
+     * @a index (including RPC handlers), and return how many were run.
+     *
+     * Both progress_once() and trigger_ready() return immediately without
+     * doing anything if another thread is driving progress on the context 
+     * (e.g. in call()).
+     */
+    std::size_t
+    trigger_ready(std::size_t index = 0) {
+
+        check_external_progress(index);
+
+        const progress_ownership ownership(m_progress_owners[index]);
+
+        // somebody else (e.g. call()) is already driving this context and
+        // will trigger any pending callbacks
+        if(!ownership) {
+            return 0;
+        }
+
+        hg_return_t ret;
+        unsigned int actual_count = 0;
+        std::size_t total = 0;
+
+        do {
+            ret = HG_Trigger(m_hg_contexts[index],
+                             0,
+                             m_config.progress.trigger_batch,
+                             &actual_count);
+
+            HERMES_DEBUG4("HG_Trigger(context={}, timeout={}, "
+                          "max_count={}, actual_count={}) = {}", 
+                          fmt::ptr(m_hg_contexts[index]), 0, 
+                          m_config.progress.trigger_batch, actual_count, 
+                          HG_Error_to_string(ret));
+
+            if(ret == HG_SUCCESS) {
+                total += actual_count;
+            }
+        } while(ret == HG_SUCCESS && actual_count != 0);
+
+        if(ret != HG_SUCCESS && ret != HG_TIMEOUT) {
+            throw std::runtime_error("Failed to trigger callbacks: " + 
+                    std::string(HG_Error_to_string(ret)));
+        }
+
+        return total;
     }
 
     template <typename BufferSequence>
@@ -405,7 +983,6 @@ public:
     expose(BufferSequence&& bufseq, 
            access_mode mode) {
 
-        assert(m_hg_context);
         assert(m_hg_class);
 
         return {m_hg_class, mode, std::forward<BufferSequence>(bufseq)};
@@ -423,17 +1000,84 @@ public:
         HERMES_DEBUG2("Posting RPC to endpoint {}", 
                       target.address()->to_string());
 
-        auto handle = Handle(m_hg_context, 
-                             {target.address()},
+        auto handle = Handle([this]() { return next_slot(); },
+                             target.address(),
                              Input(std::forward<Args>(args)...));
 
         const auto& ctx = handle.m_ctxs[0];
 
-        hg_return ret = detail::post_to_mercury(ctx.get());
+        std::exception_ptr eptr;
 
-        if(ret != HG_SUCCESS) {
+        try {
+            const hg_return_t ret = detail::post_to_mercury(ctx.get());
+
+            if(ret != HG_SUCCESS) {
+                eptr = std::make_exception_ptr(
+                        std::runtime_error("Failed to post RPC: " + 
+                            std::string(HG_Error_to_string(ret))));
+            }
+        }
+        catch(...) {
+            eptr = std::current_exception();
+        }
 
+        if(eptr) {
+            // complete the RPC with the error so that the handle doesn't
+            // wait for it when it goes out of scope (this also drops the
+            // reference held on behalf of the RPC)
             ctx->m_status = detail::request_status::failed;
+            detail::discard_mercury_handle(ctx.get());
+            ctx->set_error(eptr);
+
+            std::rethrow_exception(eptr);
+        }
+
+        return handle;
+    }
+
+
+    /**
+     * Send an RPC to @a target, returning a single_rpc_handle whose get() 
+     * returns the RPC's output directly. Unlike post(), the handle can't 
+     * hold several RPCs and doesn't wait for the RPC when destroyed, so it
+     * is slightly cheaper to manage.
+     */
+    template <typename Request, typename Endpoint, typename... Args>
+    single_rpc_handle<Request>
+    post_one(Endpoint&& target,
+             Args&&... args) {
+
+        using Input = typename Request::input_type;
+        using Context = detail::single_context<Request>;
+
+        HERMES_DEBUG2("Posting RPC to endpoint {}", 
+                      target.address()->to_string());
+
+        // the handle owns the context's first reference
+        single_rpc_handle<Request> handle(
+                new Context(next_slot(), target.address(), 
+                            Input(std::forward<Args>(args)...)));
+
+        Context* const ctx = handle.m_ctx;
+
+        // ...and the RPC owns the second one until it completes
+        ctx->acquire();
+
+        hg_return_t ret;
+
+        try {
+            ret = detail::post_to_mercury(ctx);
+        }
+        catch(...) {
+            ctx->release();
+            throw;
+        }
+
+        if(ret != HG_SUCCESS) {
+
+            ctx->m_status = detail::request_status::failed;
+            detail::discard_mercury_handle(ctx);
+            ctx->release();
 
             throw std::runtime_error("Failed to post RPC: " + 
                     std::string(HG_Error_to_string(ret)));
@@ -442,312 +1086,2072 @@ public:
         return handle;
     }
 
+    /**
+     * Send one RPC per element of @a items, each one to its own target and
+     * with its own input: elements are pairs (or tuples) of an endpoint and
+     * the argument that the RPC's input is constructed from. All contexts 
+     * are allocated in a single block and all RPCs are forwarded in a 
+     * single pass once their inputs are ready, which is cheaper than 
+     * calling post() for each of them. Inputs are moved out of @a items if
+     * it is an rvalue. RPCs that can't be posted don't make the whole batch
+     * fail: their error is reported as their output instead.
+     */
+    template <typename Request, typename Range>
+    multi_rpc_handle<Request>
+    post_many(Range&& items) {
+
+        using Input = typename Request::input_type;
+        using Batch = detail::batch_state<Request>;
+
+        const auto count = static_cast<std::size_t>(
+                std::distance(std::begin(items), std::end(items)));
+
+        HERMES_DEBUG2("Posting {} RPCs to multiple endpoints", count);
+
+        // the handle owns the batch's first reference
+        multi_rpc_handle<Request> handle(new Batch(count));
+        Batch* const batch = handle.m_batch;
+
+        for(auto&& item : items) {
+            batch->emplace(next_slot(),
+                           std::get<0>(item).address(),
+                           Input(detail::forward_element<Range>(
+                                   std::get<1>(item))));
+        }
+
+        for(std::size_t i = 0; i < batch->size(); ++i) {
+
+            auto& ctx = batch->context(i);
+
+            // ...and each RPC owns another one until it completes
+            batch->acquire();
+
+            hg_return_t ret;
+
+            try {
+                ret = detail::post_to_mercury(&ctx);
+            }
+            catch(const std::exception& ex) {
+                HERMES_DEBUG2("Failed to post RPC: {}", ex.what());
+                ret = HG_OTHER_ERROR;
+            }
+
+            if(ret != HG_SUCCESS) {
+
+                ctx.m_status = detail::request_status::failed;
+                detail::discard_mercury_handle(&ctx);
+
+                ctx.set_error(std::make_exception_ptr(
+                        std::runtime_error("Failed to post RPC: " + 
+                            std::string(HG_Error_to_string(ret)))));
+            }
+        }
+
+        return handle;
+    }
+
+    /**
+     * Send an RPC to @a target and invoke @a callback with a 
+     * result<Request::output_type> once it completes (or with the error 
+     * that prevented it). The callback is invoked directly from the thread 
+     * that drives progress for the engine, and no futures are involved, so
+     * it should be short since it delays other completions. Unlike 
+     * rpc_handle::get(), the RPC is not subject to any timeout.
+     */
+    template <typename Request, 
+              typename Endpoint, 
+              typename Callable, 
+              typename... Args>
+    typename std::enable_if<
+        detail::is_completion_callback<Request, Callable>::value>::type
+    post(Endpoint&& target,
+         Callable&& callback,
+         Args&&... args) {
+
+        static_assert(Request::requires_response, 
+                      "callbacks require a request type that expects a "
+                      "response");
+
+        using Input = typename Request::input_type;
+        using Context = detail::callback_context<
+                            Request, typename std::decay<Callable>::type>;
+
+        HERMES_DEBUG2("Posting RPC to endpoint {} (callback)", 
+                      target.address()->to_string());
+
+        std::unique_ptr<Context> ctx(
+                new Context(next_slot(), 
+                            target.address(),
+                            typename std::decay<Callable>::type(
+                                std::forward<Callable>(callback)),
+                            Input(std::forward<Args>(args)...)));
+
+        hg_return_t ret = detail::post_to_mercury(ctx.get());
+
+        if(ret != HG_SUCCESS) {
+            detail::discard_mercury_handle(ctx.get());
+
+            throw std::runtime_error("Failed to post RPC: " + 
+                    std::string(HG_Error_to_string(ret)));
+        }
+
+        // the context belongs to the RPC from now on
+        ctx.release();
+    }
+
+    /**
+     * Send an RPC to @a target and wait for its output. If no other thread
+     * is driving progress for the Mercury context used (i.e. run() has not 
+     * been called, or the engine uses external_progress and the application
+     * is not progressing the context at the moment), the calling thread 
+     * drives progress itself and the output is delivered directly to it
+     * without any thread handoffs. Otherwise, this is equivalent to 
+     * post<Request>(target, args...).get(), except that the calling thread
+     * takes over driving progress if the other thread stops doing so 
+     * before the RPC completes (e.g. because it was itself in call()).
+     */
+    template <typename Request, typename Endpoint, typename... Args>
+    typename Request::output_type
+    call(Endpoint&& target,
+         Args&&... args) {
+
+        static_assert(Request::requires_response, 
+                      "call() requires a request type that expects a "
+                      "response");
+
+        using Input = typename Request::input_type;
+        using Context = detail::inline_context<Request>;
+
+        const auto slot = next_slot();
+        const std::size_t index = context_index(slot.m_hg_context);
+
+        const progress_ownership ownership(m_progress_owners[index]);
+
+        if(!ownership) {
+            auto handle = post_one<Request>(std::forward<Endpoint>(target),
+                                            std::forward<Args>(args)...);
+            return await_output(handle);
+        }
+
+        HERMES_DEBUG2("Calling RPC on endpoint {} (inline progress)", 
+                      target.address()->to_string());
+
+        auto ctx = compat::make_unique<Context>(
+                slot, target.address(), Input(std::forward<Args>(args)...));
+
+        hg_return_t ret = detail::post_to_mercury(ctx.get());
+
+        if(ret != HG_SUCCESS) {
+            ctx->m_status = detail::request_status::failed;
+            detail::discard_mercury_handle(ctx.get());
+
+            throw std::runtime_error("Failed to post RPC: " + 
+                    std::string(HG_Error_to_string(ret)));
+        }
+
+        const auto deadline = 
+            std::chrono::steady_clock::now() + detail::rpc_timeout();
+        hg_context_t* const hg_context = m_hg_contexts[index];
+
+        ret = make_progress(hg_context, [&ctx, &deadline]() {
+            return ctx->completed() || 
+                   std::chrono::steady_clock::now() > deadline;
+        });
+
+        if(ret == HG_SUCCESS && !ctx->completed()) {
+            HERMES_DEBUG2("Mercury request timed out, cancelling");
+
+            // the completion callback will report the timeout, unless it 
+            // completed the RPC in the meantime
+            (void) detail::cancel_mercury_rpc(ctx.get());
+
+            ret = make_progress(hg_context, [&ctx]() {
+                return ctx->completed();
+            });
+        }
+
+        if(ret != HG_SUCCESS) {
+            // the completion callback may still reference the context, so 
+            // we can't release it
+            (void) ctx.release();
+            throw std::runtime_error("Failed to make progress: " + 
+                    std::string(HG_Error_to_string(ret)));
+        }
+
+        // run any other callbacks that became ready while we were waiting,
+        // since whoever drives progress next may be blocked on wait_fd()
+        unsigned int actual_count = 0;
+
+        do {
+            ret = HG_Trigger(hg_context, 0, m_config.progress.trigger_batch,
+                             &actual_count);
+        } while(ret == HG_SUCCESS && actual_count != 0);
+
+        return ctx->take_output();
+    }
 
     template <typename Request, typename EndpointSet, typename... Args>
     typename Request::handle_type
     broadcast(EndpointSet&& targets,
               Args&&... args) {
 
-        using Input = typename Request::input_type;
-        // using Output = typename Request::output_type;
-        using Handle = typename Request::handle_type;
+        using Input = typename Request::input_type;
+        // using Output = typename Request::output_type;
+        using Handle = typename Request::handle_type;
+
+        HERMES_DEBUG2("Posting RPC to multiple endpoints");
+
+        std::vector<std::shared_ptr<detail::address>> addrs;
+        std::transform(targets.begin(), targets.end(),
+                       std::back_inserter(addrs),
+                       [](const endpoint& endp) {
+                           return endp.address();
+                       });
+
+        // all targets share a single copy of the input, which is also 
+        // encoded only once
+        auto handle = Handle([this]() { return next_slot(); },
+                             addrs, 
+                             detail::make_shared_input<Request>(
+                                 m_hg_class, 
+                                 Input(std::forward<Args>(args)...)));
+
+        // TODO: move to a private function in rpc_handle class
+        std::size_t i = 0;
+
+        for(const auto& ctx : handle.m_ctxs) {
+
+            hg_return ret;
+
+            try {
+                ret = detail::post_to_mercury(ctx.get());
+            }
+            catch(const std::exception& ex) {
+                HERMES_DEBUG2("Failed to post RPC: {}", ex.what());
+                ret = HG_OTHER_ERROR;
+            }
+
+            // if this submission fails, cancel all previously posted RPCs
+            if(ret != HG_SUCCESS) {
+
+                const auto eptr = std::make_exception_ptr(
+                        std::runtime_error("Failed to post RPC: " + 
+                            std::string(HG_Error_to_string(ret))));
+
+                detail::discard_mercury_handle(ctx.get());
+
+                // complete the RPCs that were never posted with the error,
+                // which also drops the references held on their behalf
+                for(std::size_t j = i; j < handle.m_ctxs.size(); ++j) {
+                    handle.m_ctxs[j]->m_status = 
+                        detail::request_status::failed;
+                    handle.m_ctxs[j]->set_error(eptr);
+                }
+
+                // the completion callbacks of the rest report them as 
+                // timed out
+                for(std::size_t j = 0; j < i; ++j) {
+                    (void) detail::cancel_mercury_rpc(
+                            handle.m_ctxs[j].get());
+                }
+
+                std::rethrow_exception(eptr);
+            }
+            
+            ++i;
+        }
+
+        return handle;
+        
+    }
+
+    /**
+     * Send an RPC to @a target whose result will be delivered to @a queue 
+     * once it completes. Returns the handle id that identifies the RPC in
+     * the queue's completions.
+     */
+    template <typename Request, typename Endpoint, typename... Args>
+    typename completion_queue<Request>::handle_id
+    post(completion_queue<Request>& queue,
+         Endpoint&& target,
+         Args&&... args) {
+
+        static_assert(Request::requires_response, 
+                      "completion queues require a request type that "
+                      "expects a response");
+
+        using Input = typename Request::input_type;
+        using Context = detail::queued_context<Request>;
+
+        HERMES_DEBUG2("Posting RPC to endpoint {} (completion queue)", 
+                      target.address()->to_string());
+
+        const auto id = queue.m_state->next_handle_id();
+
+        std::unique_ptr<Context> ctx(
+                new Context(queue.m_state, id, 0, next_slot(), 
+                            target.address(), 
+                            Input(std::forward<Args>(args)...)));
+
+        queue.m_state->add_in_flight(1);
+
+        hg_return_t ret;
+
+        // if the RPC can't be posted, the completion callback will never 
+        // run, so we need to make sure the queue doesn't wait for it
+        try {
+            ret = detail::post_to_mercury(ctx.get());
+        }
+        catch(...) {
+            discard_queued(std::move(ctx));
+            throw;
+        }
+
+        if(ret != HG_SUCCESS) {
+            discard_queued(std::move(ctx));
+
+            throw std::runtime_error("Failed to post RPC: " + 
+                    std::string(HG_Error_to_string(ret)));
+        }
+
+        // the context belongs to the RPC from now on
+        ctx.release();
+
+        return id;
+    }
+
+    /**
+     * Send an RPC to all @a targets, delivering each of their results to
+     * @a queue as soon as it completes. The index of each completion is the
+     * position of its target in @a targets. If the RPC can't be posted to 
+     * some target, the error is delivered to the queue as that target's 
+     * completion, and the rest of the RPCs are not affected.
+     */
+    template <typename Request, typename EndpointSet, typename... Args>
+    typename completion_queue<Request>::handle_id
+    broadcast(completion_queue<Request>& queue,
+              EndpointSet&& targets,
+              Args&&... args) {
+
+        static_assert(Request::requires_response, 
+                      "completion queues require a request type that "
+                      "expects a response");
+
+        using Input = typename Request::input_type;
+        using Context = detail::queued_context<Request>;
+
+        HERMES_DEBUG2("Posting RPC to multiple endpoints (completion queue)");
+
+        const auto id = queue.m_state->next_handle_id();
+
+        // all targets share a single copy of the input, which is also 
+        // encoded only once
+        const auto input = detail::make_shared_input<Request>(
+                m_hg_class, Input(std::forward<Args>(args)...));
+
+        // account for all RPCs at once so that the queue doesn't look empty
+        // if the first ones complete before the rest are posted
+        const std::size_t count = 
+            std::distance(std::begin(targets), std::end(targets));
+        queue.m_state->add_in_flight(count);
+
+        std::size_t i = 0;
+
+        for(const endpoint& endp : targets) {
+
+            std::unique_ptr<Context> ctx(
+                    new Context(queue.m_state, id, i++, next_slot(), 
+                                endp.address(), input));
+
+            std::exception_ptr eptr;
+
+            try {
+                const hg_return_t ret = detail::post_to_mercury(ctx.get());
+
+                if(ret != HG_SUCCESS) {
+                    eptr = std::make_exception_ptr(
+                            std::runtime_error("Failed to post RPC: " + 
+                                std::string(HG_Error_to_string(ret))));
+                }
+            }
+            catch(...) {
+                eptr = std::current_exception();
+            }
+
+            if(eptr) {
+                detail::discard_mercury_handle(ctx.get());
+                // delivering the error also destroys the context
+                ctx.release()->set_error(eptr);
+                continue;
+            }
+
+            // the context belongs to the RPC from now on
+            ctx.release();
+        }
+
+        return id;
+    }
+
+    /**
+     * Send an RPC to all @a targets through a tree of relays rather than
+     * directly: the client only sends it to (at most) @a fanout of the 
+     * targets, each of which runs it and relays it to (at most) @a fanout
+     * others, and so on. The outputs of each subtree are aggregated by 
+     * its relay, so the client only receives @a fanout responses. This 
+     * reduces the client's bandwidth to O(fanout) and the latency of the
+     * broadcast to O(log N) hops, at the cost of encoding the outputs once
+     * more at each level of the tree. The input is encoded only once, by
+     * the client.
+     *
+     * Targets must be served by listening engines (which relay requests
+     * automatically) and must be able to look each other up using the 
+     * addresses that the client knows them by.
+     */
+    template <typename Request, typename EndpointSet, typename... Args>
+    tree_rpc_handle<Request>
+    tree_broadcast(EndpointSet&& targets,
+                   std::size_t fanout,
+                   Args&&... args) {
+
+        static_assert(Request::requires_response, 
+                      "tree broadcasts require a request type that "
+                      "expects a response");
+
+        using Input = typename Request::input_type;
+        using MercuryInput = typename Request::mercury_input_type;
+        using State = detail::tree_state<Request>;
+
+        HERMES_DEBUG2("Posting RPC to multiple endpoints (fanout: {})", 
+                      fanout);
+
+        if(fanout == 0) {
+            throw std::invalid_argument("Invalid broadcast fanout");
+        }
+
+        const std::vector<endpoint> endps(std::begin(targets), 
+                                          std::end(targets));
+
+        Input input(std::forward<Args>(args)...);
+        const MercuryInput hg_input(input);
+
+        // the input is encoded here once, and relays forward it as is
+        detail::relay_in_t in;
+        in.m_request_id = Request::public_id;
+        in.m_fanout = static_cast<hg_uint32_t>(fanout);
+        in.m_payload = detail::encode_mercury_input<Request>(m_hg_class, 
+                                                             hg_input);
+
+        const auto state = std::make_shared<State>(endps.size());
+        hg_class_t* const hg_class = m_hg_class;
+        std::size_t first = 0;
+
+        for(const std::size_t count : 
+                detail::split_targets(endps.size(), fanout)) {
+
+            detail::relay_in_t subtree;
+            subtree.m_request_id = in.m_request_id;
+            subtree.m_fanout = in.m_fanout;
+            subtree.m_payload = in.m_payload;
+            subtree.m_targets.reserve(count);
+
+            for(std::size_t i = first; i < first + count; ++i) {
+                subtree.m_targets.emplace_back(endps[i].to_string());
+            }
+
+            try {
+                post<detail::relay_rpc>(endps[first],
+                    [state, hg_class, first, count](
+                            result<detail::relay_out_t>&& rv) {
+                        state->complete(hg_class, first, count, 
+                                        std::move(rv));
+                    }, std::move(subtree));
+            }
+            catch(const std::exception&) {
+                state->complete(hg_class, first, count,
+                        result<detail::relay_out_t>(std::current_exception()));
+            }
+
+            first += count;
+        }
+
+        return tree_rpc_handle<Request>(state);
+    }
+
+    // Collective operations among the members of a group, i.e. processes
+    // that all call the same operation, in the same order, with the same
+    // group and each with its own rank (its index in the group). The 
+    // members exchange messages directly with each other, so each member
+    // must have a listening engine (which receives the messages) and must
+    // be driving progress (e.g. through run()). Operations among groups of
+    // the same size that may run concurrently must use different tags. An
+    // operation throws if some member doesn't take part in it within 
+    // engine_config::collectives::timeout.
+    //
+    // Messages are received by the process' serving engine (see 
+    // serving_engine()) and left in a mailbox shared by all engines in the
+    // process, and operations block the calling thread until the messages
+    // they need arrive. Hence, they can't be called from a thread that 
+    // drives progress for the serving engine or for the calling engine 
+    // (e.g. from an RPC handler run by a progress thread rather than by 
+    // the handler pool), since no messages could be received until they 
+    // timed out: they throw std::logic_error instead.
+
+    /** Wait until all members of @a group have entered the barrier. Uses
+     * a dissemination barrier: ceil(log2 N) steps of one message each. */
+    void
+    barrier(const endpoint_set& group,
+            std::size_t rank,
+            std::uint64_t tag = 0) {
+
+        const auto n = check_group(group, rank);
+        check_collective_caller();
+        const auto deadline = collective_deadline();
+        const auto sends = std::make_shared<detail::collective_sends>();
+
+        detail::collective_key key{
+            tag, n, collectives().next_sequence(tag, n), 0,
+            static_cast<hg_uint32_t>(rank)};
+
+        HERMES_DEBUG2("Entering barrier (tag: {}, rank: {} of {})",
+                      tag, rank, n);
+
+        for(std::size_t dist = 1; dist < n; dist <<= 1, ++key.m_step) {
+
+            key.m_source = static_cast<hg_uint32_t>(rank);
+            collective_send(group[(rank + dist) % n], key, {}, sends);
+
+            key.m_source = static_cast<hg_uint32_t>((rank + n - dist) % n);
+            (void) collectives().take(key, deadline);
+        }
+
+        sends->wait_until(deadline);
+    }
+
+    /**
+     * Gather the @a data contributed by each member of @a group, returning
+     * the contributions of all members indexed by rank. Uses Bruck's
+     * algorithm, i.e. recursive doubling generalized to any number of
+     * members: in ceil(log2 N) steps, each member forwards all the
+     * contributions it has collected so far.
+     */
+    std::vector<std::vector<char>>
+    allgather(const endpoint_set& group,
+              std::size_t rank,
+              std::vector<char> data,
+              std::uint64_t tag = 0) {
+
+        const auto n = check_group(group, rank);
+        check_collective_caller();
+        const auto deadline = collective_deadline();
+        const auto sends = std::make_shared<detail::collective_sends>();
+
+        detail::collective_key key{
+            tag, n, collectives().next_sequence(tag, n), 0,
+            static_cast<hg_uint32_t>(rank)};
+
+        HERMES_DEBUG2("Entering allgather (tag: {}, rank: {} of {})",
+                      tag, rank, n);
+
+        // blocks[i] is the contribution of member (rank + i) % n
+        std::vector<std::vector<char>> blocks;
+        blocks.reserve(n);
+        blocks.emplace_back(std::move(data));
+
+        for(std::size_t dist = 1; dist < n; dist <<= 1, ++key.m_step) {
+
+            const std::size_t count = std::min(dist, n - dist);
+
+            detail::collective_blocks out;
+            out.m_blocks.assign(blocks.begin(), blocks.begin() + count);
+
+            key.m_source = static_cast<hg_uint32_t>(rank);
+            collective_send(group[(rank + n - dist) % n], key,
+                            detail::encode_with_proc(
+                                m_hg_class,
+                                detail::hg_proc_collective_blocks,
+                                &out),
+                            sends);
+
+            key.m_source = static_cast<hg_uint32_t>((rank + dist) % n);
+
+            detail::collective_blocks in;
+            detail::decode_with_proc(m_hg_class,
+                                     detail::hg_proc_collective_blocks,
+                                     collectives().take(key, deadline),
+                                     &in);
+
+            if(in.m_blocks.size() != count) {
+                throw std::runtime_error("Malformed allgather message from "
+                        "rank " + std::to_string(key.m_source));
+            }
+
+            for(auto&& b : in.m_blocks) {
+                blocks.emplace_back(std::move(b));
+            }
+        }
+
+        sends->wait_until(deadline);
+
+        std::vector<std::vector<char>> results(n);
+
+        for(std::size_t i = 0; i < n; ++i) {
+            results[(rank + i) % n] = std::move(blocks[i]);
+        }
+
+        return results;
+    }
+
+    /**
+     * Send @a parts[i] to the member of @a group with rank i, returning the
+     * parts sent to this member indexed by the sender's rank. Since each
+     * part has a single destination, every member sends N-1 messages,
+     * which are scheduled as a pairwise exchange (i.e. to rank + 1,
+     * rank + 2, ...) so that no member is the destination of all the
+     * others at once. Parts larger than engine_config::collectives::
+     * eager_limit are pulled by their receiver through a bulk transfer.
+     */
+    std::vector<std::vector<char>>
+    alltoall(const endpoint_set& group,
+             std::size_t rank,
+             std::vector<std::vector<char>> parts,
+             std::uint64_t tag = 0) {
+
+        const auto n = check_group(group, rank);
+        check_collective_caller();
+
+        if(parts.size() != n) {
+            throw std::invalid_argument("alltoall() requires one part for "
+                                        "each member of the group");
+        }
+
+        const auto deadline = collective_deadline();
+        const auto sends = std::make_shared<detail::collective_sends>();
+
+        detail::collective_key key{
+            tag, n, collectives().next_sequence(tag, n), 0,
+            static_cast<hg_uint32_t>(rank)};
+
+        HERMES_DEBUG2("Entering alltoall (tag: {}, rank: {} of {})",
+                      tag, rank, n);
+
+        for(std::size_t i = 1; i < n; ++i) {
+            const std::size_t dest = (rank + i) % n;
+            collective_send(group[dest], key, std::move(parts[dest]), sends);
+        }
+
+        std::vector<std::vector<char>> results(n);
+        results[rank] = std::move(parts[rank]);
+
+        for(std::size_t i = 1; i < n; ++i) {
+            key.m_source = static_cast<hg_uint32_t>((rank + n - i) % n);
+            results[key.m_source] = collectives().take(key, deadline);
+        }
+
+        sends->wait_until(deadline);
+
+        return results;
+    }
+
+    /**
+     * Pull the contents of @a origin_memory (exposed by the originator of 
+     * @a req) into @a local_memory, and invoke @a user_callback with the 
+     * request once the transfer completes. The callback runs in the 
+     * request's thread pool if it has one, and in the progress thread 
+     * otherwise. If it can also be invoked as 
+     * @a user_callback(request&&, bool), it is invoked as well if the 
+     * transfer fails, with false as second argument, so that the request 
+     * can still be responded to. Otherwise, the request of a failed 
+     * transfer is released without a response.
+     */
+    template <typename Input, typename Callable>
+    void async_pull(const exposed_memory& origin_memory,
+                    const exposed_memory& local_memory,
+                    request<Input>&& req,
+                    Callable&& user_callback) {
+
+        bulk_transfer(HG_BULK_PULL, origin_memory, local_memory, 
+                      std::move(req), user_callback);
+    }
+
+    /**
+     * Push the contents of @a local_memory into @a origin_memory (exposed 
+     * by the originator of @a req), and invoke @a user_callback with the 
+     * request once the transfer completes (see async_pull())
+     */
+    template <typename Input, typename Callable>
+    void async_push(const exposed_memory& local_memory,
+                    const exposed_memory& origin_memory,
+                    request<Input>&& req,
+                    Callable&& user_callback) {
+
+        bulk_transfer(HG_BULK_PUSH, origin_memory, local_memory,
+                      std::move(req), user_callback);
+    }
+
+    template <typename Request, typename... Args>
+    void
+    respond(request<Request>&& req, 
+            Args&&... args) const {
+
+        using output_type = typename Request::output_type;
+        using mercury_output_type = typename Request::mercury_output_type;
+
+        detail::mercury_respond(
+                std::move(req), 
+                mercury_output_type(
+                    output_type(std::forward<Args>(args)...)));
+    }
+
+    /**
+     * Respond to @a req with an output built from @a args, like respond(),
+     * but invoke @a user_callback once Mercury has actually sent the
+     * response. The callback receives the request back, along with whether
+     * the response was sent successfully, so that any per-request state 
+     * (e.g. memory exposed to the client through the output, or the 
+     * request itself) can be released or recycled at that point. As with
+     * bulk transfers, the callback runs in the request's thread pool if it
+     * has one, and in the progress thread otherwise, so it should not 
+     * block.
+     */
+    template <typename Request, typename Callable, typename... Args>
+    void
+    respond_async(request<Request>&& req, 
+                  Callable&& user_callback,
+                  Args&&... args) const {
+
+        using output_type = typename Request::output_type;
+        using mercury_output_type = typename Request::mercury_output_type;
+
+        // the request and the user callback are kept alive until Mercury
+        // invokes our completion_callback(), which hands them back
+        struct respond_context : public detail::pooled<respond_context> {
+            respond_context(request<Request>&& req, 
+                            Callable&& user_callback) :
+                m_request(std::move(req)),
+                m_user_callback(std::forward<Callable>(user_callback)),
+                m_sent(false) { }
+
+            request<Request> m_request;
+            std::function<void(request<Request>&&, bool)> m_user_callback;
+            bool m_sent;
+        };
+
+        struct deferred_callback {
+            void
+            operator()() {
+                m_ctx->m_user_callback(std::move(m_ctx->m_request), 
+                                       m_ctx->m_sent);
+            }
+
+            std::unique_ptr<respond_context> m_ctx;
+        };
+
+        auto ctx = compat::make_unique<respond_context>(
+                std::move(req), std::forward<Callable>(user_callback));
+
+        const auto completion_callback =
+                [](const struct hg_cb_info* cbi) -> hg_return_t {
+
+                    auto ctx = 
+                        std::unique_ptr<respond_context>(
+                                reinterpret_cast<respond_context*>(cbi->arg));
+
+                    ctx->m_sent = (cbi->ret == HG_SUCCESS);
+
+                    if(!ctx->m_sent) {
+                        HERMES_DEBUG("Response failed: {}", 
+                                     HG_Error_to_string(cbi->ret));
+                    }
+
+                    if(thread_pool* executor = executor_for<Request>()) {
+                        executor->submit(deferred_callback{std::move(ctx)});
+                        return HG_SUCCESS;
+                    }
+
+                    ctx->m_user_callback(std::move(ctx->m_request), 
+                                         ctx->m_sent);
+
+                    return HG_SUCCESS;
+                };
+
+        // the output is encoded by HG_Respond() itself, so it doesn't need
+        // to outlive this call
+        detail::mercury_respond<Request>(
+                ctx->m_request.mercury_handle(), 
+                mercury_output_type(
+                    output_type(std::forward<Args>(args)...)),
+                completion_callback,
+                ctx.get());
+
+        // Mercury owns the context from now on
+        ctx.release();
+    }
+
+    using mercury_log_fuction = int(FILE *stream, const char *format, ...);
+
+    void
+    set_mercury_log_function(mercury_log_fuction fn) {
+        detail::set_mercury_log_function(fn);
+    }
+
+
+private:
+    /**
+     * Register RPCs into Mercury so that they can be called by the clients 
+     * of the asynchronous engine
+     */
+    void
+    register_rpcs() {
+
+        assert(m_hg_class);
+
+        detail::register_user_request_types();
+
+        // user requests must not take the ids of the engine's own requests
+        for(auto&& kv : detail::registered_requests()) {
+
+            const auto* descriptor = kv.second.get();
+
+            if(kv.first >= detail::first_reserved_public_id &&
+               descriptor != detail::descriptor_slot<detail::relay_rpc>() &&
+               descriptor != 
+                   detail::descriptor_slot<detail::collective_rpc>()) {
+                throw std::invalid_argument(
+                        "Invalid public id " + std::to_string(kv.first) + 
+                        " for request '" + descriptor->m_name + "': ids "
+                        "from " + 
+                        std::to_string(detail::first_reserved_public_id) +
+                        " onwards are reserved");
+            }
+        }
+
+        // requests used internally by the engine
+        (void) detail::registered_requests().add<detail::relay_rpc>();
+        (void) detail::registered_requests().add<detail::collective_rpc>();
+
+        for(auto&& kv : detail::registered_requests()) {
+
+            // auto&& id = kv.first;
+            auto&& descriptor = kv.second;
+
+            detail::register_mercury_rpc(m_hg_class, descriptor, m_listen);
+
+            HERMES_DEBUG("**** registered: {}, {}, {}, {}, {}",
+                    descriptor->m_id,
+                    descriptor->m_mercury_id,
+                    descriptor->m_name,
+                    reinterpret_cast<void*>(descriptor->m_mercury_input_cb),
+                    reinterpret_cast<void*>(descriptor->m_mercury_output_cb));
+        }
+    }
+
+    /**
+     * Adapt a callback that only takes the request to the signature used
+     * for bulk transfers: it's not invoked if the transfer fails
+     */
+    template <typename Input, typename Callable>
+    static std::function<void(request<Input>&&, bool)>
+    make_transfer_callback(Callable& user_callback, std::false_type) {
+
+        typename std::decay<Callable>::type fn(user_callback);
+
+        return [fn](request<Input>&& req, bool ok) mutable {
+            if(!ok) {
+                HERMES_WARNING("Bulk transfer failed: releasing request "
+                               "without a response");
+                return;
+            }
+
+            fn(std::move(req));
+        };
+    }
+
+    template <typename Input, typename Callable>
+    static std::function<void(request<Input>&&, bool)>
+    make_transfer_callback(Callable& user_callback, std::true_type) {
+        return user_callback;
+    }
+
+    /** Common implementation of async_pull() and async_push() */
+    template <typename Input, typename Callable>
+    void 
+    bulk_transfer(hg_bulk_op_t op, 
+                  const exposed_memory& origin_memory,
+                  const exposed_memory& local_memory,
+                  request<Input>&& req,
+                  Callable& user_callback) {
+
+        hg_bulk_t origin_bulk_handle = origin_memory.mercury_bulk_handle();
+        hg_bulk_t local_bulk_handle = local_memory.mercury_bulk_handle();
+
+        assert(origin_bulk_handle != HG_BULK_NULL);
+        assert(local_bulk_handle != HG_BULK_NULL);
+
+        // We need to allow custom user callbacks, but the Mercury API 
+        // restricts us in the prototypes that we can use. Since we don't
+        // want users to bother with Mercury internals, // we register our own
+        // completion_callback() lambda and we dynamically allocate
+        // a transfer_context with all the required information that we
+        // propagate through Mercury using the arg field in HG_Bulk_transfer().
+        // Once our callback is invoked, we can unpack the information, delete
+        // the transfer_context and invoke the actual user callback
+        struct transfer_context : public detail::pooled<transfer_context> {
+            transfer_context(request<Input>&& req, 
+                             std::function<void(request<Input>&&, bool)>&& 
+                                user_callback) :
+                m_request(std::move(req)),
+                m_user_callback(std::move(user_callback)),
+                m_ok(false) { }
+
+            ~transfer_context() {
+                HERMES_DEBUG("{}()", __func__);
+            }
+
+            request<Input> m_request;
+            // XXX For some reason, declaring m_user_callback as:
+            //    Callable m_user_callback;
+            // causes a weird bug with GCC 4.9 where any variables captured 
+            // by value in the lambda get corrupted. Replacing it with 
+            // std::function fixes this
+            std::function<void(request<Input>&&, bool)> m_user_callback;
+            bool m_ok;
+        };
+
+        struct deferred_callback {
+            void
+            operator()() {
+                m_ctx->m_user_callback(std::move(m_ctx->m_request), 
+                                       m_ctx->m_ok);
+            }
+
+            std::unique_ptr<transfer_context> m_ctx;
+        };
+
+        std::unique_ptr<transfer_context> ctx(
+            new transfer_context(std::move(req), 
+                make_transfer_callback<Input>(user_callback,
+                    detail::is_transfer_status_callback<Input, Callable>())));
+
+        const auto completion_callback =
+                [](const struct hg_cb_info* cbi) -> hg_return_t {
+
+                    // make sure that ctx is freed regardless of what might 
+                    // happen in m_user_callback()
+                    auto ctx = 
+                        std::unique_ptr<transfer_context>(
+                                reinterpret_cast<transfer_context*>(cbi->arg));
+
+                    ctx->m_ok = (cbi->ret == HG_SUCCESS);
+
+                    if(!ctx->m_ok) {
+                        HERMES_DEBUG("Bulk transfer failed: {}",
+                                     HG_Error_to_string(cbi->ret));
+                    }
+
+                    // if the request type is served by a thread pool, run
+                    // the user callback there too so that the progress 
+                    // thread can move on to other completions
+                    if(thread_pool* executor = executor_for<Input>()) {
+                        executor->submit(deferred_callback{std::move(ctx)});
+                        return HG_SUCCESS;
+                    }
+
+                    ctx->m_user_callback(std::move(ctx->m_request), 
+                                         ctx->m_ok);
+
+                    return HG_SUCCESS;
+                };
+
+        detail::mercury_bulk_transfer(ctx->m_request.mercury_handle(),
+                                      op,
+                                      origin_bulk_handle, 
+                                      local_bulk_handle, 
+                                      ctx.get(),
+                                      completion_callback);
+
+        // Mercury owns the context from now on
+        ctx.release();
+    }
+
+    /** Install @a handler for requests of type Request, to be run by 
+     * @a executor (or inline in the progress thread, if nullptr) */
+    template <typename Request, typename Callable>
+    static void
+    set_handler(Callable&& handler, thread_pool* executor) {
+
+        const auto descriptor = 
+            std::static_pointer_cast<detail::request_descriptor<Request>>(
+                detail::registered_requests().at(Request::public_id));
+
+        if(!descriptor) {
+            throw std::runtime_error("Failed to register handler for request "
+                                     "of unknown type");
+        }
+
+        descriptor->set_user_handler(std::forward<Callable>(handler));
+        descriptor->set_executor(executor);
+    }
+
+    /**
+     * Release a queued_context whose RPC could not be posted without 
+     * delivering anything to its queue
+     */
+    template <typename Request>
+    static void
+    discard_queued(std::unique_ptr<detail::queued_context<Request>> ctx) {
+
+        detail::discard_mercury_handle(ctx.get());
+        ctx->m_queue->remove_in_flight();
+    }
+
+    /** The listening engine that serves hermes' own requests (i.e. relays
+     * and collective messages) in this process. Request handlers are 
+     * registered for the whole process, so only the first listening engine
+     * created can serve them: a process that needs to take part in tree 
+     * broadcasts or collectives should only have one listening engine. */
+    static std::atomic<async_engine*>&
+    serving_engine() {
+        static std::atomic<async_engine*> engine(nullptr);
+        return engine;
+    }
+
+    /** The serving engine, provided that it's the one that received 
+     * @a req (or nullptr otherwise) */
+    template <typename Request>
+    static async_engine*
+    serving_engine_for(const request<Request>& req) {
+
+        async_engine* const engine = 
+            serving_engine().load(std::memory_order_acquire);
+
+        if(engine == nullptr) {
+            return nullptr;
+        }
+
+        const struct hg_info* hgi = HG_Get_info(req.mercury_handle());
+
+        if(hgi == nullptr || hgi->hg_class != engine->m_hg_class) {
+            return nullptr;
+        }
+
+        return engine;
+    }
+
+    static void
+    relay_handler(request<detail::relay_rpc>&& req) {
+
+        async_engine* const engine = serving_engine_for(req);
+
+        if(engine != nullptr) {
+            engine->serve_relay(std::move(req));
+            return;
+        }
+
+        HERMES_WARNING("Rejecting relay request: not received by the "
+                       "process' serving engine");
+
+        // fail all targets of the subtree so that the sender doesn't wait
+        // for a response until it times out
+        try {
+            detail::relay_out_t out;
+            out.m_entries.assign(
+                    req.args().m_targets.size(),
+                    detail::relay_error("Relays are only served by the "
+                                        "first listening engine of a "
+                                        "process"));
+
+            detail::mercury_respond(std::move(req), std::move(out));
+        }
+        catch(const std::exception& ex) {
+            HERMES_ERROR("Failed to respond to relay request: {}", ex.what());
+        }
+    }
+
+    /**
+     * Serve a relay request: run the relayed request on this server and
+     * relay it to the rest of the subtree, splitting it among (at most)
+     * m_fanout other relays. The response is sent once the outcomes of all
+     * targets in the subtree have been collected.
+     */
+    void
+    serve_relay(request<detail::relay_rpc>&& req) {
+
+        const auto in = 
+            std::make_shared<const detail::relay_in_t>(req.args());
+        const std::size_t n = in->m_targets.size();
+
+        HERMES_DEBUG2("Relaying request {} to {} targets", 
+                      in->m_request_id, n);
+
+        if(n == 0) {
+            respond(std::move(req), detail::relay_out_t{});
+            return;
+        }
+
+        const auto state = 
+            std::make_shared<detail::relay_state>(std::move(req), n);
+        const auto descriptor = 
+            detail::registered_requests().at(in->m_request_id);
+
+        if(!descriptor || in->m_payload.empty() || in->m_fanout == 0) {
+            fail_relayed(state, 0, n, "Invalid relay request");
+            return;
+        }
+
+        forward_relayed(state, *in, *descriptor, 0, 
+                        m_self_address->mercury_address());
+
+        std::size_t first = 1;
+
+        for(const std::size_t count : 
+                detail::split_targets(n - 1, in->m_fanout)) {
+            relay_subtree(state, in, descriptor, first, count);
+            first += count;
+        }
+    }
+
+    /** Hand the @a count targets starting at @a first over to the first of 
+     * them (or just send it the request, if it's the only one) */
+    void
+    relay_subtree(
+            const std::shared_ptr<detail::relay_state>& state,
+            const std::shared_ptr<const detail::relay_in_t>& in,
+            const std::shared_ptr<detail::request_descriptor_base>& 
+                descriptor,
+            std::size_t first,
+            std::size_t count) {
+
+        lookup_async(in->m_targets[first],
+            [this, state, in, descriptor, first, count](
+                    result<endpoint>&& rv) {
+
+                if(!rv) {
+                    fail_relayed(state, first, count, rv.error_message());
+                    return;
+                }
+
+                if(count == 1) {
+                    forward_relayed(state, *in, *descriptor, first,
+                                    rv.value().address()->mercury_address());
+                    return;
+                }
+
+                detail::relay_in_t subtree;
+                subtree.m_request_id = in->m_request_id;
+                subtree.m_fanout = in->m_fanout;
+                subtree.m_payload = in->m_payload;
+                subtree.m_targets.assign(
+                        in->m_targets.begin() + first,
+                        in->m_targets.begin() + first + count);
+
+                try {
+                    post<detail::relay_rpc>(rv.value(),
+                        [state, first, count](
+                                result<detail::relay_out_t>&& out) {
+
+                            if(!out) {
+                                fail_relayed(state, first, count, 
+                                             out.error_message());
+                                return;
+                            }
+
+                            if(out.value().m_entries.size() != count) {
+                                fail_relayed(state, first, count,
+                                             "Malformed relay response");
+                                return;
+                            }
+
+                            if(state->set(first, std::move(
+                                            out.value().m_entries))) {
+                                finish_relay(state);
+                            }
+                        }, std::move(subtree));
+                }
+                catch(const std::exception& ex) {
+                    fail_relayed(state, first, count, ex.what());
+                }
+            });
+    }
+
+    /** Send the relayed request to the target at @a index, whose address is
+     * @a hg_addr, without decoding its input */
+    void
+    forward_relayed(const std::shared_ptr<detail::relay_state>& state,
+                    const detail::relay_in_t& in,
+                    const detail::request_descriptor_base& descriptor,
+                    std::size_t index,
+                    hg_addr_t hg_addr) {
+
+        const auto slot = next_slot();
+        hg_handle_t handle = HG_HANDLE_NULL;
+
+        hg_return_t ret = HG_Create(
+                const_cast<hg_context_t*>(slot.m_hg_context), hg_addr, 
+                descriptor.m_mercury_id, &handle);
+
+        if(ret == HG_SUCCESS && slot.m_target_id != 0) {
+            ret = HG_Set_target_id(handle, slot.m_target_id);
+        }
+
+        auto* call = new detail::relayed_call{state, index, 
+                                              descriptor.m_requires_response,
+                                              descriptor.m_encoded_output};
+
+        // the payload is copied into the handle by HG_Forward() itself
+        detail::input_envelope input{nullptr, in.m_payload.data(), 
+                                     in.m_payload.size()};
+
+        if(ret == HG_SUCCESS) {
+#ifdef HERMES_MARGO_COMPATIBLE_MODE
+            ret = detail::margo::forward(handle, relayed_completion, call,
+                                         descriptor.m_forward_input_cb, 
+                                         &input);
+#else
+            ret = HG_Forward(handle, relayed_completion, call, &input);
+#endif // HERMES_MARGO_COMPATIBLE_MODE
+        }
+
+        HERMES_DEBUG2("HG_Forward(handle={}, relayed request={}, index={}) "
+                      "= {}", fmt::ptr(handle), in.m_request_id, index, 
+                      HG_Error_to_string(ret));
+
+        if(ret != HG_SUCCESS) {
+            if(handle != HG_HANDLE_NULL) {
+                HG_Destroy(handle);
+            }
+
+            delete call;
+            fail_relayed(state, index, 1, "Failed to post RPC: " + 
+                         std::string(HG_Error_to_string(ret)));
+        }
+    }
+
+    static hg_return_t
+    relayed_completion(const struct hg_cb_info* cbi) {
+
+        const std::unique_ptr<detail::relayed_call> call(
+                static_cast<detail::relayed_call*>(cbi->arg));
+
+        detail::relay_entry entry{HG_SUCCESS, {}};
+
+        if(cbi->ret != HG_SUCCESS) {
+            entry = detail::relay_error("Request failed: " + 
+                    std::string(HG_Error_to_string(cbi->ret)));
+        }
+        else if(call->m_requires_response) {
+            try {
+                entry.m_data = 
+                    call->m_encoded_output(cbi->info.forward.handle);
+            }
+            catch(const std::exception& ex) {
+                entry = detail::relay_error(ex.what());
+            }
+        }
+
+        HG_Destroy(cbi->info.forward.handle);
+
+        if(call->m_state->set(call->m_index, std::move(entry))) {
+            finish_relay(call->m_state);
+        }
+
+        return HG_SUCCESS;
+    }
+
+    static void
+    fail_relayed(const std::shared_ptr<detail::relay_state>& state,
+                 std::size_t first,
+                 std::size_t count,
+                 const std::string& message) {
+
+        std::vector<detail::relay_entry> entries(
+                count, detail::relay_error(message));
+
+        if(state->set(first, std::move(entries))) {
+            finish_relay(state);
+        }
+    }
+
+    /** Respond to a relay request once all of its targets have completed */
+    static void
+    finish_relay(const std::shared_ptr<detail::relay_state>& state) {
+        try {
+            detail::mercury_respond(state->take_request(), 
+                                    state->take_output());
+        }
+        catch(const std::exception& ex) {
+            HERMES_ERROR("Failed to respond to relay request: {}", ex.what());
+        }
+    }
+
+    /** Messages received by this process for collective operations */
+    static detail::collective_mailbox&
+    collectives() {
+        static detail::collective_mailbox mailbox;
+        return mailbox;
+    }
+
+    static hg_uint32_t
+    check_group(const endpoint_set& group, std::size_t rank) {
+
+        if(group.empty() || rank >= group.size()) {
+            throw std::invalid_argument("Invalid rank " + 
+                    std::to_string(rank) + " for a group of " + 
+                    std::to_string(group.size()) + " members");
+        }
+
+        return static_cast<hg_uint32_t>(group.size());
+    }
+
+    /** Whether the calling thread is driving progress for one of the 
+     * engine's contexts (e.g. it's running a handler in a progress thread) */
+    bool
+    drives_progress() const {
+
+        for(std::size_t i = 0; i < m_hg_contexts.size(); ++i) {
+            if(progress_ownership::held_by_this_thread(
+                        m_progress_owners[i])) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /** Reject collective operations from threads that the messages they 
+     * wait for depend on (see the comment above barrier()) */
+    void
+    check_collective_caller() const {
+
+        const async_engine* const serving = 
+            serving_engine().load(std::memory_order_acquire);
+
+        if(drives_progress() || 
+           (serving != nullptr && serving->drives_progress())) {
+            throw std::logic_error("Collective operations can't be called "
+                                   "from a thread that drives progress "
+                                   "(e.g. from an RPC handler run by a "
+                                   "progress thread)");
+        }
+    }
+
+    std::chrono::steady_clock::time_point
+    collective_deadline() const {
+        return std::chrono::steady_clock::now() + 
+               m_config.collectives.timeout;
+    }
+
+    /** Send the message identified by @a key to @a target, exposing its 
+     * payload for the target to pull if it's too large to send inline */
+    void
+    collective_send(const endpoint& target,
+                    const detail::collective_key& key,
+                    std::vector<char>&& payload,
+                    const std::shared_ptr<detail::collective_sends>& sends) {
+
+        detail::collective_in_t in;
+        in.m_key = key;
+        in.m_bulk = HG_BULK_NULL;
+
+        // the payload must live until the target acknowledges the message
+        std::shared_ptr<std::vector<char>> buffer;
+        exposed_memory memory;
+
+        if(payload.size() > m_config.collectives.eager_limit) {
+            buffer = std::make_shared<std::vector<char>>(std::move(payload));
+            memory = expose(std::vector<mutable_buffer>{
+                                mutable_buffer{buffer->data(), 
+                                               buffer->size()}},
+                            access_mode::read_only);
+            in.m_bulk = memory.mercury_bulk_handle();
+        }
+        else {
+            in.m_payload = std::move(payload);
+        }
+
+        sends->start();
+
+        try {
+            post<detail::collective_rpc>(target,
+                [sends, buffer, memory](
+                        result<detail::collective_out_t>&& rv) {
+
+                    if(!rv) {
+                        sends->complete(rv.error());
+                        return;
+                    }
+
+                    sends->complete(rv.value().m_status == HG_SUCCESS ? 
+                        nullptr :
+                        std::make_exception_ptr(std::runtime_error(
+                            "Failed to deliver collective message")));
+                }, std::move(in));
+        }
+        catch(const std::exception&) {
+            sends->complete(std::current_exception());
+        }
+    }
+
+    static void
+    collective_handler(request<detail::collective_rpc>&& req) {
+
+        async_engine* const engine = serving_engine_for(req);
+
+        if(engine != nullptr) {
+            engine->serve_collective(std::move(req));
+            return;
+        }
+
+        HERMES_WARNING("Rejecting collective message: not received by the "
+                       "process' serving engine");
+
+        try {
+            detail::mercury_respond(std::move(req), 
+                    detail::collective_out_t{HG_OTHER_ERROR});
+        }
+        catch(const std::exception& ex) {
+            HERMES_ERROR("Failed to respond to collective message: {}", 
+                         ex.what());
+        }
+    }
+
+    /** Deliver a collective message to the mailbox, pulling its payload 
+     * first if it wasn't sent inline, and acknowledge it */
+    void
+    serve_collective(request<detail::collective_rpc>&& req) {
+
+        auto in = req.args();
+
+        if(in.m_bulk == HG_BULK_NULL) {
+            collectives().deliver(in.m_key, std::move(in.m_payload));
+            respond(std::move(req), detail::collective_out_t{HG_SUCCESS});
+            return;
+        }
+
+        exposed_memory remote;
+        exposed_memory local;
+        std::shared_ptr<std::vector<char>> buffer;
+
+        try {
+            remote = exposed_memory(in.m_bulk);
+            buffer = std::make_shared<std::vector<char>>(remote.size());
+            local = expose(std::vector<mutable_buffer>{
+                               mutable_buffer{buffer->data(), 
+                                              buffer->size()}},
+                           access_mode::write_only);
+        }
+        catch(const std::exception& ex) {
+            HERMES_ERROR("Failed to receive collective message: {}", 
+                         ex.what());
+            respond(std::move(req), 
+                    detail::collective_out_t{HG_OTHER_ERROR});
+            return;
+        }
+
+        const detail::collective_key key = in.m_key;
+
+        const auto on_pulled = 
+            [this, key, buffer, local](
+                    request<detail::collective_rpc>&& req) {
+                collectives().deliver(key, std::move(*buffer));
+                respond(std::move(req), 
+                        detail::collective_out_t{HG_SUCCESS});
+            };
+
+        async_pull(remote, local, std::move(req), on_pulled);
+    }
+
+    /**
+     * Look up a single address, driving progress in the calling thread 
+     * whenever nobody else does (see progress_or_wait())
+     */
+    endpoint
+    lookup_endpoint(detail::string_ref addr) const {
+
+        HERMES_DEBUG("Looking up endpoint \"{}\"", addr.str());
+
+        const detail::address_key key = make_address_key(addr);
+        const auto cached = m_address_cache.find(key);
+
+        if(cached.m_address) {
+            HERMES_DEBUG("Endpoint \"{}\" cached {}", 
+                         addr.str(), fmt::ptr(cached.m_address.get()));
+            return endpoint(cached.m_address);
+        }
+
+        const std::string transport_address = key.str();
+
+        if(cached.m_error != HG_SUCCESS) {
+            throw_lookup_error(transport_address, cached.m_error, true);
+        }
+
+        assert(m_hg_class);
+        assert(!m_hg_contexts.empty());
+
+        const auto promise = std::make_shared<std::promise<endpoint>>();
+        auto future = promise->get_future();
+
+        // the callback only references the promise, so it can safely run 
+        // after we give up
+        post_lookup(transport_address, [promise](result<endpoint>&& rv) {
+            if(rv) {
+                promise->set_value(std::move(rv).value());
+            }
+            else {
+                promise->set_exception(rv.error());
+            }
+        });
+
+        const hg_return_t ret = progress_or_wait(0,
+            [&future]() {
+                return future.wait_for(std::chrono::seconds(0)) == 
+                       std::future_status::ready;
+            },
+            [&future](std::chrono::milliseconds timeout) {
+                (void) future.wait_for(timeout);
+            });
+
+        if(ret != HG_SUCCESS) {
+            HERMES_WARNING("Unexpected return code {} from HG_Progress: {}",
+                           ret, HG_Error_to_string(ret));
+            throw std::runtime_error(HG_Error_to_string(ret));
+        }
+
+        return future.get();
+    }
+
+    /**
+     * Post a lookup for @a transport_address to Mercury without checking the
+     * address cache. @a callback is invoked with a result<endpoint> once it
+     * completes (or immediately, if the lookup can't be posted)
+     */
+    template <typename Callable>
+    void
+    post_lookup(std::string transport_address, Callable&& callback) const {
+
+        assert(m_hg_class);
+        assert(!m_hg_contexts.empty());
+
+        auto ctx = compat::make_unique<async_lookup_ctx>(
+                this, std::move(transport_address), 
+                typename async_lookup_ctx::callback_type(
+                    std::forward<Callable>(callback)));
+
+        const hg_return_t ret = HG_Addr_lookup(
+            m_hg_contexts.front(),
+            [](const struct hg_cb_info* cbi) -> hg_return_t {
+
+                const std::unique_ptr<async_lookup_ctx> ctx(
+                        static_cast<async_lookup_ctx*>(cbi->arg));
 
-        HERMES_DEBUG2("Posting RPC to multiple endpoints");
+                try {
+                    if(cbi->ret != HG_SUCCESS) {
+                        ctx->m_engine->m_address_cache.insert_negative(
+                                ctx->m_address, cbi->ret);
+                        ctx->m_callback(result<endpoint>(
+                            lookup_error(ctx->m_address, cbi->ret, false)));
+                    }
+                    else {
+                        ctx->m_callback(result<endpoint>(endpoint(
+                            ctx->m_engine->cache_address(
+                                ctx->m_address, cbi->info.lookup.addr))));
+                    }
+                }
+                catch(const std::exception& ex) {
+                    HERMES_ERROR("Uncaught exception in lookup callback: {}",
+                                 ex.what());
+                }
 
-        std::vector<std::shared_ptr<detail::address>> addrs;
-        std::transform(targets.begin(), targets.end(),
-                       std::back_inserter(addrs),
-                       [](const endpoint& endp) {
-                           return endp.address();
-                       });
+                return cbi->ret;
+            },
+            static_cast<void*>(ctx.get()),
+            ctx->m_address.c_str(),
+            HG_OP_ID_IGNORE);
 
-        auto handle = Handle(m_hg_context, 
-                             addrs, 
-                             Input(std::forward<Args>(args)...));
+        HERMES_DEBUG2("HG_Addr_lookup({}, {}, {}, {}, HG_OP_ID_IGNORE) = {}", 
+                      fmt::ptr(m_hg_contexts.front()), 
+                      "lambda::async_callback", fmt::ptr(ctx.get()), 
+                      ctx->m_address, HG_Error_to_string(ret));
 
-        // TODO: move to a private function in rpc_handle class
-        std::size_t i = 0;
+        if(ret != HG_SUCCESS) {
+            ctx->m_callback(result<endpoint>(
+                    lookup_error(ctx->m_address, ret, false)));
+            return;
+        }
 
-        for(const auto& ctx : handle.m_ctxs) {
+        // Mercury owns the context now
+        (void) ctx.release();
+    }
 
-            //    auto input = MercuryInput(ctx->m_input);
-            hg_return ret = detail::post_to_mercury(ctx.get());
+    static std::exception_ptr
+    lookup_error(const std::string& transport_address, 
+                 hg_return_t error, 
+                 bool cached) {
+        return std::make_exception_ptr(std::runtime_error(
+                    "Failed to look up '" + transport_address + "': " +
+                    HG_Error_to_string(error) + 
+                    (cached ? " (cached)" : "")));
+    }
 
-            // if this submission fails, cancel all previously posted RPCs
-            if(ret != HG_SUCCESS) {
+    [[noreturn]] static void
+    throw_lookup_error(const std::string& transport_address, 
+                       hg_return_t error, 
+                       bool cached) {
+        std::rethrow_exception(lookup_error(transport_address, error, cached));
+    }
+
+    /**
+     * Insert a newly resolved address into the address cache (if another
+     * thread cached it in the meantime, @a hg_addr is freed and the cached
+     * address is returned instead)
+     */
+    std::shared_ptr<detail::address>
+    cache_address(const std::string& transport_address, 
+                  hg_addr_t hg_addr) const {
+        return m_address_cache.insert(
+                transport_address,
+                std::make_shared<detail::address>(m_hg_class, hg_addr));
+    }
 
-                ctx->m_status = detail::request_status::cancelled;
+    /**
+     * Validate @a addr and return its canonical form (i.e. prefixed with the
+     * engine's transport) to be used as a key for the address cache. The
+     * returned key refers to @a addr.
+     */
+    detail::address_key
+    make_address_key(detail::string_ref addr) const {
 
-                for(std::size_t j = 0; j < i; ++j) {
+        const detail::string_ref lookup_prefix = 
+            get_transport_lookup_prefix(m_transport);
 
+        // if address contains a prefix, make sure that it matches 
+        // the transport protocol used by the engine
+        const auto pos = addr.rfind("://");
 
-                    ret = HG_Cancel(handle.m_ctxs[i]->m_handle);
+        if(pos == detail::string_ref::npos) {
+            return {lookup_prefix, addr};
+        }
 
-                    if(ret != HG_SUCCESS) {
-                        HERMES_WARNING("Failed to cancel RPC: {}", 
-                                       HG_Error_to_string(ret));
-                    }
+        // multiple URIs may be part of address string (e.g., if auto_sm is 
+        // used) address delimiter defined in private Mercury header: 
+        // src/mercury_core.c
+        auto pos_delim = addr.rfind("#");
+        if (pos_delim == detail::string_ref::npos) {
+            // try address delimiter of older Mercury versions
+            pos_delim = addr.rfind(";");
+        }
 
+        bool matches = false;
+        std::string transport_substr{};
+
+        if (pos_delim != detail::string_ref::npos) {
+            // handle ofi+verbs special cases which uses the `;` character: 
+            // ofi+verbs;ofi_rxm://
+            if (m_transport == transport::ofi_verbs) {
+                const auto head = addr.substr(0, pos_delim);
+                const auto tail = addr.substr(pos, 3);
+                matches = 
+                    head.size() + tail.size() == lookup_prefix.size() &&
+                    head == lookup_prefix.substr(0, head.size()) &&
+                    tail == lookup_prefix.substr(head.size(), tail.size());
+
+                if(!matches) {
+                    transport_substr = head.str() + tail.str();
+                }
+            } else {
+                // auto_sm address is used
+                assert(pos_delim < pos);
+                const auto sub = 
+                    addr.substr(pos_delim + 1, (pos - pos_delim) + 2);
+                matches = (sub == lookup_prefix);
+
+                if(!matches) {
+                    transport_substr = sub.str();
                 }
+            }
+        }
+        else {
+            const auto sub = addr.substr(0, pos + 3);
+            matches = (sub == lookup_prefix);
 
-                throw std::runtime_error("Failed to post RPC: " + 
-                        std::string(HG_Error_to_string(ret)));
+            if(!matches) {
+                transport_substr = sub.str();
             }
-            
-            ++i;
         }
 
-        return handle;
-        
+        if (!matches) {
+            throw std::runtime_error(
+                "Transport protocol '" + transport_substr + "' in "
+                "address does not match engine's configured tranport '" +
+                lookup_prefix.str() + "'");
+        }
+
+        return {{}, addr};
     }
 
-    template <typename Input, typename Callable>
-    void async_pull(const exposed_memory& origin_memory,
-                    const exposed_memory& local_memory,
-                    request<Input>&& req,
-                    Callable&& user_callback) {
+    /**
+     * Scoped claim on the right to drive progress on a Mercury context.
+     * Evaluates to false if another thread holds it. Claims are reentrant:
+     * a thread that already drives progress on the context (e.g. a user 
+     * handler invoked from a progress thread) may claim it again, so that 
+     * it can keep driving progress instead of waiting for itself.
+     */
+    class progress_ownership {
 
-        hg_bulk_t origin_bulk_handle = origin_memory.mercury_bulk_handle();
-        hg_bulk_t local_bulk_handle = local_memory.mercury_bulk_handle();
+    public:
+        explicit progress_ownership(std::atomic<bool>& owner) :
+            m_owner(owner),
+            m_reentrant(held_by_this_thread(owner)),
+            m_acquired(m_reentrant || 
+                       !owner.exchange(true, std::memory_order_acquire)) { 
 
-        assert(origin_bulk_handle != HG_BULK_NULL);
-        assert(local_bulk_handle != HG_BULK_NULL);
+            if(m_acquired && !m_reentrant) {
+                held_flags().push_back(&m_owner);
+            }
+        }
 
-        // We need to allow custom user callbacks, but the Mercury API 
-        // restricts us in the prototypes that we can use. Since we don't
-        // want users to bother with Mercury internals, // we register our own
-        // completion_callback() lambda and we dynamically allocate
-        // a transfer_context with all the required information that we
-        // propagate through Mercury using the arg field in HG_Bulk_transfer().
-        // Once our callback is invoked, we can unpack the information, delete
-        // the transfer_context and invoke the actual user callback
-        struct transfer_context {
-            transfer_context(request<Input>&& req, 
-                             Callable&& user_callback) :
-                m_request(std::move(req)),
-                m_user_callback(user_callback) { }
+        progress_ownership(const progress_ownership&) = delete;
+        progress_ownership& operator=(const progress_ownership&) = delete;
 
-            ~transfer_context() {
-                HERMES_DEBUG("{}()", __func__);
+        ~progress_ownership() {
+            if(m_acquired && !m_reentrant) {
+                held_flags().pop_back();
+                m_owner.store(false, std::memory_order_release);
             }
+        }
 
-            request<Input> m_request;
-            // XXX For some reason, declaring m_user_callback as:
-            //    Callable m_user_callback;
-            // causes a weird bug with GCC 4.9 where any variables captured 
-            // by value in the lambda get corrupted. Replacing it with 
-            // std::function fixes this
-            std::function<void(request<Input>&&)> m_user_callback;
-        };
-
-        auto* ctx =
-            new transfer_context(std::move(req), 
-                                 user_callback);
+        explicit operator bool() const {
+            return m_acquired;
+        }
 
-        const auto completion_callback =
-                [](const struct hg_cb_info* cbi) -> hg_return_t {
+        static bool
+        held_by_this_thread(const std::atomic<bool>& owner) {
+            const auto& flags = held_flags();
+            return std::find(flags.begin(), flags.end(), &owner) != 
+                   flags.end();
+        }
 
-                    if(cbi->ret != HG_SUCCESS) {
-                        HERMES_DEBUG("Bulk transfer failed");
-                        return cbi->ret;
-                    }
+    private:
+        static std::vector<std::atomic<bool>*>&
+        held_flags() {
+            static thread_local std::vector<std::atomic<bool>*> flags;
+            return flags;
+        }
 
-                    // make sure that ctx is freed regardless of what might 
-                    // happen in m_user_callback()
-                    const auto ctx = 
-                        std::unique_ptr<transfer_context>(
-                                reinterpret_cast<transfer_context*>(cbi->arg));
+        std::atomic<bool>& m_owner;
+        const bool m_reentrant;
+        const bool m_acquired;
+    };
 
-                    ctx->m_user_callback(std::move(ctx->m_request));
+    /**
+     * Return the index of @a hg_context in m_hg_contexts
+     */
+    std::size_t
+    context_index(const hg_context_t* hg_context) const {
 
-                    return HG_SUCCESS;
-                };
+        if(m_hg_contexts.size() == 1) {
+            return 0;
+        }
 
-        detail::mercury_bulk_transfer(ctx->m_request.m_handle,
-                                      HG_BULK_PULL,
-                                      origin_bulk_handle, 
-                                      local_bulk_handle, 
-                                      ctx,
-                                      completion_callback);
+        const auto it = std::find(m_hg_contexts.begin(), m_hg_contexts.end(),
+                                  hg_context);
+        assert(it != m_hg_contexts.end());
+        return static_cast<std::size_t>(it - m_hg_contexts.begin());
     }
 
-    template <typename Input, typename Callable>
-    void async_push(const exposed_memory& local_memory,
-                    const exposed_memory& origin_memory,
-                    request<Input>&& req,
-                    Callable&& user_callback) {
+    /**
+     * Make sure that the caller is allowed to drive progress manually on the
+     * context @a index
+     */
+    void
+    check_external_progress(std::size_t index) const {
 
-        hg_bulk_t local_bulk_handle = local_memory.mercury_bulk_handle();
-        hg_bulk_t origin_bulk_handle = origin_memory.mercury_bulk_handle();
+        if(!m_external_progress) {
+            throw std::runtime_error("Engine was not created with the "
+                                     "external_progress option");
+        }
 
-        assert(local_bulk_handle != HG_BULK_NULL);
-        assert(origin_bulk_handle != HG_BULK_NULL);
+        if(index >= m_hg_contexts.size()) {
+            throw std::out_of_range("Invalid context index");
+        }
+    }
 
-        // We need to allow custom user callbacks, but the Mercury API 
-        // restricts us in the prototypes that we can use. Since we don't
-        // want users to bother with Mercury internals, // we register our own
-        // completion_callback() lambda and we dynamically allocate
-        // a transfer_context with all the required information that we
-        // propagate through Mercury using the arg field in HG_Bulk_transfer().
-        // Once our callback is invoked, we can unpack the information, delete
-        // the transfer_context and invoke the actual user callback
-        struct transfer_context {
-            transfer_context(request<Input>&& req, 
-                             Callable&& user_callback) :
-                m_request(std::move(req)),
-                m_user_callback(user_callback) { }
+    /**
+     * Return the engine's handler thread pool, creating it on first use
+     */
+    thread_pool*
+    handler_pool() {
 
-            ~transfer_context() {
-                HERMES_DEBUG("{}()", __func__);
-            }
+        std::call_once(m_handler_pool_once, [this]() {
+            const std::size_t threads = m_config.handlers.threads != 0 ?
+                m_config.handlers.threads : 
+                std::max(1u, std::thread::hardware_concurrency());
 
-            request<Input> m_request;
-            // XXX For some reason, declaring m_user_callback as:
-            //    Callable m_user_callback;
-            // causes a weird bug with GCC 4.9 where any variables captured 
-            // by value in the lambda get corrupted. Replacing it with 
-            // std::function fixes this
-            std::function<void(request<Input>&&)> m_user_callback;
-        };
+            m_handler_pool = compat::make_unique<thread_pool>(threads);
+        });
 
-        auto* ctx =
-            new transfer_context(std::move(req), 
-                                 user_callback);
+        return m_handler_pool.get();
+    }
 
-        const auto completion_callback =
-                [](const struct hg_cb_info* cbi) -> hg_return_t {
+    /**
+     * Return the thread pool that serves requests of type Request, or nullptr
+     * if they are served inline by the progress thread
+     */
+    template <typename Request>
+    static thread_pool*
+    executor_for() {
 
-                    if(cbi->ret != HG_SUCCESS) {
-                        HERMES_DEBUG("Bulk transfer failed");
-                        return cbi->ret;
-                    }
+        const auto descriptor = detail::descriptor_of<Request>();
 
-                    // make sure that ctx is freed regardless of what might 
-                    // happen in m_user_callback()
-                    const auto ctx = 
-                        std::unique_ptr<transfer_context>(
-                                reinterpret_cast<transfer_context*>(cbi->arg));
+        return descriptor ? descriptor->executor() : nullptr;
+    }
 
-                    ctx->m_user_callback(std::move(ctx->m_request));
+    /**
+     * Select the Mercury context that should be used to submit the next
+     * outgoing RPC, as well as the context it should be delivered to at the
+     * target. Contexts are selected in a round-robin fashion.
+     */
+    detail::dispatch_slot
+    next_slot() {
 
-                    return HG_SUCCESS;
-                };
+        if(m_hg_contexts.size() == 1 && 
+           m_config.progress.target_contexts == 1) {
+            return {m_hg_contexts.front(), 0, &m_handle_cache};
+        }
 
-        detail::mercury_bulk_transfer(ctx->m_request.m_handle,
-                                      HG_BULK_PUSH,
-                                      origin_bulk_handle, 
-                                      local_bulk_handle, 
-                                      ctx,
-                                      completion_callback);
+        const std::size_t n = 
+            m_next_slot.fetch_add(1, std::memory_order_relaxed);
+
+        return {m_hg_contexts[n % m_hg_contexts.size()],
+                static_cast<hg_uint8_t>(
+                    n % m_config.progress.target_contexts),
+                &m_handle_cache};
     }
 
-    template <typename Request, typename... Args>
-    void
-    respond(request<Request>&& req, 
-            Args&&... args) const {
+    /**
+     * Wait until @a done() returns true for an operation submitted to the
+     * context m_hg_contexts[index]. Whenever nobody else drives progress 
+     * on the context, the calling thread claims it and drives progress 
+     * itself. Otherwise, it waits with @a wait_for(timeout), which must 
+     * return early if the operation completes, and then tries to claim the
+     * context again: the current owner may be another thread in call() or
+     * lookup() that releases the context before this operation completes. 
+     * Returns HG_SUCCESS or the first unexpected error returned by 
+     * HG_Progress().
+     */
+    template <typename Predicate, typename Wait>
+    hg_return_t
+    progress_or_wait(std::size_t index, 
+                     Predicate&& done, 
+                     Wait&& wait_for) const {
 
-        using output_type = typename Request::output_type;
-        using mercury_output_type = typename Request::mercury_output_type;
+        while(!done()) {
 
-        detail::mercury_respond(
-                std::move(req), 
-                mercury_output_type(
-                    output_type(std::forward<Args>(args)...)));
-    }
+            {
+                const progress_ownership ownership(m_progress_owners[index]);
 
-    using mercury_log_fuction = int(FILE *stream, const char *format, ...);
+                if(ownership) {
+                    return make_progress(m_hg_contexts[index], done);
+                }
+            }
 
-    void
-    set_mercury_log_function(mercury_log_fuction fn) {
-        detail::set_mercury_log_function(fn);
-    }
+            // progress threads keep their contexts until shutdown, and the
+            // application is expected to keep driving an external_progress
+            // engine, so the claim only needs to be retried often when the 
+            // owner may be short-lived
+            const bool driven = m_external_progress || 
+                m_progress_threads_running.load(std::memory_order_acquire);
+
+            wait_for(std::chrono::milliseconds(driven ? 100 : 1));
+        }
 
+        return HG_SUCCESS;
+    }
 
-private:
     /**
-     * Register RPCs into Mercury so that they can be called by the clients 
-     * of the asynchronous engine
+     * Wait for the RPC of @a handle to complete and return its output, 
+     * driving progress on its context whenever nobody else does (see 
+     * progress_or_wait()). As with single_rpc_handle::get(), the RPC is 
+     * cancelled if it doesn't complete in time.
      */
-    void
-    register_rpcs() {
+    template <typename Request>
+    typename Request::output_type
+    await_output(single_rpc_handle<Request>& handle) {
 
-        assert(m_hg_class);
-        assert(m_hg_context);
+        using clock = std::chrono::steady_clock;
 
-        detail::register_user_request_types();
+        auto* const ctx = handle.m_ctx;
+        const std::size_t index = context_index(ctx->m_hg_context);
 
-        for(auto&& kv : detail::registered_requests()) {
+        const auto wait_for = [ctx](std::chrono::milliseconds timeout) {
+            (void) ctx->m_output.wait_until(clock::now() + timeout);
+        };
 
-            // auto&& id = kv.first;
-            auto&& descriptor = kv.second;
+        const auto deadline = clock::now() + detail::rpc_timeout();
 
-            detail::register_mercury_rpc(m_hg_class, descriptor, m_listen);
+        hg_return_t ret = progress_or_wait(index, 
+            [ctx, &deadline]() {
+                return ctx->m_output.completed() || 
+                       clock::now() > deadline;
+            }, wait_for);
 
-            HERMES_DEBUG("**** registered: {}, {}, {}, {}, {}",
-                    descriptor->m_id,
-                    descriptor->m_mercury_id,
-                    descriptor->m_name,
-                    reinterpret_cast<void*>(descriptor->m_mercury_input_cb),
-                    reinterpret_cast<void*>(descriptor->m_mercury_output_cb));
+        if(ret == HG_SUCCESS && !ctx->m_output.completed()) {
+            HERMES_DEBUG2("Mercury request timed out, cancelling");
+
+            // cancelling also needs progress, so keep driving it until the
+            // completion callback reports the timeout (or the output)
+            (void) detail::cancel_mercury_rpc(ctx);
+
+            ret = progress_or_wait(index, 
+                [ctx]() {
+                    return ctx->m_output.completed();
+                }, wait_for);
+        }
+
+        if(ret != HG_SUCCESS) {
+            // the handle keeps its own reference to the context, so the 
+            // completion callback can still run safely
+            throw std::runtime_error("Failed to make progress: " + 
+                    std::string(HG_Error_to_string(ret)));
         }
+
+        return handle.get();
     }
 
     /**
-     * Dedicated thread that drives Mercury progress
+     * Drive Mercury progress on @a hg_context according to the configured
+     * progress policy until @a done() returns true. Returns HG_SUCCESS or
+     * the first unexpected error returned by HG_Progress().
      */
-    void
-    progress_thread() {
+    template <typename Predicate>
+    hg_return_t
+    make_progress(hg_context_t* hg_context, Predicate&& done) const {
 
-        assert(m_hg_class);
-        assert(m_hg_context);
+        using clock = std::chrono::steady_clock;
+
+        const auto& cfg = m_config.progress;
 
-        hg_return ret;
+        hg_return_t ret;
         unsigned int actual_count;
+        auto last_event = clock::now();
+
+        while(!done()) {
+
+            bool triggered = false;
 
-        while(!m_shutdown) {
             do {
-                ret = HG_Trigger(m_hg_context,
+                ret = HG_Trigger(hg_context,
                                  0,
-                                 1,
+                                 cfg.trigger_batch,
                                  &actual_count);
 
                 HERMES_DEBUG4("HG_Trigger(context={}, timeout={}, "
                               "max_count={}, actual_count={}) = {}", 
-                              fmt::ptr(m_hg_context), 0, 1, actual_count, 
-                              HG_Error_to_string(ret));
+                              fmt::ptr(hg_context), 0, cfg.trigger_batch, 
+                              actual_count, HG_Error_to_string(ret));
+
+                triggered |= (ret == HG_SUCCESS && actual_count != 0);
 
             } while((ret == HG_SUCCESS) &&
                     (actual_count != 0) &&
-                    !m_shutdown);
+                    !done());
 
-            if(!m_shutdown) {
-                ret = HG_Progress(m_hg_context, 100);
+            if(done()) {
+                break;
+            }
 
-                HERMES_DEBUG4("HG_Progress(context={}, timeout={}) = {}", 
-                              fmt::ptr(m_hg_context), 100, 
-                              HG_Error_to_string(ret));
+            unsigned int timeout = cfg.block_timeout;
 
-                if(ret != HG_SUCCESS && ret != HG_TIMEOUT) {
-                    HERMES_FATAL("Unexpected return code {} from HG_Progress: "
-                                 "{}", ret, HG_Error_to_string(ret));
-                }
+            switch(cfg.mode) {
+                case progress_mode::busy_poll:
+                    timeout = 0;
+                    break;
+
+                case progress_mode::spin_then_block:
+                    if(triggered) {
+                        last_event = clock::now();
+                    }
+
+                    if(clock::now() - last_event < cfg.spin_window) {
+                        timeout = 0;
+                    }
+                    break;
+
+                default:
+                    break;
+            }
+
+            ret = HG_Progress(hg_context, timeout);
+
+            HERMES_DEBUG4("HG_Progress(context={}, timeout={}) = {}", 
+                          fmt::ptr(hg_context), timeout, 
+                          HG_Error_to_string(ret));
+
+            if(ret == HG_SUCCESS) {
+                last_event = clock::now();
+            }
+            else if(ret != HG_TIMEOUT) {
+                return ret;
+            }
+        }
+
+        return HG_SUCCESS;
+    }
+
+    /**
+     * Dedicated thread that drives Mercury progress for the context
+     * m_hg_contexts[index]
+     */
+    void
+    progress_thread(std::size_t index) {
+
+        assert(m_hg_class);
+        assert(index < m_hg_contexts.size());
+
+        hg_context_t* const hg_context = m_hg_contexts[index];
+
+        // progress threads own their context for as long as they run, but
+        // a call() started before run() may still be driving it
+        auto ownership = 
+            compat::make_unique<progress_ownership>(m_progress_owners[index]);
+
+        while(!*ownership) {
+            std::this_thread::yield();
+            ownership = compat::make_unique<progress_ownership>(
+                    m_progress_owners[index]);
+        }
+
+        while(!m_shutdown) {
+            const hg_return_t ret = make_progress(hg_context, [this]() {
+                return m_shutdown.load();
+            });
+
+            if(ret != HG_SUCCESS) {
+                HERMES_FATAL("Unexpected return code {} from HG_Progress: "
+                             "{}", ret, HG_Error_to_string(ret));
             }
         }
     }
 
     std::atomic<bool> m_shutdown;
     hg_class_t* m_hg_class;
-    hg_context_t* m_hg_context;
+    std::vector<hg_context_t*> m_hg_contexts;
+    // whether some thread is currently driving progress on each context
+    std::unique_ptr<std::atomic<bool>[]> m_progress_owners;
     bool m_listen;
+    const bool m_external_progress;
     const transport m_transport;
+    const engine_config m_config;
     std::unique_ptr<detail::address> m_self_address;
-    std::thread m_runner;
+    std::vector<std::thread> m_runners;
+    std::atomic<bool> m_progress_threads_running;
+    std::atomic<std::size_t> m_next_slot;
     pid_t m_parent_pid = 0;
 
-    mutable std::mutex m_addr_cache_mutex;
-    mutable std::unordered_map<
-        std::string, 
-        std::shared_ptr<detail::address>> m_address_cache;
+    std::once_flag m_handler_pool_once;
+    std::unique_ptr<thread_pool> m_handler_pool;
+
+    mutable detail::address_cache m_address_cache;
+    detail::handle_cache m_handle_cache;
 }; // class async_engine
 
 } // namespace hermes
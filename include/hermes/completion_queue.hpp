@@ -0,0 +1,311 @@
+#ifndef __HERMES_COMPLETION_QUEUE_HPP__
+#define __HERMES_COMPLETION_QUEUE_HPP__
+
+// C includes
+#include <mercury.h>
+
+// C++ includes
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+// project includes
+#include <hermes/result.hpp>
+#include <hermes/detail/execution_context.hpp>
+#include <hermes/detail/object_pool.hpp>
+#include <hermes/detail/request_status.hpp>
+
+namespace hermes {
+
+// defined elsewhere
+class async_engine;
+
+namespace detail {
+
+struct address;
+
+// defined in this file
+template <typename Request> struct completion_queue_state;
+
+} // namespace detail
+
+/**
+ * A queue where the results of RPCs are delivered in the order in which they
+ * complete, rather than in the order in which they were posted. Any number
+ * of post() and broadcast() calls can target the same queue (see the
+ * overloads of async_engine::post() and async_engine::broadcast() that take
+ * a completion_queue), and each of them is identified by the handle id
+ * they return. Each completed RPC produces exactly one completion, which
+ * holds its handle id, the index of its target in the broadcast (0 for
+ * post()) and either its output or the error that prevented it.
+ *
+ * Completions are produced by whoever drives progress for the engine (i.e.
+ * its progress threads or, with external_progress, the application).
+ * Unlike rpc_handle::get(), RPCs delivered to a queue are not subject to
+ * any timeout.
+ */
+template <typename Request>
+class completion_queue {
+
+    friend class async_engine;
+
+    using Output = typename Request::output_type;
+
+public:
+    using handle_id = std::uint64_t;
+
+    struct completion {
+
+        // an empty completion that try_pop()/pop_for() can fill
+        completion() :
+            handle(0),
+            index(0),
+            output(std::exception_ptr{}) { }
+
+        completion(handle_id h, std::size_t i, result<Output>&& rv) :
+            handle(h),
+            index(i),
+            output(std::move(rv)) { }
+
+        handle_id handle;
+        std::size_t index;
+        result<Output> output;
+    };
+
+    completion_queue() :
+        m_state(std::make_shared<detail::completion_queue_state<Request>>())
+    { }
+
+    completion_queue(const completion_queue& other) = delete;
+    completion_queue(completion_queue&& rhs) = default;
+    completion_queue& operator=(const completion_queue& other) = delete;
+    completion_queue& operator=(completion_queue&& rhs) = default;
+
+    /**
+     * Retrieve the next completion without blocking. Returns false if no
+     * RPC has completed since the last call.
+     */
+    bool
+    try_pop(completion& c) {
+        std::unique_lock<std::mutex> lock(m_state->m_mutex);
+        return m_state->pop_locked(c);
+    }
+
+    /**
+     * Wait for the next completion. Throws if there are neither completed
+     * nor in-flight RPCs, since the call would block forever.
+     */
+    completion
+    pop() {
+
+        std::unique_lock<std::mutex> lock(m_state->m_mutex);
+
+        m_state->m_cv.wait(lock, [this]() {
+            return !m_state->m_ready.empty() || m_state->m_in_flight == 0;
+        });
+
+        if(m_state->m_ready.empty()) {
+            throw std::logic_error("No RPCs pending in completion queue");
+        }
+
+        completion c = std::move(m_state->m_ready.front());
+        m_state->m_ready.pop_front();
+        return c;
+    }
+
+    /**
+     * Wait at most @a timeout for the next completion. Returns false if no
+     * RPC completed in the meantime, or if there are no in-flight RPCs.
+     */
+    template <typename Rep, typename Period>
+    bool
+    pop_for(completion& c,
+            const std::chrono::duration<Rep, Period>& timeout) {
+
+        std::unique_lock<std::mutex> lock(m_state->m_mutex);
+
+        m_state->m_cv.wait_for(lock, timeout, [this]() {
+            return !m_state->m_ready.empty() || m_state->m_in_flight == 0;
+        });
+
+        return m_state->pop_locked(c);
+    }
+
+    /** Number of RPCs posted to the queue that have not completed yet */
+    std::size_t
+    in_flight() const {
+        std::lock_guard<std::mutex> lock(m_state->m_mutex);
+        return m_state->m_in_flight;
+    }
+
+    /** Number of completions waiting to be retrieved */
+    std::size_t
+    ready() const {
+        std::lock_guard<std::mutex> lock(m_state->m_mutex);
+        return m_state->m_ready.size();
+    }
+
+    /** True if there are neither in-flight RPCs nor completions left */
+    bool
+    empty() const {
+        std::lock_guard<std::mutex> lock(m_state->m_mutex);
+        return m_state->m_in_flight == 0 && m_state->m_ready.empty();
+    }
+
+private:
+    // shared with the contexts of in-flight RPCs, so that the queue can be
+    // destroyed before all of them complete
+    std::shared_ptr<detail::completion_queue_state<Request>> m_state;
+};
+
+namespace detail {
+
+template <typename Request>
+struct completion_queue_state {
+
+    using completion = typename completion_queue<Request>::completion;
+
+    completion_queue_state() :
+        m_next_handle(0),
+        m_in_flight(0) { }
+
+    typename completion_queue<Request>::handle_id
+    next_handle_id() {
+        return m_next_handle.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void
+    add_in_flight(std::size_t n) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_in_flight += n;
+    }
+
+    // for RPCs that won't produce a completion (e.g. if they couldn't be
+    // posted). Waiters need to be woken up in case the queue became empty
+    void
+    remove_in_flight() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_in_flight;
+        }
+
+        m_cv.notify_all();
+    }
+
+    void
+    push(completion&& c) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_ready.emplace_back(std::move(c));
+            --m_in_flight;
+        }
+
+        m_cv.notify_one();
+    }
+
+    bool
+    pop_locked(completion& c) {
+
+        if(m_ready.empty()) {
+            return false;
+        }
+
+        c = std::move(m_ready.front());
+        m_ready.pop_front();
+        return true;
+    }
+
+    std::atomic<std::uint64_t> m_next_handle;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::size_t m_in_flight;
+    std::deque<completion> m_ready;
+};
+
+/**
+ * Execution context for RPCs whose result is delivered to a
+ * completion_queue. Contexts are owned by the RPC while it is in flight and
+ * release themselves once the result has been pushed to the queue.
+ */
+template <typename Request>
+struct queued_context : public pooled<queued_context<Request>> {
+
+    using value_type = Request;
+    using Input = typename Request::input_type;
+    using Output = typename Request::output_type;
+    using MercuryInput = typename Request::mercury_input_type;
+    using State = completion_queue_state<Request>;
+
+    // @a input is either the RPC's own input or the input shared by all
+    // targets of a broadcast (see rpc_input)
+    template <typename InputArg>
+    queued_context(const std::shared_ptr<State>& queue,
+                   std::uint64_t handle,
+                   std::size_t index,
+                   const dispatch_slot& slot,
+                   const std::shared_ptr<detail::address>& address,
+                   InputArg&& input) :
+        m_queue(queue),
+        m_handle_id(handle),
+        m_index(index),
+        m_hg_context(slot.m_hg_context),
+        m_target_id(slot.m_target_id),
+        m_handle_cache(slot.m_handle_cache),
+        m_handle(HG_HANDLE_NULL),
+        m_status(detail::request_status::created),
+        m_address(address),
+        m_input(std::forward<InputArg>(input)) { }
+
+    queued_context(const queued_context&) = delete;
+    queued_context& operator=(const queued_context&) = delete;
+
+    // completion interface used by post_to_mercury(). IMPORTANT: the
+    // context is destroyed once the result is delivered
+    void
+    set_output(Output&& output) {
+        complete(result<Output>(std::move(output)));
+    }
+
+    void
+    set_error(std::exception_ptr eptr) {
+        complete(result<Output>(eptr));
+    }
+
+    void
+    set_no_output() {
+        complete(result<Output>(std::make_exception_ptr(
+                std::logic_error("Request type does not expect a "
+                                 "response"))));
+    }
+
+    const std::shared_ptr<State> m_queue;
+    const std::uint64_t m_handle_id;
+    const std::size_t m_index;
+    const hg_context_t* const m_hg_context;
+    const hg_uint8_t m_target_id;
+    handle_cache* const m_handle_cache;
+    hg_handle_t m_handle;
+    std::atomic<detail::request_status> m_status;
+
+    const std::shared_ptr<detail::address> m_address;
+    rpc_input<Request> m_input;
+
+private:
+    void
+    complete(result<Output>&& rv) {
+        const std::unique_ptr<queued_context> self(this);
+        m_queue->push({m_handle_id, m_index, std::move(rv)});
+    }
+};
+
+} // namespace detail
+} // namespace hermes
+
+#endif // __HERMES_COMPLETION_QUEUE_HPP__
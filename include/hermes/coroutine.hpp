@@ -0,0 +1,494 @@
+#ifndef __HERMES_COROUTINE_HPP__
+#define __HERMES_COROUTINE_HPP__
+
+// C++20 coroutine support. This header is a no-op for older standards (or
+// compilers without coroutine support) so that it can always be included.
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+
+// C++ includes
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// project includes
+#include <hermes/async_engine.hpp>
+#include <hermes/exposed_memory.hpp>
+#include <hermes/logging.hpp>
+#include <hermes/request.hpp>
+#include <hermes/result.hpp>
+
+namespace hermes {
+namespace coro {
+
+namespace detail {
+
+/**
+ * State shared by all awaitables: the suspended coroutine and where it
+ * should be resumed once the operation completes.
+ *
+ * The operation may complete before await_suspend() returns (e.g. a lookup
+ * served from the address cache, or a fast RPC completed by a progress
+ * thread). Both sides exchange m_flag and whoever comes second is the one
+ * that continues the coroutine: if it's the completion, it resumes it; if
+ * it's await_suspend(), it returns false so that the coroutine continues
+ * without being suspended at all.
+ */
+class resumer {
+
+public:
+    resumer() = default;
+
+    // awaitables may be moved before being awaited (e.g. by resume_on()),
+    // but never once the operation has started
+    resumer(resumer&& rhs) noexcept :
+        m_flag(false),
+        m_continuation(rhs.m_continuation),
+        m_executor(rhs.m_executor),
+        m_submit(rhs.m_submit) { }
+
+    /**
+     * Resume the coroutine by submitting it to @a executor, which can be
+     * any object with a submit(Callable) member function (e.g. a
+     * hermes::thread_pool). The executor must outlive the operation.
+     */
+    template <typename Executor>
+    void
+    set_executor(Executor& executor) {
+        m_executor = &executor;
+        m_submit = [](void* ex, std::coroutine_handle<> h) {
+            static_cast<Executor*>(ex)->submit([h]() { h.resume(); });
+        };
+    }
+
+    void
+    set_continuation(std::coroutine_handle<> h) {
+        m_continuation = h;
+    }
+
+    /** Called by await_suspend() once the operation has been started */
+    bool
+    suspend() {
+        return !m_flag.exchange(true, std::memory_order_acq_rel);
+    }
+
+    /** Called by the operation's completion */
+    void
+    complete() {
+
+        if(!m_flag.exchange(true, std::memory_order_acq_rel)) {
+            // await_suspend() has not returned yet and will take care of
+            // continuing the coroutine
+            return;
+        }
+
+        if(m_submit) {
+            m_submit(m_executor, m_continuation);
+            return;
+        }
+
+        m_continuation.resume();
+    }
+
+private:
+    std::atomic<bool> m_flag{false};
+    std::coroutine_handle<> m_continuation;
+    void* m_executor = nullptr;
+    void (*m_submit)(void*, std::coroutine_handle<>) = nullptr;
+};
+
+/** CRTP base that provides resume_on() to all awaitables */
+template <typename Derived>
+class awaitable_base {
+
+public:
+    /**
+     * Resume the awaiting coroutine in @a executor rather than in the
+     * thread that completes the operation (by default, the thread that
+     * drives progress for the engine)
+     */
+    template <typename Executor>
+    Derived
+    resume_on(Executor& executor) && {
+        m_resumer.set_executor(executor);
+        return static_cast<Derived&&>(*this);
+    }
+
+    bool
+    await_ready() const noexcept {
+        return false;
+    }
+
+protected:
+    resumer m_resumer;
+};
+
+} // namespace detail
+
+/** Awaitable returned by coro::post() */
+template <typename Request>
+class post_awaitable :
+    public detail::awaitable_base<post_awaitable<Request>> {
+
+    using Input = typename Request::input_type;
+    using Output = typename Request::output_type;
+
+public:
+    post_awaitable(async_engine& engine, endpoint target, Input&& input) :
+        m_engine(engine),
+        m_target(std::move(target)),
+        m_input(std::move(input)) { }
+
+    bool
+    await_suspend(std::coroutine_handle<> h) {
+
+        this->m_resumer.set_continuation(h);
+
+        m_engine.post<Request>(m_target,
+            [this](result<Output>&& rv) {
+                m_result.emplace(std::move(rv));
+                this->m_resumer.complete();
+            }, std::move(m_input));
+
+        return this->m_resumer.suspend();
+    }
+
+    Output
+    await_resume() {
+        return std::move(*m_result).value();
+    }
+
+private:
+    async_engine& m_engine;
+    const endpoint m_target;
+    Input m_input;
+    std::optional<result<Output>> m_result;
+};
+
+/**
+ * Awaitable returned by coro::broadcast(). Each target gets its own RPC,
+ * posted through the callback version of async_engine::post(), and the
+ * coroutine is resumed once all of them have completed.
+ */
+template <typename Request>
+class broadcast_awaitable :
+    public detail::awaitable_base<broadcast_awaitable<Request>> {
+
+    using Input = typename Request::input_type;
+    using Output = typename Request::output_type;
+
+public:
+    broadcast_awaitable(async_engine& engine,
+                        std::vector<endpoint> targets,
+                        Input&& input) :
+        m_engine(engine),
+        m_targets(std::move(targets)),
+        m_input(std::move(input)) { }
+
+    broadcast_awaitable(broadcast_awaitable&& rhs) noexcept :
+        detail::awaitable_base<broadcast_awaitable<Request>>(std::move(rhs)),
+        m_engine(rhs.m_engine),
+        m_targets(std::move(rhs.m_targets)),
+        m_input(std::move(rhs.m_input)) { }
+
+    bool
+    await_suspend(std::coroutine_handle<> h) {
+
+        this->m_resumer.set_continuation(h);
+
+        m_results.resize(m_targets.size());
+
+        // the extra reference belongs to this loop, so that the coroutine
+        // is not resumed while RPCs are still being posted
+        m_pending.store(m_targets.size() + 1, std::memory_order_relaxed);
+
+        for(std::size_t i = 0; i < m_targets.size(); ++i) {
+            try {
+                m_engine.post<Request>(m_targets[i],
+                    [this, i](result<Output>&& rv) {
+                        m_results[i].emplace(std::move(rv));
+                        complete_one();
+                    }, Input(m_input));
+            }
+            catch(...) {
+                // report the error for this target and keep going, since
+                // RPCs already posted still reference this awaitable
+                m_results[i].emplace(std::current_exception());
+                complete_one();
+            }
+        }
+
+        complete_one();
+
+        return this->m_resumer.suspend();
+    }
+
+    /** Return the result of the RPC sent to each target, in order */
+    std::vector<result<Output>>
+    await_resume() {
+
+        std::vector<result<Output>> rv;
+        rv.reserve(m_results.size());
+
+        for(auto& r : m_results) {
+            rv.emplace_back(std::move(*r));
+        }
+
+        return rv;
+    }
+
+private:
+    void
+    complete_one() {
+        if(m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            this->m_resumer.complete();
+        }
+    }
+
+    async_engine& m_engine;
+    const std::vector<endpoint> m_targets;
+    const Input m_input;
+    std::vector<std::optional<result<Output>>> m_results;
+    std::atomic<std::size_t> m_pending{0};
+};
+
+/** Awaitable returned by coro::lookup() */
+class lookup_awaitable :
+    public detail::awaitable_base<lookup_awaitable> {
+
+public:
+    lookup_awaitable(const async_engine& engine, std::string address) :
+        m_engine(engine),
+        m_address(std::move(address)) { }
+
+    bool
+    await_suspend(std::coroutine_handle<> h) {
+
+        m_resumer.set_continuation(h);
+
+        m_engine.lookup_async(m_address, [this](result<endpoint>&& rv) {
+            m_result.emplace(std::move(rv));
+            m_resumer.complete();
+        });
+
+        return m_resumer.suspend();
+    }
+
+    endpoint
+    await_resume() {
+        return std::move(*m_result).value();
+    }
+
+private:
+    const async_engine& m_engine;
+    const std::string m_address;
+    std::optional<result<endpoint>> m_result;
+};
+
+/**
+ * Thrown by co_await coro::pull() and coro::push() if the transfer fails.
+ * The request is handed back through take_request(), so that the 
+ * coroutine can still respond to it.
+ */
+template <typename Request>
+class transfer_error : public std::runtime_error {
+
+public:
+    explicit transfer_error(request<Request>&& req) :
+        std::runtime_error("Bulk transfer failed"),
+        m_request(std::make_shared<request<Request>>(std::move(req))) { }
+
+    /** Take back the request (only once) */
+    request<Request>
+    take_request() const {
+        return std::move(*m_request);
+    }
+
+private:
+    // exceptions must be copyable, requests are not
+    std::shared_ptr<request<Request>> m_request;
+};
+
+/**
+ * Awaitable returned by coro::pull() and coro::push(). The request is
+ * handed back to the coroutine once the transfer completes, or through a
+ * transfer_error if it fails.
+ */
+template <typename Request, bool Pull>
+class transfer_awaitable :
+    public detail::awaitable_base<transfer_awaitable<Request, Pull>> {
+
+public:
+    transfer_awaitable(async_engine& engine,
+                       const exposed_memory& first,
+                       const exposed_memory& second,
+                       request<Request>&& req) :
+        m_engine(engine),
+        m_first(first),
+        m_second(second),
+        m_request(std::move(req)) { }
+
+    bool
+    await_suspend(std::coroutine_handle<> h) {
+
+        this->m_resumer.set_continuation(h);
+
+        const auto completion = [this](request<Request>&& req, bool ok) {
+            m_request.emplace(std::move(req));
+            m_ok = ok;
+            this->m_resumer.complete();
+        };
+
+        request<Request> req(std::move(*m_request));
+        m_request.reset();
+
+        if(Pull) {
+            m_engine.async_pull(m_first, m_second, std::move(req),
+                                completion);
+        }
+        else {
+            m_engine.async_push(m_first, m_second, std::move(req),
+                                completion);
+        }
+
+        return this->m_resumer.suspend();
+    }
+
+    request<Request>
+    await_resume() {
+
+        if(!m_ok) {
+            throw transfer_error<Request>(std::move(*m_request));
+        }
+
+        return std::move(*m_request);
+    }
+
+private:
+    async_engine& m_engine;
+    const exposed_memory& m_first;
+    const exposed_memory& m_second;
+    std::optional<request<Request>> m_request;
+    bool m_ok = false;
+};
+
+/**
+ * co_await coro::post<Request>(engine, target, args...) sends an RPC and
+ * suspends the calling coroutine until its output arrives. It is built
+ * directly on the callback version of async_engine::post(), so no futures
+ * are involved. Errors are rethrown in the coroutine.
+ */
+template <typename Request, typename... Args>
+post_awaitable<Request>
+post(async_engine& engine, const endpoint& target, Args&&... args) {
+    return {engine, target,
+            typename Request::input_type(std::forward<Args>(args)...)};
+}
+
+/**
+ * co_await coro::broadcast<Request>(engine, targets, args...) sends the
+ * same RPC to each endpoint in @a targets and suspends the calling
+ * coroutine until all of them complete. It returns one result per target
+ * (in the same order), so that a failed target doesn't hide the outputs of
+ * the others. Unlike async_engine::broadcast(), the input is encoded once
+ * per target.
+ */
+template <typename Request, typename EndpointSet, typename... Args>
+broadcast_awaitable<Request>
+broadcast(async_engine& engine, const EndpointSet& targets, Args&&... args) {
+    return {engine,
+            std::vector<endpoint>(targets.begin(), targets.end()),
+            typename Request::input_type(std::forward<Args>(args)...)};
+}
+
+/** co_await coro::lookup(engine, address) resolves @a address */
+inline lookup_awaitable
+lookup(const async_engine& engine, std::string address) {
+    return {engine, std::move(address)};
+}
+
+/**
+ * co_await coro::pull(engine, origin, local, std::move(req)) pulls
+ * @a origin into @a local (see async_engine::async_pull()) and returns
+ * @a req once the transfer completes, or throws a transfer_error with it 
+ * if the transfer fails. Both memory regions must outlive the transfer.
+ */
+template <typename Request>
+transfer_awaitable<Request, true>
+pull(async_engine& engine,
+     const exposed_memory& origin,
+     const exposed_memory& local,
+     request<Request>&& req) {
+    return {engine, origin, local, std::move(req)};
+}
+
+/**
+ * co_await coro::push(engine, local, origin, std::move(req)) pushes
+ * @a local into @a origin (see async_engine::async_push()) and returns
+ * @a req once the transfer completes, or throws a transfer_error with it 
+ * if the transfer fails. Both memory regions must outlive the transfer.
+ */
+template <typename Request>
+transfer_awaitable<Request, false>
+push(async_engine& engine,
+     const exposed_memory& local,
+     const exposed_memory& origin,
+     request<Request>&& req) {
+    return {engine, local, origin, std::move(req)};
+}
+
+/**
+ * Return type for coroutines that are started and then left to run on
+ * their own (e.g. RPC handlers written as coroutines). The coroutine
+ * starts running immediately and its frame is released when it finishes.
+ * Uncaught exceptions are logged.
+ */
+struct detached {
+
+    struct promise_type {
+
+        detached
+        get_return_object() noexcept {
+            return {};
+        }
+
+        std::suspend_never
+        initial_suspend() noexcept {
+            return {};
+        }
+
+        std::suspend_never
+        final_suspend() noexcept {
+            return {};
+        }
+
+        void
+        return_void() noexcept { }
+
+        void
+        unhandled_exception() noexcept {
+            try {
+                std::rethrow_exception(std::current_exception());
+            }
+            catch(const std::exception& ex) {
+                HERMES_ERROR("Uncaught exception in coroutine: {}",
+                             ex.what());
+            }
+            catch(...) {
+                HERMES_ERROR("Uncaught exception in coroutine");
+            }
+        }
+    };
+};
+
+} // namespace coro
+} // namespace hermes
+
+#endif // __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+
+#endif // __HERMES_COROUTINE_HPP__
@@ -0,0 +1,449 @@
+#ifndef __HERMES_DETAIL_ADDRESS_CACHE_HPP__
+#define __HERMES_DETAIL_ADDRESS_CACHE_HPP__
+
+// C includes
+#include <mercury.h>
+
+// C++ includes
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif // __cplusplus >= 201703L
+
+// project includes
+#include <hermes/make_unique.hpp>
+#include <hermes/detail/address.hpp>
+
+namespace hermes {
+
+/** Statistics of an engine's address cache */
+struct address_cache_stats {
+    std::uint64_t hits;
+    std::uint64_t misses;
+    std::uint64_t negative_hits;
+    std::uint64_t evictions;
+    std::size_t entries;
+};
+
+namespace detail {
+
+/** A non-owning reference to a sequence of characters (i.e. a minimal
+ * std::string_view that is also available in C++11) */
+class string_ref {
+
+public:
+    string_ref() :
+        m_data(""),
+        m_size(0) { }
+
+    string_ref(const char* data, std::size_t size) :
+        m_data(data),
+        m_size(size) { }
+
+    string_ref(const char* str) :
+        m_data(str),
+        m_size(std::strlen(str)) { }
+
+    string_ref(const std::string& str) :
+        m_data(str.data()),
+        m_size(str.size()) { }
+
+#if __cplusplus >= 201703L
+    string_ref(std::string_view str) :
+        m_data(str.data()),
+        m_size(str.size()) { }
+#endif // __cplusplus >= 201703L
+
+    const char*
+    data() const {
+        return m_data;
+    }
+
+    std::size_t
+    size() const {
+        return m_size;
+    }
+
+    bool
+    empty() const {
+        return m_size == 0;
+    }
+
+    std::string
+    str() const {
+        return {m_data, m_size};
+    }
+
+    string_ref
+    substr(std::size_t pos, std::size_t count) const {
+        return {m_data + pos, std::min(count, m_size - pos)};
+    }
+
+    /** Position of the last occurrence of @a needle, or npos */
+    std::size_t
+    rfind(const string_ref& needle) const {
+
+        if(needle.size() > m_size) {
+            return npos;
+        }
+
+        for(std::size_t i = m_size - needle.size() + 1; i-- > 0; ) {
+            if(std::memcmp(m_data + i, needle.data(), needle.size()) == 0) {
+                return i;
+            }
+        }
+
+        return npos;
+    }
+
+    bool
+    operator==(const string_ref& other) const {
+        return m_size == other.m_size &&
+               std::memcmp(m_data, other.m_data, m_size) == 0;
+    }
+
+    bool
+    operator!=(const string_ref& other) const {
+        return !(*this == other);
+    }
+
+    static constexpr const std::size_t npos = static_cast<std::size_t>(-1);
+
+private:
+    const char* m_data;
+    std::size_t m_size;
+};
+
+/**
+ * Key of an address_cache entry: the canonical form of an address, i.e. the
+ * address prefixed with the transport (e.g. "ofi+tcp://host:port"). Since
+ * users may provide addresses with or without prefix, the key is kept in
+ * two pieces so that lookups don't need to concatenate them.
+ */
+struct address_key {
+
+    std::string
+    str() const {
+        std::string key;
+        key.reserve(m_prefix.size() + m_address.size());
+        key.append(m_prefix.data(), m_prefix.size());
+        key.append(m_address.data(), m_address.size());
+        return key;
+    }
+
+    string_ref m_prefix;
+    string_ref m_address;
+};
+
+/**
+ * Cache of resolved Mercury addresses, split into independently locked
+ * shards. Each shard keeps its entries in LRU order and, if the cache is
+ * bounded, evicts the least recently used entry when full. Evicted
+ * addresses are freed as soon as no endpoint refers to them.
+ *
+ * Failed lookups can also be cached (for a limited time) as negative
+ * entries, so that unreachable peers are not looked up again and again.
+ */
+class address_cache {
+
+    using clock = std::chrono::steady_clock;
+
+    struct entry {
+        std::string m_key;
+        std::uint64_t m_hash;
+        std::shared_ptr<detail::address> m_address;
+        // only meaningful for negative entries (i.e. if !m_address)
+        hg_return_t m_error;
+        clock::time_point m_expiration;
+    };
+
+    using lru_list = std::list<entry>;
+
+    struct shard {
+        std::mutex m_mutex;
+        lru_list m_lru; // most recently used first
+        std::unordered_multimap<std::uint64_t, lru_list::iterator> m_index;
+    };
+
+public:
+    /** Result of a cache lookup */
+    struct lookup_result {
+        // the cached address, if any
+        std::shared_ptr<detail::address> m_address;
+        // if there was a (non-expired) negative entry, the error that was
+        // returned by the failed lookup. HG_SUCCESS otherwise
+        hg_return_t m_error;
+    };
+
+    /**
+     * @param capacity  maximum number of entries (0 for unbounded)
+     * @param num_shards  number of independently locked shards
+     * @param negative_ttl  how long failed lookups are remembered
+     *                      (0 disables negative caching)
+     */
+    address_cache(std::size_t capacity,
+                  std::size_t num_shards,
+                  std::chrono::milliseconds negative_ttl) :
+        m_shard_capacity(capacity == 0 ? 0 :
+                (capacity + num_shards - 1) / num_shards),
+        m_negative_ttl(negative_ttl),
+        m_hits(0),
+        m_misses(0),
+        m_negative_hits(0),
+        m_evictions(0) {
+
+        if(num_shards == 0) {
+            throw std::invalid_argument("Invalid number of address cache "
+                                        "shards");
+        }
+
+        m_shards.reserve(num_shards);
+
+        for(std::size_t i = 0; i < num_shards; ++i) {
+            m_shards.emplace_back(compat::make_unique<shard>());
+        }
+    }
+
+    lookup_result
+    find(const address_key& key) {
+
+        const std::uint64_t h = hash(key);
+        auto& s = shard_for(h);
+
+        std::lock_guard<std::mutex> lock(s.m_mutex);
+
+        const auto it = find_locked(s, key, h);
+
+        if(it == s.m_lru.end()) {
+            ++m_misses;
+            return {nullptr, HG_SUCCESS};
+        }
+
+        if(!it->m_address) {
+            if(clock::now() >= it->m_expiration) {
+                erase_locked(s, it);
+                ++m_misses;
+                return {nullptr, HG_SUCCESS};
+            }
+
+            ++m_negative_hits;
+            return {nullptr, it->m_error};
+        }
+
+        // move the entry to the front of the LRU list
+        s.m_lru.splice(s.m_lru.begin(), s.m_lru, it);
+        ++m_hits;
+        return {it->m_address, HG_SUCCESS};
+    }
+
+    /**
+     * Cache a resolved address under @a key (replacing any negative entry).
+     * If the address was already cached, the cached one is returned and
+     * @a address is discarded.
+     */
+    std::shared_ptr<detail::address>
+    insert(const std::string& key,
+           std::shared_ptr<detail::address> address) {
+
+        const std::uint64_t h = hash(address_key{key, {}});
+        auto& s = shard_for(h);
+
+        std::lock_guard<std::mutex> lock(s.m_mutex);
+
+        const auto it = find_locked(s, address_key{key, {}}, h);
+
+        if(it != s.m_lru.end()) {
+            if(it->m_address) {
+                s.m_lru.splice(s.m_lru.begin(), s.m_lru, it);
+                return it->m_address;
+            }
+
+            erase_locked(s, it);
+        }
+
+        insert_locked(s, {key, h, address, HG_SUCCESS, {}});
+        return address;
+    }
+
+    /** Remember that looking up @a key failed with @a error */
+    void
+    insert_negative(const std::string& key, hg_return_t error) {
+
+        if(m_negative_ttl.count() == 0) {
+            return;
+        }
+
+        const std::uint64_t h = hash(address_key{key, {}});
+        auto& s = shard_for(h);
+
+        std::lock_guard<std::mutex> lock(s.m_mutex);
+
+        const auto it = find_locked(s, address_key{key, {}}, h);
+
+        if(it != s.m_lru.end()) {
+            // never replace a valid address with a negative entry
+            if(it->m_address) {
+                return;
+            }
+
+            erase_locked(s, it);
+        }
+
+        insert_locked(s, {key, h, nullptr, error,
+                          clock::now() + m_negative_ttl});
+    }
+
+    /** Invoke @a fn(key, address) for each resolved address in the cache */
+    template <typename Callable>
+    void
+    for_each(Callable&& fn) const {
+        for(auto&& s : m_shards) {
+            std::lock_guard<std::mutex> lock(s->m_mutex);
+
+            for(auto&& e : s->m_lru) {
+                if(e.m_address) {
+                    fn(e.m_key, e.m_address);
+                }
+            }
+        }
+    }
+
+    void
+    clear() {
+        for(auto&& s : m_shards) {
+            std::lock_guard<std::mutex> lock(s->m_mutex);
+            s->m_index.clear();
+            s->m_lru.clear();
+        }
+    }
+
+    address_cache_stats
+    stats() const {
+
+        std::size_t entries = 0;
+
+        for(auto&& s : m_shards) {
+            std::lock_guard<std::mutex> lock(s->m_mutex);
+            entries += s->m_lru.size();
+        }
+
+        return {m_hits.load(), m_misses.load(), m_negative_hits.load(),
+                m_evictions.load(), entries};
+    }
+
+private:
+    // 64-bit FNV-1a, computed over the concatenation of the key's pieces
+    static std::uint64_t
+    hash(const address_key& key) {
+
+        std::uint64_t h = 14695981039346656037ULL;
+
+        const auto update = [&h](const string_ref& str) {
+            for(std::size_t i = 0; i < str.size(); ++i) {
+                h ^= static_cast<unsigned char>(str.data()[i]);
+                h *= 1099511628211ULL;
+            }
+        };
+
+        update(key.m_prefix);
+        update(key.m_address);
+
+        return h;
+    }
+
+    static bool
+    equals(const std::string& stored, const address_key& key) {
+
+        const auto& p = key.m_prefix;
+        const auto& a = key.m_address;
+
+        return stored.size() == p.size() + a.size() &&
+               stored.compare(0, p.size(), p.data(), p.size()) == 0 &&
+               stored.compare(p.size(), a.size(), a.data(), a.size()) == 0;
+    }
+
+    shard&
+    shard_for(std::uint64_t h) {
+
+        // FNV-1a barely changes the high bits for keys that only differ in
+        // their last characters (e.g. addresses with different ports), so 
+        // mix them first (MurmurHash3's finalizer) and then use the high 
+        // bits, so that shard selection is independent from the bucket 
+        // selection in the shard's index
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+
+        return *m_shards[(h >> 32) % m_shards.size()];
+    }
+
+    static lru_list::iterator
+    find_locked(shard& s, const address_key& key, std::uint64_t h) {
+
+        const auto range = s.m_index.equal_range(h);
+
+        for(auto it = range.first; it != range.second; ++it) {
+            if(equals(it->second->m_key, key)) {
+                return it->second;
+            }
+        }
+
+        return s.m_lru.end();
+    }
+
+    void
+    insert_locked(shard& s, entry&& e) {
+
+        if(m_shard_capacity != 0 && s.m_lru.size() >= m_shard_capacity) {
+            erase_locked(s, std::prev(s.m_lru.end()));
+            ++m_evictions;
+        }
+
+        const std::uint64_t h = e.m_hash;
+        s.m_lru.emplace_front(std::move(e));
+        s.m_index.emplace(h, s.m_lru.begin());
+    }
+
+    static void
+    erase_locked(shard& s, lru_list::iterator it) {
+
+        const auto range = s.m_index.equal_range(it->m_hash);
+
+        for(auto idx = range.first; idx != range.second; ++idx) {
+            if(idx->second == it) {
+                s.m_index.erase(idx);
+                break;
+            }
+        }
+
+        s.m_lru.erase(it);
+    }
+
+    const std::size_t m_shard_capacity;
+    const std::chrono::milliseconds m_negative_ttl;
+    std::vector<std::unique_ptr<shard>> m_shards;
+    std::atomic<std::uint64_t> m_hits;
+    std::atomic<std::uint64_t> m_misses;
+    std::atomic<std::uint64_t> m_negative_hits;
+    std::atomic<std::uint64_t> m_evictions;
+};
+
+} // namespace detail
+} // namespace hermes
+
+#endif // __HERMES_DETAIL_ADDRESS_CACHE_HPP__
@@ -0,0 +1,191 @@
+#ifndef __HERMES_DETAIL_ADDRESS_CACHE_FILE_HPP__
+#define __HERMES_DETAIL_ADDRESS_CACHE_FILE_HPP__
+
+// C++ includes
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace hermes {
+namespace detail {
+
+/**
+ * On-disk representation of an address cache: a list of canonical addresses
+ * with their Mercury serialized form (see HG_Addr_serialize()). The file
+ * records the transport lookup prefix the addresses were resolved with so
+ * that a file written by an engine using a different transport is ignored.
+ *
+ * Layout (integers in host byte order, since the file is only meant to be
+ * read back by the same host):
+ *
+ *   "HRMSADDR" | u32 version | u32 prefix size | prefix | u64 count |
+ *   count x (u32 key size | key | u64 blob size | blob)
+ */
+struct address_cache_file {
+
+    using record = std::pair<std::string, std::vector<char>>;
+
+    static constexpr const std::uint32_t version = 1;
+
+    /**
+     * Write @a records to @a path. The file is first written under a
+     * temporary name and then renamed so that readers never observe a
+     * partially written file.
+     */
+    static void
+    save(const std::string& path,
+         const std::string& prefix,
+         const std::vector<record>& records) {
+
+        const std::string tmp_path = path + ".tmp";
+
+        {
+            std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+
+            if(!out) {
+                throw std::runtime_error("Failed to open '" + tmp_path +
+                                         "' for writing");
+            }
+
+            out.write(magic(), std::strlen(magic()));
+            write_int(out, version);
+            write_string<std::uint32_t>(out, prefix.data(), prefix.size());
+            write_int<std::uint64_t>(out, records.size());
+
+            for(auto&& r : records) {
+                write_string<std::uint32_t>(out, r.first.data(),
+                                            r.first.size());
+                write_string<std::uint64_t>(out, r.second.data(),
+                                            r.second.size());
+            }
+
+            out.flush();
+
+            if(!out) {
+                throw std::runtime_error("Failed to write '" + tmp_path +
+                                         "'");
+            }
+        }
+
+        if(std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+            std::remove(tmp_path.c_str());
+            throw std::runtime_error("Failed to rename '" + tmp_path +
+                                     "' to '" + path + "'");
+        }
+    }
+
+    /**
+     * Read the records stored in @a path. Returns an empty vector if the
+     * file does not exist or was written for a transport other than
+     * @a prefix, and throws if it is corrupt.
+     */
+    static std::vector<record>
+    load(const std::string& path, const std::string& prefix) {
+
+        std::vector<record> records;
+        std::ifstream in(path, std::ios::binary);
+
+        if(!in) {
+            return records;
+        }
+
+        char file_magic[8];
+        in.read(file_magic, sizeof(file_magic));
+
+        if(!in ||
+           std::memcmp(file_magic, magic(), sizeof(file_magic)) != 0) {
+            throw std::runtime_error("'" + path + "' is not an address "
+                                     "cache file");
+        }
+
+        if(read_int<std::uint32_t>(in, path) != version) {
+            throw std::runtime_error("Unsupported version of address cache "
+                                     "file '" + path + "'");
+        }
+
+        if(read_string<std::uint32_t>(in, path) != prefix) {
+            return records;
+        }
+
+        const auto count = read_int<std::uint64_t>(in, path);
+
+        for(std::uint64_t i = 0; i < count; ++i) {
+            std::string key = read_string<std::uint32_t>(in, path);
+            std::string blob = read_string<std::uint64_t>(in, path);
+            records.emplace_back(std::move(key),
+                                 std::vector<char>(blob.begin(), blob.end()));
+        }
+
+        return records;
+    }
+
+private:
+    static const char*
+    magic() {
+        return "HRMSADDR";
+    }
+
+    // upper bound for strings read from the file, so that a corrupt size
+    // can't make us allocate an arbitrary amount of memory
+    static constexpr const std::uint64_t max_string_size = 1 << 20;
+
+    template <typename T>
+    static void
+    write_int(std::ofstream& out, T value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template <typename SizeType>
+    static void
+    write_string(std::ofstream& out, const char* data, std::size_t size) {
+        write_int(out, static_cast<SizeType>(size));
+        out.write(data, size);
+    }
+
+    template <typename T>
+    static T
+    read_int(std::ifstream& in, const std::string& path) {
+
+        T value;
+        in.read(reinterpret_cast<char*>(&value), sizeof(value));
+
+        if(!in) {
+            throw std::runtime_error("Address cache file '" + path +
+                                     "' is truncated");
+        }
+
+        return value;
+    }
+
+    template <typename SizeType>
+    static std::string
+    read_string(std::ifstream& in, const std::string& path) {
+
+        const std::uint64_t size = read_int<SizeType>(in, path);
+
+        if(size > max_string_size) {
+            throw std::runtime_error("Address cache file '" + path +
+                                     "' is corrupt");
+        }
+
+        std::string str(static_cast<std::size_t>(size), '\0');
+        in.read(&str[0], str.size());
+
+        if(!in) {
+            throw std::runtime_error("Address cache file '" + path +
+                                     "' is truncated");
+        }
+
+        return str;
+    }
+};
+
+} // namespace detail
+} // namespace hermes
+
+#endif // __HERMES_DETAIL_ADDRESS_CACHE_FILE_HPP__
@@ -0,0 +1,265 @@
+#ifndef __HERMES_DETAIL_COLLECTIVE_HPP__
+#define __HERMES_DETAIL_COLLECTIVE_HPP__
+
+// C includes
+#include <mercury.h>
+#include <mercury_proc.h>
+
+// C++ includes
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// project includes
+#include <hermes/logging.hpp>
+#include <hermes/detail/relay.hpp>
+
+namespace hermes {
+
+// defined elsewhere
+template <typename Request>
+class rpc_handle;
+
+namespace detail {
+
+/** Identifies a message of a collective operation (see collective_rpc) */
+struct collective_key {
+    // tag chosen by the members of the group
+    hg_uint64_t m_tag;
+    // number of members of the group
+    hg_uint32_t m_size;
+    // number of the collective operation within the group
+    hg_uint64_t m_sequence;
+    // step of the operation's algorithm the message belongs to
+    hg_uint32_t m_step;
+    // rank of the sender
+    hg_uint32_t m_source;
+
+    bool
+    operator<(const collective_key& other) const {
+        return std::tie(m_tag, m_size, m_sequence, m_step, m_source) <
+               std::tie(other.m_tag, other.m_size, other.m_sequence,
+                        other.m_step, other.m_source);
+    }
+};
+
+/** Input of a collective RPC: the message's payload is either sent inline
+ * or, if it is large, exposed by the sender for the receiver to pull */
+struct collective_in_t {
+    collective_key m_key;
+    std::vector<char> m_payload;
+    hg_bulk_t m_bulk;
+};
+
+/** Output of a collective RPC, sent once the payload has been delivered */
+struct collective_out_t {
+    hg_int32_t m_status;
+};
+
+inline hg_return_t
+hg_proc_collective_in_t(hg_proc_t proc, void* data) {
+
+    auto* in = static_cast<collective_in_t*>(data);
+    hg_return_t ret;
+
+    if((ret = hg_proc_hg_uint64_t(proc, &in->m_key.m_tag)) != HG_SUCCESS ||
+       (ret = hg_proc_hg_uint32_t(proc, &in->m_key.m_size)) != HG_SUCCESS ||
+       (ret = hg_proc_hg_uint64_t(proc,
+                                  &in->m_key.m_sequence)) != HG_SUCCESS ||
+       (ret = hg_proc_hg_uint32_t(proc, &in->m_key.m_step)) != HG_SUCCESS ||
+       (ret = hg_proc_hg_uint32_t(proc, &in->m_key.m_source)) != HG_SUCCESS ||
+       (ret = proc_bytes(proc, in->m_payload)) != HG_SUCCESS) {
+        return ret;
+    }
+
+    return hg_proc_hg_bulk_t(proc, &in->m_bulk);
+}
+
+inline hg_return_t
+hg_proc_collective_out_t(hg_proc_t proc, void* data) {
+    auto* out = static_cast<collective_out_t*>(data);
+    return hg_proc_hg_int32_t(proc, &out->m_status);
+}
+
+/**
+ * Request type used internally by the collective operations of
+ * async_engine (e.g. async_engine::allgather()) to send a message to
+ * another member of the group. Messages are delivered to the receiver's
+ * collective_mailbox, where the receiver picks them up when (or if) it
+ * reaches the step they belong to.
+ */
+struct collective_rpc {
+
+    // traits used so that the engine knows what to do with the RPC
+    using self_type = collective_rpc;
+    using handle_type = hermes::rpc_handle<self_type>;
+    using input_type = collective_in_t;
+    using output_type = collective_out_t;
+    using mercury_input_type = collective_in_t;
+    using mercury_output_type = collective_out_t;
+
+    // RPC public identifier
+    constexpr static const uint16_t public_id = 0xfff1;
+
+    // RPC internal Mercury identifier
+    constexpr static const uint16_t mercury_id = public_id;
+
+    // RPC name
+    constexpr static const auto name = "hermes_collective";
+
+    // requires response?
+    constexpr static const auto requires_response = true;
+
+    // Mercury callback to serialize input arguments
+    constexpr static const auto mercury_in_proc_cb = hg_proc_collective_in_t;
+
+    // Mercury callback to serialize output arguments
+    constexpr static const auto mercury_out_proc_cb =
+        hg_proc_collective_out_t;
+};
+
+/** Several variable-sized blocks packed into a single message (e.g. the
+ * contributions forwarded at each step of an allgather) */
+struct collective_blocks {
+    std::vector<std::vector<char>> m_blocks;
+};
+
+inline hg_return_t
+hg_proc_collective_blocks(hg_proc_t proc, void* data) {
+
+    auto* blocks = static_cast<collective_blocks*>(data);
+
+    return proc_vector(proc, blocks->m_blocks,
+                       [](hg_proc_t p, std::vector<char>& b) {
+                           return proc_bytes(p, b);
+                       });
+}
+
+/**
+ * Messages received by this process for collective operations that it
+ * may not have reached yet, as well as the number of collective
+ * operations started in each group
+ */
+class collective_mailbox {
+
+public:
+    void
+    deliver(const collective_key& key, std::vector<char>&& payload) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_messages[key] = std::move(payload);
+        }
+
+        m_cv.notify_all();
+    }
+
+    /** Wait until @a deadline for the message identified by @a key and
+     * remove it from the mailbox */
+    template <typename Clock, typename Duration>
+    std::vector<char>
+    take(const collective_key& key,
+         const std::chrono::time_point<Clock, Duration>& deadline) {
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        auto it = m_messages.end();
+
+        const bool found = m_cv.wait_until(lock, deadline, [&]() {
+            return (it = m_messages.find(key)) != m_messages.end();
+        });
+
+        if(!found) {
+            throw std::runtime_error("Collective operation timed out "
+                    "waiting for rank " + std::to_string(key.m_source));
+        }
+
+        std::vector<char> payload(std::move(it->second));
+        m_messages.erase(it);
+        return payload;
+    }
+
+    /** Number the next collective operation of the group identified by
+     * @a tag and @a size (all members number them the same way, since
+     * they all take part in the same operations in the same order) */
+    hg_uint64_t
+    next_sequence(hg_uint64_t tag, hg_uint32_t size) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_sequences[std::make_pair(tag, size)]++;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::map<collective_key, std::vector<char>> m_messages;
+    std::map<std::pair<hg_uint64_t, hg_uint32_t>, hg_uint64_t> m_sequences;
+};
+
+/**
+ * Messages sent by a member of a group during a collective operation that
+ * have not been acknowledged yet. The operation waits for all of them
+ * before returning, since the receivers may still be pulling their
+ * payloads.
+ */
+class collective_sends {
+
+public:
+    void
+    start() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_pending;
+    }
+
+    void
+    complete(std::exception_ptr error) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if(error && !m_error) {
+                m_error = error;
+            }
+
+            --m_pending;
+        }
+
+        m_cv.notify_all();
+    }
+
+    /** Wait until @a deadline for all messages to be acknowledged,
+     * rethrowing the first error found (if any) */
+    template <typename Clock, typename Duration>
+    void
+    wait_until(const std::chrono::time_point<Clock, Duration>& deadline) {
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        if(!m_cv.wait_until(lock, deadline, [this]() {
+                return m_pending == 0;
+            })) {
+            throw std::runtime_error("Collective operation timed out "
+                                     "waiting for acknowledgements");
+        }
+
+        if(m_error) {
+            std::rethrow_exception(m_error);
+        }
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::size_t m_pending = 0;
+    std::exception_ptr m_error;
+};
+
+} // namespace detail
+} // namespace hermes
+
+#endif // __HERMES_DETAIL_COLLECTIVE_HPP__
@@ -0,0 +1,296 @@
+#ifndef __HERMES_DETAIL_ENCODING_HPP__
+#define __HERMES_DETAIL_ENCODING_HPP__
+
+// C includes
+#include <mercury.h>
+#include <mercury_proc.h>
+
+// C++ includes
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// project includes
+#include <hermes/logging.hpp>
+
+#ifdef HERMES_MARGO_COMPATIBLE_MODE
+#include <hermes/detail/margo_compatibility.hpp>
+#endif // HERMES_MARGO_COMPATIBLE_MODE
+
+namespace hermes {
+namespace detail {
+
+/**
+ * Encode @a data with @a proc_cb into a plain buffer, outside of any
+ * Mercury handle (e.g. so that it can be copied as-is into the handles of
+ * several RPCs)
+ */
+inline std::vector<char>
+encode_with_proc(hg_class_t* hg_class, hg_proc_cb_t proc_cb, void* data) {
+
+    // most inputs/outputs are small: start with a buffer of a reasonable
+    // size and retry once with the exact size if the encoding overflowed it
+    std::vector<char> buffer(4096);
+
+    hg_proc_t proc = HG_PROC_NULL;
+
+    hg_return_t ret = hg_proc_create_set(hg_class, buffer.data(),
+                                         buffer.size(), HG_ENCODE,
+                                         HG_NOHASH, &proc);
+
+    if(ret != HG_SUCCESS) {
+        throw std::runtime_error("Failed to create proc for encoding: " +
+                std::string(HG_Error_to_string(ret)));
+    }
+
+    for(int attempt = 0; ; ++attempt) {
+
+        ret = proc_cb(proc, data);
+
+        if(ret != HG_SUCCESS) {
+            break;
+        }
+
+        // if the buffer was too small, Mercury moved the encoded data to
+        // an extra buffer of its own
+        const bool overflowed = hg_proc_get_extra_buf(proc) != nullptr;
+
+        buffer.resize(hg_proc_get_size_used(proc));
+
+        if(!overflowed) {
+            break;
+        }
+
+        if(attempt != 0) {
+            ret = HG_OVERFLOW;
+            break;
+        }
+
+        ret = hg_proc_reset(proc, buffer.data(), buffer.size(), HG_ENCODE);
+
+        if(ret != HG_SUCCESS) {
+            break;
+        }
+    }
+
+    hg_proc_free(proc);
+
+    if(ret != HG_SUCCESS) {
+        throw std::runtime_error("Failed to encode data: " +
+                std::string(HG_Error_to_string(ret)));
+    }
+
+    return buffer;
+}
+
+/**
+ * Decode @a data with @a proc_cb from a buffer produced by
+ * encode_with_proc(). Only suitable for types that don't need to be freed
+ * through their proc callback (i.e. that own whatever they decode).
+ */
+inline void
+decode_with_proc(hg_class_t* hg_class, hg_proc_cb_t proc_cb,
+                 const std::vector<char>& buffer, void* data) {
+
+    hg_proc_t proc = HG_PROC_NULL;
+
+    hg_return_t ret = hg_proc_create_set(
+            hg_class, const_cast<char*>(buffer.data()), buffer.size(),
+            HG_DECODE, HG_NOHASH, &proc);
+
+    if(ret != HG_SUCCESS) {
+        throw std::runtime_error("Failed to create proc for decoding: " +
+                std::string(HG_Error_to_string(ret)));
+    }
+
+    ret = proc_cb(proc, data);
+
+    hg_proc_free(proc);
+
+    if(ret != HG_SUCCESS) {
+        throw std::runtime_error("Failed to decode data: " +
+                std::string(HG_Error_to_string(ret)));
+    }
+}
+
+/**
+ * Decode the output of @a Request from a buffer produced by
+ * encode_with_proc()
+ */
+template <typename Request>
+inline typename Request::output_type
+decode_output(hg_class_t* hg_class, const std::vector<char>& buffer) {
+
+    using MercuryOutput = typename Request::mercury_output_type;
+    using Output = typename Request::output_type;
+
+    hg_proc_t proc = HG_PROC_NULL;
+
+    hg_return_t ret = hg_proc_create_set(
+            hg_class, const_cast<char*>(buffer.data()), buffer.size(),
+            HG_DECODE, HG_NOHASH, &proc);
+
+    if(ret != HG_SUCCESS) {
+        throw std::runtime_error("Failed to create proc for decoding: " +
+                std::string(HG_Error_to_string(ret)));
+    }
+
+    MercuryOutput hg_output;
+
+    ret = Request::mercury_out_proc_cb(proc, &hg_output);
+
+    if(ret != HG_SUCCESS) {
+        hg_proc_free(proc);
+        throw std::runtime_error("Failed to decode request output data: " +
+                std::string(HG_Error_to_string(ret)));
+    }
+
+    Output output(hg_output);
+
+    // release whatever the proc allocated while decoding
+    if(hg_proc_reset(proc, NULL, 0, HG_FREE) == HG_SUCCESS) {
+        (void) Request::mercury_out_proc_cb(proc, &hg_output);
+    }
+
+    hg_proc_free(proc);
+
+    return output;
+}
+
+/**
+ * Decode the routing key of @a Request (see request::routing_key()) from
+ * the front of the input buffer of @a handle, leaving the rest of the
+ * input untouched. Checksums are not verified, since only part of the
+ * input is read.
+ */
+template <typename Request>
+inline typename Request::routing_key_type
+decode_routing_key(hg_handle_t handle) {
+
+    using MercuryKey = typename Request::mercury_routing_key_type;
+    using Key = typename Request::routing_key_type;
+
+    const struct hg_info* hgi = HG_Get_info(handle);
+
+    if(!hgi) {
+        throw std::runtime_error("Failed to retrieve request information "
+                                 "from internal handle");
+    }
+
+    void* buffer = nullptr;
+    hg_size_t size = 0;
+
+    hg_return_t ret = HG_Get_input_buf(handle, &buffer, &size);
+
+    if(ret != HG_SUCCESS) {
+        throw std::runtime_error("Failed to retrieve request input buffer: " +
+                std::string(HG_Error_to_string(ret)));
+    }
+
+#if defined(HG_VERSION_MAJOR) && HG_VERSION_MAJOR >= 2
+    // inputs that didn't fit in the eager buffer were encoded as a whole
+    // into an extra buffer
+    void* extra_buffer = nullptr;
+    hg_size_t extra_size = 0;
+
+    if(HG_Get_input_extra_buf(handle, &extra_buffer, 
+                              &extra_size) == HG_SUCCESS &&
+       extra_buffer != nullptr) {
+        buffer = extra_buffer;
+        size = extra_size;
+    }
+#endif // HG_VERSION_MAJOR >= 2
+
+    hg_proc_t proc = HG_PROC_NULL;
+
+    ret = hg_proc_create_set(hgi->hg_class, buffer, size, HG_DECODE, 
+                             HG_NOHASH, &proc);
+
+    if(ret != HG_SUCCESS) {
+        throw std::runtime_error("Failed to create proc for decoding: " +
+                std::string(HG_Error_to_string(ret)));
+    }
+
+    MercuryKey hg_key;
+
+    ret = Request::mercury_routing_key_proc_cb(proc, &hg_key);
+
+    if(ret != HG_SUCCESS) {
+        hg_proc_free(proc);
+        throw std::runtime_error("Failed to decode request routing key: " +
+                std::string(HG_Error_to_string(ret)));
+    }
+
+    Key key(hg_key);
+
+    // release whatever the proc allocated while decoding
+    if(hg_proc_reset(proc, NULL, 0, HG_FREE) == HG_SUCCESS) {
+        (void) Request::mercury_routing_key_proc_cb(proc, &hg_key);
+    }
+
+    hg_proc_free(proc);
+
+    return key;
+}
+
+/**
+ * Decode the output of @a Request received in @a handle and encode it
+ * back into a plain buffer, so that it can be relayed to another process
+ * without knowing its type (see detail::relay_rpc)
+ */
+template <typename Request>
+inline std::vector<char>
+encoded_output(hg_handle_t handle) {
+
+    using MercuryOutput = typename Request::mercury_output_type;
+
+    const struct hg_info* hgi = HG_Get_info(handle);
+
+    if(!hgi) {
+        throw std::runtime_error("Failed to retrieve request information "
+                                 "from internal handle");
+    }
+
+    MercuryOutput hg_output;
+
+#ifdef HERMES_MARGO_COMPATIBLE_MODE
+    hg_return_t ret =
+        margo::get_output(handle, Request::mercury_out_proc_cb, &hg_output);
+#else
+    hg_return_t ret = HG_Get_output(handle, &hg_output);
+#endif // HERMES_MARGO_COMPATIBLE_MODE
+
+    if(ret != HG_SUCCESS) {
+        throw std::runtime_error("Failed to decode request output data: " +
+                std::string(HG_Error_to_string(ret)));
+    }
+
+    std::vector<char> buffer;
+    std::exception_ptr error;
+
+    try {
+        buffer = encode_with_proc(hgi->hg_class, Request::mercury_out_proc_cb,
+                                  &hg_output);
+    }
+    catch(const std::exception&) {
+        error = std::current_exception();
+    }
+
+#ifdef HERMES_MARGO_COMPATIBLE_MODE
+    margo::free_output(handle, Request::mercury_out_proc_cb, &hg_output);
+#else
+    HG_Free_output(handle, &hg_output);
+#endif // HERMES_MARGO_COMPATIBLE_MODE
+
+    if(error) {
+        std::rethrow_exception(error);
+    }
+
+    return buffer;
+}
+
+} // namespace detail
+} // namespace hermes
+
+#endif // __HERMES_DETAIL_ENCODING_HPP__
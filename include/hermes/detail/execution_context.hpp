@@ -7,63 +7,807 @@
 // C++ includes
 #include <memory>
 #include <atomic>
-#include <future>
+#include <cassert>
+#include <condition_variable>
+#include <mutex>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 // project includes
+#include <hermes/logging.hpp>
+#include <hermes/result.hpp>
+#include <hermes/detail/object_pool.hpp>
 #include <hermes/detail/request_status.hpp>
+#include <hermes/detail/rpc_input.hpp>
 
 namespace hermes {
-
-// defined elsewhere
-template <typename Request>
-class rpc_handle;
-
 namespace detail {
 
 struct address;
+class handle_cache;
+
+/** Mercury context that should be used to submit an RPC and the context id 
+ * that the RPC should be delivered to at the target (see HG_Set_target_id()),
+ * as well as the cache where its Mercury handle should be recycled (if any) */
+struct dispatch_slot {
+    const hg_context_t* m_hg_context;
+    hg_uint8_t m_target_id;
+    handle_cache* m_handle_cache;
+};
+
+/**
+ * Counter of the RPCs of an rpc_handle that have completed, so that the
+ * handle can wait for any of them (rather than for each one in turn) when
+ * it only needs some of their outputs (see rpc_handle::get_quorum())
+ */
+class completion_signal {
+
+public:
+    void
+    notify() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_completed;
+        }
+
+        m_cv.notify_all();
+    }
+
+    std::size_t
+    completed() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_completed;
+    }
+
+    /** Wait until @a deadline for more than @a seen RPCs to complete */
+    template <typename Clock, typename Duration>
+    bool
+    wait_until(std::size_t seen,
+               const std::chrono::time_point<Clock, Duration>& deadline) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_cv.wait_until(lock, deadline, [&]() {
+            return m_completed > seen;
+        });
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::size_t m_completed = 0;
+};
+
+/**
+ * Output of an RPC (or the error that prevented it) along with what is 
+ * needed to wait for it. The output is stored inline rather than in a 
+ * promise/future pair, so delivering it requires no allocations, and 
+ * waiters are woken up through the slot's own condition variable.
+ */
+template <typename Output>
+class output_slot {
+
+public:
+    output_slot() :
+        m_completed(false),
+        m_has_output(false),
+        m_retrieved(false) { }
+
+    output_slot(const output_slot&) = delete;
+    output_slot& operator=(const output_slot&) = delete;
+
+    ~output_slot() {
+        if(m_has_output) {
+            output_ptr()->~Output();
+        }
+    }
+
+    void
+    set_output(Output&& output) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ::new(&m_output_storage) Output(std::move(output));
+            m_has_output = true;
+            m_completed = true;
+        }
+
+        m_cv.notify_all();
+    }
+
+    void
+    set_error(std::exception_ptr eptr) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_error = eptr;
+            m_completed = true;
+        }
+
+        m_cv.notify_all();
+    }
+
+    void
+    set_no_output() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_completed = true;
+        }
+
+        m_cv.notify_all();
+    }
+
+    /** Wait until @a deadline for the RPC to complete */
+    template <typename Clock, typename Duration>
+    bool
+    wait_until(const std::chrono::time_point<Clock, Duration>& deadline) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_cv.wait_until(lock, deadline, [this]() {
+            return m_completed;
+        });
+    }
 
-/** Execution context required by the RPC's originator (i.e. the client) */
+    void
+    wait() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this]() { return m_completed; });
+    }
+
+    bool
+    completed() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_completed;
+    }
+
+    /** Whether take_output() has already been called (only meaningful to
+     * the thread that calls it) */
+    bool
+    retrieved() const {
+        return m_retrieved;
+    }
+
+    /** Return the RPC's output or rethrow the error that prevented it. 
+     * Must only be called once the RPC has completed */
+    Output
+    take_output() {
+
+        m_retrieved = true;
+
+        if(m_error) {
+            std::rethrow_exception(m_error);
+        }
+
+        if(!m_has_output) {
+            throw std::logic_error("RPC output not available");
+        }
+
+        Output output(std::move(*output_ptr()));
+        output_ptr()->~Output();
+        m_has_output = false;
+        return output;
+    }
+
+private:
+    Output*
+    output_ptr() {
+        return reinterpret_cast<Output*>(&m_output_storage);
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_completed;
+    bool m_has_output;
+    bool m_retrieved;
+    std::exception_ptr m_error;
+    typename std::aligned_storage<sizeof(Output), 
+                                  alignof(Output)>::type m_output_storage;
+};
+
+/**
+ * Execution context required by the RPC's originator (i.e. the client).
+ * The context is shared between its rpc_handle and the in-flight RPC, and
+ * whichever of them finishes last releases it. This allows handles to let
+ * go of RPCs whose outputs are no longer needed without waiting for them.
+ * The output is kept in the context itself (see output_slot), so that 
+ * contexts coming from the pool make posting RPCs allocation-free.
+ */
 template <typename Request>
-struct execution_context {
+struct execution_context : public pooled<execution_context<Request>> {
 
     using value_type = Request;
-    using Handle = rpc_handle<Request>;
     using Input = typename Request::input_type;
     using Output = typename Request::output_type;
     using MercuryInput = typename Request::mercury_input_type;
     using MercuryOutput = typename Request::mercury_output_type;
 
-    execution_context(Handle* parent,
-                      const hg_context_t * const hg_context,
+    // @a input is either the RPC's own input or the input shared by all
+    // targets of a broadcast (see rpc_input)
+    template <typename InputArg>
+    execution_context(const dispatch_slot& slot,
                       const std::shared_ptr<detail::address>& address,
-                      Input&& input) :
-        m_parent(parent),
-        m_hg_context(hg_context),
+                      InputArg&& input,
+                      const std::shared_ptr<completion_signal>& signal = 
+                          nullptr) :
+        m_hg_context(slot.m_hg_context),
+        m_target_id(slot.m_target_id),
+        m_handle_cache(slot.m_handle_cache),
+        m_handle(HG_HANDLE_NULL),
+        m_status(detail::request_status::created),
+        m_address(address),
+        m_input(std::forward<InputArg>(input)),
+        m_signal(signal),
+        m_refs(2) { }
+
+    execution_context(const execution_context&) = delete;
+    execution_context& operator=(const execution_context&) = delete;
+
+    // completion interface used by post_to_mercury(). IMPORTANT: the
+    // context may be destroyed once these return
+    void
+    set_output(Output&& output) {
+        m_output.set_output(std::move(output));
+        complete();
+    }
+
+    void
+    set_error(std::exception_ptr eptr) {
+        m_output.set_error(eptr);
+        complete();
+    }
+
+    void
+    set_no_output() {
+        m_output.set_no_output();
+        complete();
+    }
+
+    /** Drop a reference (either the handle's or, if the RPC could not be 
+     * posted, the RPC's), destroying the context if it was the last one */
+    void
+    release() {
+        if(m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    const hg_context_t* const m_hg_context;
+    const hg_uint8_t m_target_id;
+    handle_cache* const m_handle_cache;
+    hg_handle_t m_handle;
+    std::atomic<detail::request_status> m_status;
+
+    const std::shared_ptr<detail::address> m_address;
+    rpc_input<Request> m_input;
+
+    // only accessed by the handle, apart from the completion interface
+    output_slot<Output> m_output;
+
+private:
+    void
+    complete() {
+        if(m_signal) {
+            m_signal->notify();
+        }
+
+        release();
+    }
+
+    const std::shared_ptr<completion_signal> m_signal;
+    // one reference for the handle and one for the in-flight RPC
+    std::atomic<int> m_refs;
+};
+
+/**
+ * Execution context for single-target RPCs (see single_rpc_handle). Like
+ * execution_context, it keeps the output inline (see output_slot), but it
+ * is created with a single reference so that post_one() can take the 
+ * RPC's reference only when it is actually posted. The context is shared
+ * between the handle and the in-flight RPC, and whichever of them finishes
+ * last releases it. This allows handles to be destroyed before their RPC
+ * completes.
+ */
+template <typename Request>
+struct single_context : public pooled<single_context<Request>> {
+
+    using value_type = Request;
+    using Input = typename Request::input_type;
+    using Output = typename Request::output_type;
+    using MercuryInput = typename Request::mercury_input_type;
+
+    single_context(const dispatch_slot& slot,
+                   const std::shared_ptr<detail::address>& address,
+                   Input&& input) :
+        m_hg_context(slot.m_hg_context),
+        m_target_id(slot.m_target_id),
+        m_handle_cache(slot.m_handle_cache),
+        m_handle(HG_HANDLE_NULL),
+        m_status(detail::request_status::created),
+        m_address(address),
+        m_input(std::move(input)),
+        m_refs(1) { }
+
+    single_context(const single_context&) = delete;
+    single_context& operator=(const single_context&) = delete;
+
+    // completion interface used by post_to_mercury(). IMPORTANT: the
+    // context may be destroyed once these return
+    void
+    set_output(Output&& output) {
+        m_output.set_output(std::move(output));
+        release();
+    }
+
+    void
+    set_error(std::exception_ptr eptr) {
+        m_output.set_error(eptr);
+        release();
+    }
+
+    void
+    set_no_output() {
+        m_output.set_no_output();
+        release();
+    }
+
+    /** Take a reference on behalf of the RPC about to be posted */
+    void
+    acquire() {
+        m_refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /** Drop a reference, destroying the context if it was the last one */
+    void
+    release() {
+        if(m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    const hg_context_t* const m_hg_context;
+    const hg_uint8_t m_target_id;
+    handle_cache* const m_handle_cache;
+    hg_handle_t m_handle;
+    std::atomic<detail::request_status> m_status;
+
+    const std::shared_ptr<detail::address> m_address;
+    rpc_input<Request> m_input;
+
+    // only accessed by the handle, apart from the completion interface
+    output_slot<Output> m_output;
+
+private:
+    std::atomic<unsigned int> m_refs;
+};
+
+/** 
+ * Execution context for RPCs whose originator waits for the result in the
+ * same thread that drives Mercury progress (see async_engine::call()). Since
+ * the completion callback runs in the waiting thread, no synchronization is
+ * required to hand over the result.
+ */
+template <typename Request>
+struct inline_context : public pooled<inline_context<Request>> {
+
+    using value_type = Request;
+    using Input = typename Request::input_type;
+    using Output = typename Request::output_type;
+    using MercuryInput = typename Request::mercury_input_type;
+
+    inline_context(const dispatch_slot& slot,
+                   const std::shared_ptr<detail::address>& address,
+                   Input&& input) :
+        m_hg_context(slot.m_hg_context),
+        m_target_id(slot.m_target_id),
+        m_handle_cache(slot.m_handle_cache),
+        m_handle(HG_HANDLE_NULL),
+        m_status(detail::request_status::created),
+        m_address(address),
+        m_input(std::move(input)),
+        m_completed(false),
+        m_has_output(false) { }
+
+    inline_context(const inline_context&) = delete;
+    inline_context& operator=(const inline_context&) = delete;
+
+    ~inline_context() {
+        if(m_has_output) {
+            output_ptr()->~Output();
+        }
+    }
+
+    // completion interface used by post_to_mercury()
+    void
+    set_output(Output&& output) {
+        ::new(&m_output_storage) Output(std::move(output));
+        m_has_output = true;
+        m_completed = true;
+    }
+
+    void
+    set_error(std::exception_ptr eptr) {
+        m_error = eptr;
+        m_completed = true;
+    }
+
+    void
+    set_no_output() {
+        m_completed = true;
+    }
+
+    bool
+    completed() const {
+        return m_completed;
+    }
+
+    /** Return the RPC's output or rethrow the error that prevented it */
+    Output
+    take_output() {
+
+        if(m_error) {
+            std::rethrow_exception(m_error);
+        }
+
+        return std::move(*output_ptr());
+    }
+
+    const hg_context_t* const m_hg_context;
+    const hg_uint8_t m_target_id;
+    handle_cache* const m_handle_cache;
+    hg_handle_t m_handle;
+    std::atomic<detail::request_status> m_status;
+
+    const std::shared_ptr<detail::address> m_address;
+    rpc_input<Request> m_input;
+
+private:
+    Output*
+    output_ptr() {
+        return reinterpret_cast<Output*>(&m_output_storage);
+    }
+
+    bool m_completed;
+    bool m_has_output;
+    std::exception_ptr m_error;
+    typename std::aligned_storage<sizeof(Output), 
+                                  alignof(Output)>::type m_output_storage;
+};
+
+/**
+ * Execution context for RPCs whose originator provides a callback to be 
+ * invoked with the result (see async_engine::post() with a callback). The
+ * callback is invoked directly from the Mercury completion callback with 
+ * a result<Output>, so no promise/future pair is ever created. Contexts are
+ * owned by the RPC while it is in flight and release themselves after 
+ * invoking the callback.
+ */
+template <typename Request, typename Callable>
+struct callback_context : 
+    public pooled<callback_context<Request, Callable>> {
+
+    using value_type = Request;
+    using Input = typename Request::input_type;
+    using Output = typename Request::output_type;
+    using MercuryInput = typename Request::mercury_input_type;
+
+    callback_context(const dispatch_slot& slot,
+                     const std::shared_ptr<detail::address>& address,
+                     Callable&& callback,
+                     Input&& input) :
+        m_hg_context(slot.m_hg_context),
+        m_target_id(slot.m_target_id),
+        m_handle_cache(slot.m_handle_cache),
+        m_handle(HG_HANDLE_NULL),
+        m_status(detail::request_status::created),
+        m_address(address),
+        m_input(std::move(input)),
+        m_callback(std::move(callback)) { }
+
+    callback_context(const callback_context&) = delete;
+    callback_context& operator=(const callback_context&) = delete;
+
+    // completion interface used by post_to_mercury(). IMPORTANT: the
+    // context is destroyed once the callback returns
+    void
+    set_output(Output&& output) {
+        complete(result<Output>(std::move(output)));
+    }
+
+    void
+    set_error(std::exception_ptr eptr) {
+        complete(result<Output>(eptr));
+    }
+
+    void
+    set_no_output() {
+        complete(result<Output>(std::make_exception_ptr(
+                std::logic_error("Request type does not expect a "
+                                 "response"))));
+    }
+
+    const hg_context_t* const m_hg_context;
+    const hg_uint8_t m_target_id;
+    handle_cache* const m_handle_cache;
+    hg_handle_t m_handle;
+    std::atomic<detail::request_status> m_status;
+
+    const std::shared_ptr<detail::address> m_address;
+    rpc_input<Request> m_input;
+
+private:
+    void
+    complete(result<Output>&& rv) {
+
+        const std::unique_ptr<callback_context> self(this);
+
+        try {
+            m_callback(std::move(rv));
+        }
+        catch(const std::exception& ex) {
+            HERMES_ERROR("Uncaught exception in RPC callback: {}", 
+                         ex.what());
+        }
+    }
+
+    Callable m_callback;
+};
+
+template <typename Request> class batch_state;
+
+/**
+ * Execution context for one of the RPCs sent by post_many(). The contexts
+ * of a batch live in a single block owned by their batch_state, where
+ * they also leave their results.
+ */
+template <typename Request>
+struct batch_context {
+
+    using value_type = Request;
+    using Input = typename Request::input_type;
+    using Output = typename Request::output_type;
+    using MercuryInput = typename Request::mercury_input_type;
+
+    batch_context(batch_state<Request>* batch,
+                  std::size_t index,
+                  const dispatch_slot& slot,
+                  const std::shared_ptr<detail::address>& address,
+                  Input&& input) :
+        m_hg_context(slot.m_hg_context),
+        m_target_id(slot.m_target_id),
+        m_handle_cache(slot.m_handle_cache),
         m_handle(HG_HANDLE_NULL),
-        m_bulk_handle(HG_BULK_NULL),
         m_status(detail::request_status::created),
         m_address(address),
-        // the context takes ownership of the user's input in order to ensure
-        // that any pointers in m_mercury_input that refer back to it (e.g. 
-        // strings) survives as long as needed (this is required because
-        // mercury does not take ownership of any pointers in the user input)
-        m_user_input(std::move(input)),
-        // invoke explicit cast constructor
-        m_mercury_input(m_user_input) { }
-
-    Handle* m_parent;
+        m_input(std::move(input)),
+        m_batch(batch),
+        m_index(index),
+        m_result(std::exception_ptr()),
+        m_completed(false),
+        m_retrieved(false) { }
+
+    batch_context(const batch_context&) = delete;
+    batch_context& operator=(const batch_context&) = delete;
+
+    // completion interface used by post_to_mercury(). IMPORTANT: the
+    // batch may be destroyed once these return
+    void
+    set_output(Output&& output) {
+        m_batch->complete(m_index, result<Output>(std::move(output)));
+    }
+
+    void
+    set_error(std::exception_ptr eptr) {
+        m_batch->complete(m_index, result<Output>(eptr));
+    }
+
+    void
+    set_no_output() {
+        m_batch->complete(m_index, result<Output>(std::exception_ptr()));
+    }
+
     const hg_context_t* const m_hg_context;
+    const hg_uint8_t m_target_id;
+    handle_cache* const m_handle_cache;
     hg_handle_t m_handle;
-    hg_bulk_t m_bulk_handle;
     std::atomic<detail::request_status> m_status;
 
     const std::shared_ptr<detail::address> m_address;
-    Input m_user_input;
-    MercuryInput m_mercury_input;
+    rpc_input<Request> m_input;
 
-    std::promise<Output> m_output_promise;
+    batch_state<Request>* const m_batch;
+    const std::size_t m_index;
+
+    // protected by the batch's mutex
+    result<Output> m_result;
+    bool m_completed;
+    bool m_retrieved;
 };
 
+/**
+ * State shared between a multi_rpc_handle and the RPCs of its batch: the
+ * block of contexts and the order in which they completed. The handle and
+ * each in-flight RPC hold a reference, and whichever finishes last
+ * destroys the batch.
+ */
+template <typename Request>
+class batch_state {
+
+    using Output = typename Request::output_type;
+    using Context = batch_context<Request>;
+    using Storage = typename std::aligned_storage<sizeof(Context),
+                                                  alignof(Context)>::type;
+
+public:
+    explicit batch_state(std::size_t capacity) :
+        m_storage(new Storage[capacity]),
+        m_capacity(capacity),
+        m_size(0),
+        m_next(0),
+        m_refs(1) {
+        m_order.reserve(capacity);
+    }
+
+    batch_state(const batch_state&) = delete;
+    batch_state& operator=(const batch_state&) = delete;
+
+    ~batch_state() {
+        for(std::size_t i = 0; i < m_size; ++i) {
+            context(i).~Context();
+        }
+    }
+
+    /** Construct the next context of the batch in place */
+    template <typename... Args>
+    Context&
+    emplace(Args&&... args) {
+        assert(m_size < m_capacity);
+        auto* ctx = ::new(&m_storage[m_size]) Context(
+                this, m_size, std::forward<Args>(args)...);
+        ++m_size;
+        return *ctx;
+    }
+
+    std::size_t
+    size() const {
+        return m_size;
+    }
+
+    Context&
+    context(std::size_t index) {
+        return *reinterpret_cast<Context*>(&m_storage[index]);
+    }
+
+    /** Record the result of the RPC at @a index and drop the reference
+     * held on its behalf */
+    void
+    complete(std::size_t index, result<Output>&& rv) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Context& ctx = context(index);
+            ctx.m_result = std::move(rv);
+            ctx.m_completed = true;
+            m_order.push_back(index);
+        }
+
+        m_cv.notify_all();
+        release();
+    }
+
+    bool
+    completed(std::size_t index) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return context(index).m_completed;
+    }
+
+    /** Wait until @a deadline for the RPC at @a index to complete */
+    template <typename Clock, typename Duration>
+    bool
+    wait_until(std::size_t index,
+               const std::chrono::time_point<Clock, Duration>& deadline) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_cv.wait_until(lock, deadline, [&]() {
+            return context(index).m_completed;
+        });
+    }
+
+    void
+    wait(std::size_t index) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [&]() { return context(index).m_completed; });
+    }
+
+    /** Take the result of the RPC at @a index, which must have completed.
+     * Each result can only be taken once. */
+    result<Output>
+    take(std::size_t index) {
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Context& ctx = context(index);
+
+        if(ctx.m_retrieved) {
+            throw std::logic_error("RPC output already retrieved");
+        }
+
+        ctx.m_retrieved = true;
+        return std::move(ctx.m_result);
+    }
+
+    /**
+     * Wait until @a deadline for the next RPC to complete, in completion
+     * order, whose result has not been taken yet. Returns false if there
+     * are none left or @a deadline expired.
+     */
+    template <typename Clock, typename Duration>
+    bool
+    take_next(std::size_t& index, result<Output>& rv,
+              const std::chrono::time_point<Clock, Duration>& deadline) {
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        while(true) {
+            // skip results already taken by index
+            while(m_next < m_order.size() &&
+                  context(m_order[m_next]).m_retrieved) {
+                ++m_next;
+            }
+
+            if(m_next < m_order.size()) {
+                break;
+            }
+
+            if(m_order.size() == m_size ||
+               m_cv.wait_until(lock, deadline) == std::cv_status::timeout) {
+                return false;
+            }
+        }
+
+        index = m_order[m_next++];
+
+        Context& ctx = context(index);
+        ctx.m_retrieved = true;
+        rv = std::move(ctx.m_result);
+        return true;
+    }
+
+    /** Take a reference on behalf of an RPC about to be posted */
+    void
+    acquire() {
+        m_refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /** Drop a reference, destroying the batch if it was the last one */
+    void
+    release() {
+        if(m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    const std::unique_ptr<Storage[]> m_storage;
+    const std::size_t m_capacity;
+    std::size_t m_size;
+    // indices of the RPCs in the order in which they completed
+    std::vector<std::size_t> m_order;
+    std::size_t m_next;
+    std::atomic<unsigned int> m_refs;
+};
+
+/**
+ * Whether Callable can be used as a completion callback for Request (i.e. 
+ * whether it can be invoked with a result<Request::output_type>)
+ */
+template <typename Request, typename Callable, typename = void>
+struct is_completion_callback : std::false_type { };
+
+template <typename Request, typename Callable>
+struct is_completion_callback<
+    Request, Callable,
+    decltype(std::declval<typename std::decay<Callable>::type&>()(
+                std::declval<result<typename Request::output_type>&&>()),
+             void())> : std::true_type { };
+
 } // namespace detail
 } // namespace hermes
 
@@ -0,0 +1,179 @@
+#ifndef __HERMES_DETAIL_HANDLE_CACHE_HPP__
+#define __HERMES_DETAIL_HANDLE_CACHE_HPP__
+
+// C includes
+#include <mercury.h>
+
+// C++ includes
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// project includes
+#include <hermes/logging.hpp>
+
+namespace hermes {
+namespace detail {
+
+/**
+ * Cache of Mercury handles for outgoing RPCs. Once an RPC completes, its
+ * handle is returned to the cache instead of being destroyed, so that the
+ * next RPC of the same type to the same address (and submitted through the
+ * same context) can reuse it after an HG_Reset() rather than paying for an
+ * HG_Create()/HG_Destroy() pair.
+ *
+ * Handles keep a reference to their address, so cached handles keep the
+ * corresponding Mercury addresses alive until the cache is cleared.
+ */
+class handle_cache {
+
+    struct key {
+
+        bool
+        operator==(const key& other) const {
+            return m_hg_context == other.m_hg_context &&
+                   m_hg_addr == other.m_hg_addr &&
+                   m_hg_id == other.m_hg_id &&
+                   m_target_id == other.m_target_id;
+        }
+
+        const hg_context_t* m_hg_context;
+        hg_addr_t m_hg_addr;
+        hg_id_t m_hg_id;
+        hg_uint8_t m_target_id;
+    };
+
+    struct key_hash {
+        std::size_t
+        operator()(const key& k) const {
+            std::size_t h = std::hash<const void*>()(k.m_hg_context);
+            h = h * 31 + std::hash<const void*>()(k.m_hg_addr);
+            h = h * 31 + std::hash<std::uint64_t>()(k.m_hg_id);
+            return h * 31 + k.m_target_id;
+        }
+    };
+
+public:
+    /**
+     * @param max_handles  maximum number of idle handles kept (0 disables
+     *                     the cache)
+     */
+    explicit handle_cache(std::size_t max_handles) :
+        m_max_handles(max_handles),
+        m_size(0) { }
+
+    handle_cache(const handle_cache&) = delete;
+    handle_cache& operator=(const handle_cache&) = delete;
+
+    ~handle_cache() {
+        clear();
+    }
+
+    /**
+     * Return a handle for sending RPC @a hg_id to @a hg_addr through
+     * @a hg_context, or HG_HANDLE_NULL if none is cached (in which case the
+     * caller should create one)
+     */
+    hg_handle_t
+    acquire(const hg_context_t* hg_context,
+            hg_addr_t hg_addr,
+            hg_id_t hg_id,
+            hg_uint8_t target_id) {
+
+        hg_handle_t handle = HG_HANDLE_NULL;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            const auto it =
+                m_handles.find({hg_context, hg_addr, hg_id, target_id});
+
+            if(it == m_handles.end() || it->second.empty()) {
+                return HG_HANDLE_NULL;
+            }
+
+            handle = it->second.back();
+            it->second.pop_back();
+            --m_size;
+
+            // drop keys that run out of handles so that the map doesn't 
+            // keep growing with every address ever contacted, but keep 
+            // (at most m_max_handles of) them around otherwise, since 
+            // erasing the key of the only RPC in flight would mean 
+            // allocating it again as soon as the RPC completes
+            if(it->second.empty() && m_handles.size() > m_max_handles) {
+                m_handles.erase(it);
+            }
+        }
+
+        const hg_return_t ret = HG_Reset(handle, hg_addr, hg_id);
+
+        HERMES_DEBUG2("HG_Reset(handle={}, addr={}, id={}) = {}",
+                      fmt::ptr(handle), fmt::ptr(hg_addr), hg_id,
+                      HG_Error_to_string(ret));
+
+        if(ret != HG_SUCCESS) {
+            // e.g. Mercury is still releasing the previous operation: just
+            // let the caller create a new handle
+            HG_Destroy(handle);
+            return HG_HANDLE_NULL;
+        }
+
+        return handle;
+    }
+
+    /**
+     * Return @a handle, whose operation has completed, to the cache. The
+     * handle is destroyed if the cache is full.
+     */
+    void
+    release(const hg_context_t* hg_context,
+            hg_addr_t hg_addr,
+            hg_id_t hg_id,
+            hg_uint8_t target_id,
+            hg_handle_t handle) {
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if(m_size < m_max_handles) {
+                m_handles[{hg_context, hg_addr, hg_id, target_id}]
+                    .push_back(handle);
+                ++m_size;
+                return;
+            }
+        }
+
+        HG_Destroy(handle);
+    }
+
+    /** Destroy all cached handles */
+    void
+    clear() {
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for(auto&& kv : m_handles) {
+            for(auto&& handle : kv.second) {
+                HG_Destroy(handle);
+            }
+        }
+
+        m_handles.clear();
+        m_size = 0;
+    }
+
+private:
+    const std::size_t m_max_handles;
+    std::mutex m_mutex;
+    std::size_t m_size;
+    std::unordered_map<key, std::vector<hg_handle_t>, key_hash> m_handles;
+};
+
+} // namespace detail
+} // namespace hermes
+
+#endif // __HERMES_DETAIL_HANDLE_CACHE_HPP__
@@ -13,10 +13,13 @@
 #include <hermes/logging.hpp>
 #include <hermes/make_unique.hpp>
 #include <hermes/request.hpp>
+#include <hermes/thread_pool.hpp>
 #include <hermes/detail/address.hpp>
 #include <hermes/detail/execution_context.hpp>
+#include <hermes/detail/handle_cache.hpp>
 #include <hermes/detail/request_registrar.hpp>
 #include <hermes/detail/request_status.hpp>
+#include <hermes/detail/rpc_input.hpp>
 
 #ifdef HERMES_MARGO_COMPATIBLE_MODE
 #include <hermes/detail/margo_compatibility.hpp>
@@ -78,6 +81,24 @@ create_mercury_context(hg_class_t* hg_class) {
     return hg_context;
 }
 
+inline hg_context_t*
+create_mercury_context(hg_class_t* hg_class, hg_uint8_t id) {
+
+    HERMES_DEBUG("Creating Mercury execution context with id {}", id);
+
+    hg_context_t* hg_context = HG_Context_create_id(hg_class, id);
+
+    HERMES_DEBUG2("HG_Context_create_id({}, {}) = {}", 
+                  fmt::ptr(hg_class), id, fmt::ptr(hg_context));
+
+    if(hg_context == NULL) {
+        throw std::runtime_error("Failed to create Mercury context with id " + 
+                                 std::to_string(id));
+    }
+
+    return hg_context;
+}
+
 using mercury_log_fuction = int(FILE *stream, const char *format, ...);
 
 inline void
@@ -137,7 +158,7 @@ register_mercury_rpc(hg_class_t* hg_class,
                   descriptor->m_mercury_id);
 #else
     ret = HG_Register(hg_class, descriptor->m_mercury_id,
-                      descriptor->m_mercury_input_cb,
+                      descriptor->m_forward_input_cb,
                       descriptor->m_mercury_output_cb,
                       listen ? descriptor->m_handler : nullptr);
 
@@ -145,7 +166,7 @@ register_mercury_rpc(hg_class_t* hg_class,
                   "out_proc_cb={}, rpc_cb={}) = {}",
                   static_cast<void*>(hg_class), 
                   descriptor->m_mercury_id,
-                  reinterpret_cast<void*>(descriptor->m_mercury_input_cb),
+                  reinterpret_cast<void*>(descriptor->m_forward_input_cb),
                   reinterpret_cast<void*>(descriptor->m_mercury_output_cb),
                   (listen ? (void*)(descriptor->m_handler) : nullptr),
                   ret);
@@ -246,20 +267,18 @@ create_mercury_bulk_handle(hg_class_t* hg_class,
     return bulk_handle;
 }
 
+/** Decode the input of @a handle directly into @a hg_input, which must be
+ * released with HG_Free_input() afterwards */
 template <typename Request>
-static inline typename Request::mercury_input_type
-decode_mercury_input(hg_handle_t handle) {
-
-    //using Input = typename Request::input_type;
-    using MercuryInput = typename Request::mercury_input_type;
+static inline void
+decode_mercury_input(hg_handle_t handle,
+                     typename Request::mercury_input_type& hg_input) {
 
     if(handle == HG_HANDLE_NULL) {
         throw std::runtime_error("Invalid handle passed to "
                                  "decode_mercury_input()");
     }
 
-    MercuryInput hg_input;
-
     // decode input
 #ifdef HERMES_MARGO_COMPATIBLE_MODE
     hg_return_t ret =
@@ -272,8 +291,6 @@ decode_mercury_input(hg_handle_t handle) {
         throw std::runtime_error("Failed to decode request input data: " +
                 std::string(HG_Error_to_string(ret)));
     }
-
-    return hg_input;
 }
 
 template <typename Request>
@@ -316,6 +333,93 @@ decode_mercury_output(hg_handle_t handle) {
 #endif
 }
 
+/** Return the Mercury id that was assigned to Request at registration */
+template <typename Request>
+inline hg_id_t
+mercury_id_of() {
+#ifdef HERMES_MARGO_COMPATIBLE_MODE
+    // the id is assigned when the engine registers the RPC, but reading it
+    // through the descriptor saves a map lookup on every post
+    return detail::descriptor_of<Request>()->m_mercury_id;
+#else
+    return Request::mercury_id;
+#endif // HERMES_MARGO_COMPATIBLE_MODE
+}
+
+/**
+ * Release the handle of the RPC in @a ctx once it has successfully 
+ * completed, either by returning it to the engine's handle cache or by 
+ * destroying it
+ */
+template <typename ExecutionContext>
+inline void
+release_mercury_handle(ExecutionContext* ctx, hg_handle_t handle) {
+
+    using Request = typename ExecutionContext::value_type;
+
+    if(ctx->m_handle_cache != nullptr) {
+        ctx->m_handle_cache->release(ctx->m_hg_context, 
+                                     ctx->m_address->mercury_address(),
+                                     mercury_id_of<Request>(),
+                                     ctx->m_target_id,
+                                     handle);
+    }
+    else {
+        HG_Destroy(handle);
+    }
+
+    ctx->m_handle = HG_HANDLE_NULL;
+}
+
+/** Destroy the handle of the RPC in @a ctx (if it got one) after the RPC
+ * could not be posted */
+template <typename ExecutionContext>
+inline void
+discard_mercury_handle(ExecutionContext* ctx) {
+
+    if(ctx->m_handle != HG_HANDLE_NULL) {
+        HG_Destroy(ctx->m_handle);
+        ctx->m_handle = HG_HANDLE_NULL;
+    }
+}
+
+/**
+ * Cancel the RPC in @a ctx after it timed out, unless its completion 
+ * callback has already claimed it. Returns true if the RPC was cancelled, 
+ * in which case its completion callback reports the timeout. Either way, 
+ * the caller must still wait for the completion callback before releasing
+ * the context.
+ */
+template <typename ExecutionContext>
+inline bool
+cancel_mercury_rpc(ExecutionContext* ctx) {
+
+    request_status expected = request_status::created;
+
+    if(!ctx->m_status.compare_exchange_strong(
+                expected, request_status::cancelled)) {
+        HERMES_DEBUG2("RPC completed before it could be cancelled");
+        return false;
+    }
+
+    // the completion callback won't touch the handle from now on, so we 
+    // are its only owner. It can't be reused for another RPC, and 
+    // destroying it right away is safe since Mercury holds its own 
+    // reference until the completion callback has run
+    const hg_handle_t handle = ctx->m_handle;
+    ctx->m_handle = HG_HANDLE_NULL;
+
+    hg_return_t ret = HG_Cancel(handle);
+
+    if(ret != HG_SUCCESS) {
+        HERMES_WARNING("Failed to cancel RPC: {}", HG_Error_to_string(ret));
+    }
+
+    HG_Destroy(handle);
+
+    return true;
+}
+
 template <typename ExecutionContext>
 hg_return_t
 post_to_mercury(ExecutionContext* ctx) {
@@ -333,58 +437,19 @@ post_to_mercury(ExecutionContext* ctx) {
 
         auto* ctx = reinterpret_cast<ExecutionContext*>(cbi->arg);
 
-        if(cbi->ret == HG_CANCELED) {
-            switch(ctx->m_status.load()) {
-                case request_status::timeout: 
-                {
-                    HERMES_DEBUG2("Request timed out, reposting");
-                    // repost the request
-                    hg_return ret = post_to_mercury<ExecutionContext>(ctx);
-
-                    if(ret != HG_SUCCESS) {
-                        HERMES_DEBUG2("Failed to repost request: {}", 
-                                      HG_Error_to_string(ret));
-
-                        ctx->m_output_promise.set_exception(
-                            std::make_exception_ptr(
-                                std::runtime_error("Failed to repost request: "
-                                    + std::string(HG_Error_to_string(ret)))));
-
-                        return ret;
-                    }
-
-                    break;
-                }
-
-                case request_status::cancelled:
-                {
-                    // this can happen if the request timed out repeatedly
-                    // and we exhausted the configured retries
-                    // The only option is to definitely cancel the request and
-                    // set an exception for the user
-                    HERMES_DEBUG2("Request was cancelled");
-
-                    ctx->m_output_promise.set_exception(
-                            std::make_exception_ptr(
-                                std::runtime_error("Request timed out")));
-
-                    if(cbi->info.forward.handle != HG_HANDLE_NULL) {
-                        HG_Destroy(cbi->info.forward.handle);
-                    }
-                    break;
-                }
-
-                default:
-                    HERMES_DEBUG2("Request is in an inconsistent state");
-                    ctx->m_output_promise.set_exception(
-                            std::make_exception_ptr(
-                                std::runtime_error("Request is in an "
-                                                   "inconsistent state")));
-
-                    if(cbi->info.forward.handle != HG_HANDLE_NULL) {
-                        HG_Destroy(cbi->info.forward.handle);
-                    }
-            }
+        // if the RPC was cancelled first, the handle belongs to whoever 
+        // cancelled it (see cancel_mercury_rpc()), so it must not be 
+        // touched here, let alone returned to the cache
+        request_status expected = request_status::created;
+
+        if(!ctx->m_status.compare_exchange_strong(
+                    expected, request_status::completed)) {
+
+            HERMES_DEBUG2("Request was cancelled");
+
+            ctx->set_error(
+                    std::make_exception_ptr(
+                        std::runtime_error("Request timed out")));
 
             return cbi->ret;
         }
@@ -393,15 +458,18 @@ post_to_mercury(ExecutionContext* ctx) {
             HERMES_DEBUG("Forward request failed: {}", 
                          HG_Error_to_string(cbi->ret));
 
-            ctx->m_output_promise.set_exception(
-                    std::make_exception_ptr(
-                        std::runtime_error("Request failed: " + 
-                            std::string(HG_Error_to_string(cbi->ret)))));
-
+            // a failed handle is never returned to the cache
             if(cbi->info.forward.handle != HG_HANDLE_NULL) {
                 HG_Destroy(cbi->info.forward.handle);
             }
 
+            ctx->m_handle = HG_HANDLE_NULL;
+
+            ctx->set_error(
+                    std::make_exception_ptr(
+                        std::runtime_error("Request failed: " + 
+                            std::string(HG_Error_to_string(cbi->ret)))));
+
             return cbi->ret;
         }
 
@@ -412,39 +480,69 @@ post_to_mercury(ExecutionContext* ctx) {
                 detail::decode_mercury_output<Request>(
                         cbi->info.forward.handle);
 
-            ctx->m_output_promise.set_value(RequestOutput(hg_output));
-            // clean up resources consumed by this RPC
+            // clean up resources consumed by this RPC before handing the
+            // output over, since the context may be released as soon as
+            // it gets it
+            RequestOutput output(hg_output);
 #ifdef HERMES_MARGO_COMPATIBLE_MODE
             margo::free_output(cbi->info.forward.handle,
                                Request::mercury_out_proc_cb, &hg_output);
 #else
             HG_Free_output(cbi->info.forward.handle, &hg_output);
 #endif // HERMES_MARGO_COMPATIBLE_MODE
+            release_mercury_handle(ctx, cbi->info.forward.handle);
+
+            ctx->set_output(std::move(output));
+
+            return HG_SUCCESS;
         }
 
-        HG_Destroy(cbi->info.forward.handle);
+        release_mercury_handle(ctx, cbi->info.forward.handle);
+
+        ctx->set_no_output();
 
         return HG_SUCCESS;
     };
 
 
-    // if the ExecutionContext already has a handle, we are probably reposting
-    // the request. In this case, we don't need to create a new handle, we can
-    // just reuse the old one since the Mercury documentation states that 
-    // this is safe to do
     if(ctx->m_handle == HG_HANDLE_NULL) {
-#ifdef HERMES_MARGO_COMPATIBLE_MODE
-        hg_id_t mercury_id = detail::registered_requests().at(Request::public_id)->m_mercury_id;
+        const hg_id_t mercury_id = mercury_id_of<Request>();
         HERMES_DEBUG("Creating Mercury handle with id {}", mercury_id);
-#else
-        hg_id_t mercury_id = Request::mercury_id;
-#endif // HERMES_MARGO_COMPATIBLE_MODE
-        // create a Mercury handle for the RPC and save it in the RPC's
-        // execution context
-        ctx->m_handle = detail::create_mercury_handle(
-                ctx->m_hg_context, ctx->m_address->mercury_address(),
-                mercury_id);
+
+        // reuse a handle from a previous RPC with the same destination if
+        // possible, or create a new Mercury handle for the RPC otherwise,
+        // and save it in the RPC's execution context
+        if(ctx->m_handle_cache != nullptr) {
+            ctx->m_handle = ctx->m_handle_cache->acquire(
+                    ctx->m_hg_context, ctx->m_address->mercury_address(),
+                    mercury_id, ctx->m_target_id);
+        }
+
+        if(ctx->m_handle == HG_HANDLE_NULL) {
+            ctx->m_handle = detail::create_mercury_handle(
+                    ctx->m_hg_context, ctx->m_address->mercury_address(),
+                    mercury_id);
+        }
+
+        // deliver the RPC to a specific context at the target if the engine
+        // is talking to sharded servers (context 0 is Mercury's default)
+        if(ctx->m_target_id != 0) {
+            hg_return_t ret = HG_Set_target_id(ctx->m_handle, 
+                                               ctx->m_target_id);
+
+            HERMES_DEBUG2("HG_Set_target_id(handle={}, id={}) = {}",
+                          fmt::ptr(ctx->m_handle), ctx->m_target_id, 
+                          HG_Error_to_string(ret));
+
+            if(ret != HG_SUCCESS) {
+                return ret;
+            }
+        }
     }
+    // the input is encoded by HG_Forward() itself, so the envelope doesn't
+    // need to outlive this call
+    input_envelope input = ctx->m_input.envelope();
+
 #ifdef HERMES_MARGO_COMPATIBLE_MODE
     hg_return_t ret = margo::forward(
             // Mercury handle
@@ -454,9 +552,9 @@ post_to_mercury(ExecutionContext* ctx) {
             // pointer to data passed to callback
             reinterpret_cast<void*>(ctx),
             // pointer to input proc function
-            Request::mercury_in_proc_cb,
+            input_proc<Request>,
             // pointer to input structure
-            &ctx->m_mercury_input);
+            &input);
 #else
     hg_return_t ret = HG_Forward(
             // Mercury handle
@@ -466,14 +564,16 @@ post_to_mercury(ExecutionContext* ctx) {
             // pointer to data passed to callback
             reinterpret_cast<void*>(ctx),
             // pointer to input structure
-            &ctx->m_mercury_input);
+            &input);
 #endif // HERMES_MARGO_COMPATIBLE_MODE
 
-    HERMES_DEBUG2("HG_Forward(handle={}, cb={}, arg={}, input={}) = {}",
+    HERMES_DEBUG2("HG_Forward(handle={}, cb={}, arg={}, input={}, "
+                  "pre-encoded={}) = {}",
                   fmt::ptr(ctx->m_handle), 
                   "lambda::completion_callback",
                   fmt::ptr(ctx), 
-                  fmt::ptr(&ctx->m_mercury_input), 
+                  fmt::ptr(input.m_mercury_input), 
+                  input.m_encoded_size,
                   HG_Error_to_string(ret));
 
     return ret;
@@ -543,42 +643,46 @@ mercury_bulk_transfer(hg_handle_t handle,
     }
 }
 
-template <typename Input, typename Output>
+/**
+ * Send @a out as the response of the RPC in @a handle. The output is
+ * encoded before this returns, and @a completion_callback (if any) is 
+ * invoked with @a arg once Mercury has actually sent the response.
+ */
+template <typename Request, typename Output>
 inline void
-mercury_respond(request<Input>&& req, 
-                Output&& out) {
+mercury_respond(hg_handle_t handle, 
+                Output&& out,
+                hg_cb_t completion_callback,
+                void* arg) {
 #ifdef HERMES_MARGO_COMPATIBLE_MODE
-    // This is just a best effort response, we don't bother specifying
-    // a callback here for completion
     hg_return_t ret = margo::respond(
             // handle
-            req.m_handle,
+            handle,
             // callback
-            NULL,
+            completion_callback,
             // arg
-            NULL,
+            arg,
             // pointer to proc function
-            Output::mercury_out_proc_cb,
+            Request::mercury_out_proc_cb,
             // output struct
             &out);
 #else
-
-    // This is just a best effort response, we don't bother specifying
-    // a callback here for completion
     hg_return_t ret = HG_Respond(
                             // handle
-                            req.m_handle,
+                            handle,
                             // callback
-                            NULL,
+                            completion_callback,
                             // arg
-                            NULL,
+                            arg,
                             // output struct
                             &out);
 #endif // HERMES_MARGO_COMPATIBLE_MODE
 
     HERMES_DEBUG2("HG_Respond(hg_handle={}, callback={}, arg={}, "
-                  "out_struct={}) = {}", fmt::ptr(req.m_handle), "NULL", 
-                  "NULL", fmt::ptr(&out), ret);
+                  "out_struct={}) = {}", fmt::ptr(handle), 
+                  (completion_callback ? "lambda::completion_callback" : 
+                                         "NULL"),
+                  fmt::ptr(arg), fmt::ptr(&out), ret);
 
     if(ret != HG_SUCCESS) {
         throw std::runtime_error("Failed to respond: " + 
@@ -586,6 +690,30 @@ mercury_respond(request<Input>&& req,
     }
 }
 
+template <typename Input, typename Output>
+inline void
+mercury_respond(request<Input>&& req, 
+                Output&& out) {
+
+    // This is just a best effort response, we don't bother specifying
+    // a callback here for completion
+    mercury_respond<Input>(req.mercury_handle(), std::forward<Output>(out), 
+                           NULL, NULL);
+}
+
+
+// A decoded request waiting in a thread_pool for its user handler to run
+template <typename Request>
+struct deferred_request {
+
+    void
+    operator()() {
+        m_descriptor->invoke_user_handler(std::move(m_request));
+    }
+
+    request_descriptor<Request>* m_descriptor;
+    request<Request> m_request;
+};
 
 template <typename Request>
 static inline hg_return_t
@@ -594,15 +722,22 @@ mercury_handler(hg_handle_t handle) {
     // using input_type = typename Request::input_type;
     // using mercury_input_type = typename Request::mercury_input_type;
 
-    const auto descriptor = 
-        std::static_pointer_cast<detail::request_descriptor<Request>>(
-            detail::registered_requests().at(Request::public_id));
+    request_descriptor<Request>* const descriptor = 
+        detail::descriptor_of<Request>();
 
     if(!descriptor) {
         throw std::runtime_error("Requested descriptor for request "
                                  "of unknown type");
     }
 
+    // if the request type is served by a thread pool, the progress thread
+    // only hands the request over (its input is decoded by the worker)
+    if(thread_pool* executor = descriptor->executor()) {
+        executor->submit(deferred_request<Request>{
+                descriptor, request<Request>(handle)});
+        return HG_SUCCESS;
+    }
+
     descriptor->invoke_user_handler(std::move(request<Request>(handle)));
 
     return HG_SUCCESS;
@@ -0,0 +1,110 @@
+#ifndef __HERMES_DETAIL_OBJECT_POOL_HPP__
+#define __HERMES_DETAIL_OBJECT_POOL_HPP__
+
+// C++ includes
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace hermes {
+namespace detail {
+
+/**
+ * A free list of raw memory blocks of a fixed size. Blocks are returned to
+ * the free list instead of being released, up to a maximum number of
+ * blocks, so that objects that are continuously created and destroyed
+ * (e.g. the execution contexts of RPCs) do not hit the allocator in steady
+ * state.
+ */
+class free_list {
+
+public:
+    explicit free_list(std::size_t max_blocks) :
+        m_max_blocks(max_blocks) {
+        m_blocks.reserve(max_blocks);
+    }
+
+    void*
+    pop() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if(m_blocks.empty()) {
+            return nullptr;
+        }
+
+        void* p = m_blocks.back();
+        m_blocks.pop_back();
+        return p;
+    }
+
+    bool
+    push(void* p) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if(m_blocks.size() >= m_max_blocks) {
+            return false;
+        }
+
+        m_blocks.push_back(p);
+        return true;
+    }
+
+private:
+    const std::size_t m_max_blocks;
+    std::mutex m_mutex;
+    std::vector<void*> m_blocks;
+};
+
+/**
+ * Base class that makes `new T` and `delete` recycle memory through a free
+ * list shared by all objects of type T (i.e. by all engines, since memory
+ * blocks carry no state). Since objects may be created in one thread and
+ * destroyed in another (e.g. in a progress thread), the free list is shared
+ * rather than thread-local.
+ */
+template <typename T>
+struct pooled {
+
+    static void*
+    operator new(std::size_t size) {
+
+        // derived types are not pooled
+        if(size == sizeof(T)) {
+            if(void* p = blocks().pop()) {
+                return p;
+            }
+        }
+
+        return ::operator new(size);
+    }
+
+    static void
+    operator delete(void* p, std::size_t size) {
+
+        if(p == nullptr) {
+            return;
+        }
+
+        if(size != sizeof(T) || !blocks().push(p)) {
+            ::operator delete(p);
+        }
+    }
+
+private:
+    static constexpr const std::size_t max_pooled_objects = 4096;
+
+    static free_list&
+    blocks() {
+        // intentionally leaked so that objects released during static
+        // destruction (e.g. by an engine with static storage duration) can
+        // still use it
+        static free_list* const list = new free_list(max_pooled_objects);
+        return *list;
+    }
+};
+
+} // namespace detail
+} // namespace hermes
+
+#endif // __HERMES_DETAIL_OBJECT_POOL_HPP__
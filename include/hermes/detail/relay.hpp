@@ -0,0 +1,380 @@
+#ifndef __HERMES_DETAIL_RELAY_HPP__
+#define __HERMES_DETAIL_RELAY_HPP__
+
+// C includes
+#include <mercury.h>
+#include <mercury_proc.h>
+
+// C++ includes
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// project includes
+#include <hermes/logging.hpp>
+#include <hermes/request.hpp>
+#include <hermes/result.hpp>
+#include <hermes/detail/encoding.hpp>
+
+namespace hermes {
+
+// defined elsewhere
+template <typename Request>
+class rpc_handle;
+
+namespace detail {
+
+/** Outcome of a relayed RPC for one target: either its encoded output
+ * (m_status == HG_SUCCESS) or an error message */
+struct relay_entry {
+    hg_int32_t m_status;
+    std::vector<char> m_data;
+};
+
+/** Input of a relay RPC (see relay_rpc) */
+struct relay_in_t {
+    // public id of the relayed request
+    hg_uint16_t m_request_id;
+    // maximum number of relays each relay forwards to
+    hg_uint32_t m_fanout;
+    // the relayed request's input, already encoded
+    std::vector<char> m_payload;
+    // targets of the subtree: the first one is the relay itself
+    std::vector<std::string> m_targets;
+};
+
+/** Output of a relay RPC: one entry per target, in the same order as
+ * relay_in_t::m_targets */
+struct relay_out_t {
+    std::vector<relay_entry> m_entries;
+};
+
+/** Serialize a contiguous container of bytes as its size followed by its
+ * contents */
+template <typename Container>
+inline hg_return_t
+proc_bytes(hg_proc_t proc, Container& bytes) {
+
+    hg_uint64_t size = bytes.size();
+    hg_return_t ret = hg_proc_hg_uint64_t(proc, &size);
+
+    if(ret != HG_SUCCESS) {
+        return ret;
+    }
+
+    switch(hg_proc_get_op(proc)) {
+        case HG_ENCODE:
+            break;
+        case HG_DECODE:
+            bytes.resize(size);
+            break;
+        case HG_FREE:
+            Container().swap(bytes);
+            return HG_SUCCESS;
+    }
+
+    if(size == 0) {
+        return HG_SUCCESS;
+    }
+
+    return hg_proc_memcpy(proc, &bytes[0], size);
+}
+
+/** Serialize a vector of @a T using @a proc_element for each element */
+template <typename T, typename ProcElement>
+inline hg_return_t
+proc_vector(hg_proc_t proc, std::vector<T>& v, ProcElement&& proc_element) {
+
+    hg_uint64_t count = v.size();
+    hg_return_t ret = hg_proc_hg_uint64_t(proc, &count);
+
+    if(ret != HG_SUCCESS) {
+        return ret;
+    }
+
+    if(hg_proc_get_op(proc) == HG_DECODE) {
+        v.resize(count);
+    }
+
+    for(auto&& e : v) {
+        if((ret = proc_element(proc, e)) != HG_SUCCESS) {
+            return ret;
+        }
+    }
+
+    if(hg_proc_get_op(proc) == HG_FREE) {
+        std::vector<T>().swap(v);
+    }
+
+    return HG_SUCCESS;
+}
+
+inline hg_return_t
+hg_proc_relay_in_t(hg_proc_t proc, void* data) {
+
+    auto* in = static_cast<relay_in_t*>(data);
+    hg_return_t ret;
+
+    if((ret = hg_proc_hg_uint16_t(proc, &in->m_request_id)) != HG_SUCCESS ||
+       (ret = hg_proc_hg_uint32_t(proc, &in->m_fanout)) != HG_SUCCESS ||
+       (ret = proc_bytes(proc, in->m_payload)) != HG_SUCCESS) {
+        return ret;
+    }
+
+    return proc_vector(proc, in->m_targets,
+                       [](hg_proc_t p, std::string& s) {
+                           return proc_bytes(p, s);
+                       });
+}
+
+inline hg_return_t
+hg_proc_relay_out_t(hg_proc_t proc, void* data) {
+
+    auto* out = static_cast<relay_out_t*>(data);
+
+    return proc_vector(proc, out->m_entries,
+                       [](hg_proc_t p, relay_entry& e) {
+                           hg_return_t ret =
+                               hg_proc_hg_int32_t(p, &e.m_status);
+
+                           if(ret != HG_SUCCESS) {
+                               return ret;
+                           }
+
+                           return proc_bytes(p, e.m_data);
+                       });
+}
+
+/**
+ * Request type used internally by async_engine::tree_broadcast(). A relay
+ * runs the relayed request on itself, forwards it to the rest of its
+ * subtree (through up to m_fanout other relays) and responds with the
+ * outputs of the whole subtree. Relays only deal with encoded inputs and
+ * outputs, so they don't need to know the relayed request's type, only
+ * that it is registered.
+ *
+ * Public ids from 0xfff0 onwards are reserved for hermes' own requests
+ * (see first_reserved_public_id).
+ */
+struct relay_rpc {
+
+    // traits used so that the engine knows what to do with the RPC
+    using self_type = relay_rpc;
+    using handle_type = hermes::rpc_handle<self_type>;
+    using input_type = relay_in_t;
+    using output_type = relay_out_t;
+    using mercury_input_type = relay_in_t;
+    using mercury_output_type = relay_out_t;
+
+    // RPC public identifier
+    constexpr static const uint16_t public_id = 0xfff0;
+
+    // RPC internal Mercury identifier
+    constexpr static const uint16_t mercury_id = public_id;
+
+    // RPC name
+    constexpr static const auto name = "hermes_relay";
+
+    // requires response?
+    constexpr static const auto requires_response = true;
+
+    // Mercury callback to serialize input arguments
+    constexpr static const auto mercury_in_proc_cb = hg_proc_relay_in_t;
+
+    // Mercury callback to serialize output arguments
+    constexpr static const auto mercury_out_proc_cb = hg_proc_relay_out_t;
+};
+
+/** Make a relay_entry describing a failure */
+inline relay_entry
+relay_error(const std::string& message) {
+    return {HG_OTHER_ERROR, std::vector<char>(message.begin(),
+                                              message.end())};
+}
+
+/**
+ * State of a relay RPC being served: the outputs collected so far for each
+ * target of the subtree, and the request to respond to once all of them
+ * have arrived
+ */
+class relay_state {
+
+public:
+    relay_state(request<relay_rpc>&& req, std::size_t targets) :
+        m_request(std::move(req)),
+        m_entries(targets),
+        m_pending(targets) { }
+
+    /**
+     * Record the outcomes of the targets starting at @a first. Returns true
+     * if they were the last ones, in which case the caller must respond
+     * to the request (see take_request() and take_output()).
+     */
+    bool
+    set(std::size_t first, std::vector<relay_entry>&& entries) {
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for(std::size_t i = 0; i < entries.size(); ++i) {
+            m_entries[first + i] = std::move(entries[i]);
+        }
+
+        m_pending -= entries.size();
+        return m_pending == 0;
+    }
+
+    bool
+    set(std::size_t index, relay_entry&& entry) {
+        std::vector<relay_entry> entries;
+        entries.emplace_back(std::move(entry));
+        return set(index, std::move(entries));
+    }
+
+    request<relay_rpc>
+    take_request() {
+        return std::move(m_request);
+    }
+
+    relay_out_t
+    take_output() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return {std::move(m_entries)};
+    }
+
+private:
+    request<relay_rpc> m_request;
+    std::mutex m_mutex;
+    std::vector<relay_entry> m_entries;
+    std::size_t m_pending;
+};
+
+/** Context of an RPC forwarded by a relay to one of its targets */
+struct relayed_call {
+    std::shared_ptr<relay_state> m_state;
+    std::size_t m_index;
+    bool m_requires_response;
+    std::vector<char> (*m_encoded_output)(hg_handle_t);
+};
+
+/**
+ * State shared between a tree_rpc_handle and the relay RPCs sent on its
+ * behalf: the result for each target, in the order they were given
+ */
+template <typename Request>
+class tree_state {
+
+    using Output = typename Request::output_type;
+
+public:
+    explicit tree_state(std::size_t targets) :
+        m_results(targets, result<Output>(std::exception_ptr())),
+        m_pending(targets) { }
+
+    /** Decode and record the outcome of the relay RPC sent to the subtree
+     * of @a count targets starting at @a first */
+    void
+    complete(hg_class_t* hg_class, std::size_t first, std::size_t count,
+             result<relay_out_t>&& rv) {
+
+        std::vector<result<Output>> results;
+        results.reserve(count);
+
+        if(rv && rv.value().m_entries.size() != count) {
+            rv = result<relay_out_t>(std::make_exception_ptr(
+                    std::runtime_error("Malformed relay response")));
+        }
+
+        for(std::size_t i = 0; i < count; ++i) {
+
+            if(!rv) {
+                results.emplace_back(rv.error());
+                continue;
+            }
+
+            const relay_entry& e = rv.value().m_entries[i];
+
+            if(e.m_status != HG_SUCCESS) {
+                results.emplace_back(std::make_exception_ptr(
+                    std::runtime_error(std::string(e.m_data.begin(),
+                                                   e.m_data.end()))));
+                continue;
+            }
+
+            try {
+                results.emplace_back(
+                        decode_output<Request>(hg_class, e.m_data));
+            }
+            catch(const std::exception&) {
+                results.emplace_back(std::current_exception());
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            for(std::size_t i = 0; i < count; ++i) {
+                m_results[first + i] = std::move(results[i]);
+            }
+
+            m_pending -= count;
+        }
+
+        m_cv.notify_all();
+    }
+
+    template <typename Clock, typename Duration>
+    bool
+    wait_until(const std::chrono::time_point<Clock, Duration>& deadline) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_cv.wait_until(lock, deadline, [this]() {
+            return m_pending == 0;
+        });
+    }
+
+    bool
+    completed() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_pending == 0;
+    }
+
+    /** Must only be called once all results have arrived */
+    std::vector<result<Output>>&
+    results() {
+        return m_results;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<result<Output>> m_results;
+    std::size_t m_pending;
+};
+
+/** Split @a count targets into (at most) @a fanout contiguous groups of
+ * similar size, returning the size of each group */
+inline std::vector<std::size_t>
+split_targets(std::size_t count, std::size_t fanout) {
+
+    const std::size_t groups = std::min(count, fanout);
+    std::vector<std::size_t> sizes;
+    sizes.reserve(groups);
+
+    for(std::size_t i = 0; i < groups; ++i) {
+        sizes.push_back(count / groups + (i < count % groups ? 1 : 0));
+    }
+
+    return sizes;
+}
+
+} // namespace detail
+} // namespace hermes
+
+#endif // __HERMES_DETAIL_RELAY_HPP__
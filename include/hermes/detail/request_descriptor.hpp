@@ -5,10 +5,17 @@
 #include <mercury.h>
 
 // C++ includes
-#include <functional>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 // project includes
 #include <hermes/logging.hpp>
+#include <hermes/detail/encoding.hpp>
+#include <hermes/detail/rpc_input.hpp>
 
 namespace hermes {
 
@@ -25,6 +32,9 @@ class request;
 // defined elsewhere
 class async_engine;
 
+// defined elsewhere
+class thread_pool;
+
 namespace detail {
 
 // defined elsewhere
@@ -41,6 +51,8 @@ public:
                             const bool requires_response,
                             const hg_proc_cb_t in_proc_cb,
                             const hg_proc_cb_t out_proc_cb,
+                            const hg_proc_cb_t forward_in_proc_cb,
+                            std::vector<char> (*encoded_output)(hg_handle_t),
                             const hg_rpc_cb_t handler) :
         m_id(id),
         m_mercury_id(hg_id),
@@ -48,10 +60,31 @@ public:
         m_requires_response(requires_response),
         m_mercury_input_cb(in_proc_cb),
         m_mercury_output_cb(out_proc_cb),
+        m_forward_input_cb(forward_in_proc_cb),
+        m_encoded_output(encoded_output),
         m_handler(handler) {}
 
     virtual ~request_descriptor_base() = default;
 
+    /** Set the thread pool where user handlers (and the completion callbacks
+     * of bulk transfers for this request type) should run. If nullptr, they
+     * run inline in the progress thread */
+    void
+    set_executor(thread_pool* executor) {
+        m_executor.store(executor, std::memory_order_release);
+    }
+
+    /** Stop using @a executor, if it is the one currently set */
+    void
+    release_executor(thread_pool* executor) {
+        (void) m_executor.compare_exchange_strong(executor, nullptr);
+    }
+
+    thread_pool*
+    executor() const {
+        return m_executor.load(std::memory_order_acquire);
+    }
+
 protected:
     request_descriptor_base(request_descriptor_base&&) = default;
     request_descriptor_base(const request_descriptor_base&) = delete;
@@ -65,7 +98,17 @@ public:
     const bool m_requires_response;
     const hg_proc_cb_t m_mercury_input_cb;
     const hg_proc_cb_t m_mercury_output_cb;
+    // proc callback actually registered with Mercury for the input, which 
+    // wraps m_mercury_input_cb so that outgoing RPCs can reuse an input that 
+    // was already encoded (see detail::input_proc())
+    const hg_proc_cb_t m_forward_input_cb;
+    // decode the output received in a handle and encode it again into a 
+    // plain buffer, so that relays can forward it (see detail::relay_rpc)
+    std::vector<char> (* const m_encoded_output)(hg_handle_t);
     const hg_rpc_cb_t m_handler;
+
+private:
+    std::atomic<thread_pool*> m_executor{nullptr};
 };
 
 template <typename Request>
@@ -112,32 +155,84 @@ struct request_descriptor : public request_descriptor_base {
                                 requires_response,
                                 in_proc_cb, 
                                 out_proc_cb, 
+                                input_proc<request_type>,
+                                encoded_output<request_type>,
                                 mercury_handler<request_type>) {}
 
+    request_descriptor(const request_descriptor&) = delete;
+    request_descriptor& operator=(const request_descriptor&) = delete;
+
+    ~request_descriptor() {
+        reset_user_handler();
+    }
+
+    /**
+     * Set the handler for requests of this type. The handler is stored as
+     * a plain function pointer along with the (type-erased) callable it 
+     * invokes, so that dispatching a request is a single indirect call 
+     * rather than going through std::function. Must not be called while
+     * requests of this type are being served.
+     */
     template <typename Callable>
     void
     set_user_handler(Callable&& handler) {
 
+        using Fn = typename std::decay<Callable>::type;
+
         HERMES_DEBUG2("Setting user handler for requests of type \"{}\"", 
                       std::string(name));
-        m_user_handler = std::forward<Callable>(handler);
+
+        void* const callable = new Fn(std::forward<Callable>(handler));
+
+        reset_user_handler();
+
+        m_handler_ctx = callable;
+        m_handler_fn = &invoke_callable<Fn>;
+        m_handler_deleter = &destroy_callable<Fn>;
     }
 
-    template <typename RequestHandle>
     void
-    invoke_user_handler(RequestHandle&& req) {
+    invoke_user_handler(hermes::request<request_type>&& req) {
 
-        if(!m_user_handler) {
+        if(m_handler_fn == nullptr) {
             throw std::runtime_error("User handler for request [" + 
                     std::string(name) +  "] not set");
         }
 
-        m_user_handler(std::forward<RequestHandle>(req));
+        m_handler_fn(m_handler_ctx, std::move(req));
     }
 
 private:
-    using handler_type = std::function<void(hermes::request<request_type>&&)>;
-    handler_type m_user_handler;
+    using invoker_type = void (*)(void*, hermes::request<request_type>&&);
+    using deleter_type = void (*)(void*);
+
+    template <typename Fn>
+    static void
+    invoke_callable(void* callable, hermes::request<request_type>&& req) {
+        (*static_cast<Fn*>(callable))(std::move(req));
+    }
+
+    template <typename Fn>
+    static void
+    destroy_callable(void* callable) {
+        delete static_cast<Fn*>(callable);
+    }
+
+    void
+    reset_user_handler() {
+
+        if(m_handler_deleter != nullptr) {
+            m_handler_deleter(m_handler_ctx);
+        }
+
+        m_handler_fn = nullptr;
+        m_handler_deleter = nullptr;
+        m_handler_ctx = nullptr;
+    }
+
+    invoker_type m_handler_fn = nullptr;
+    deleter_type m_handler_deleter = nullptr;
+    void* m_handler_ctx = nullptr;
 };
 
 } // namespace detail
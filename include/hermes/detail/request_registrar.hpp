@@ -12,6 +12,23 @@
 namespace hermes {
 namespace detail {
 
+/** Public ids from this one onwards are reserved for hermes' own requests
+ * (e.g. relay_rpc and collective_rpc) */
+constexpr const uint64_t first_reserved_public_id = 0xfff0;
+
+/**
+ * The descriptor registered for Request, filled in when the type is added
+ * to the registrar, so that hot paths (e.g. dispatching incoming RPCs) can
+ * reach it without a map lookup. Descriptors are never removed, so a raw
+ * pointer is enough.
+ */
+template <typename Request>
+inline request_descriptor<Request>*&
+descriptor_slot() {
+    static request_descriptor<Request>* descriptor = nullptr;
+    return descriptor;
+}
+
 template <typename Key, typename Value>
 class request_registrar {
 
@@ -53,10 +70,13 @@ public:
             throw std::runtime_error("Failed to add request type: duplicate id");
         }
 
-        m_request_types.emplace(id,
-                std::make_shared<request_descriptor<Request>>(
+        const auto descriptor = 
+            std::make_shared<request_descriptor<Request>>(
                     id, mercury_id, name, requires_response,
-                    mercury_in_proc_cb, mercury_out_proc_cb));
+                    mercury_in_proc_cb, mercury_out_proc_cb);
+
+        m_request_types.emplace(id, descriptor);
+        descriptor_slot<Request>() = descriptor.get();
 
         return true;
     }
@@ -94,6 +114,24 @@ registered_requests() {
     return request_registrar<uint64_t, request_descriptor_base>::singleton();
 }
 
+/**
+ * Return the descriptor of Request, or nullptr if the type was never
+ * registered. This is O(1) once Request has been added to the registrar,
+ * and only falls back to looking it up by public id if the descriptor was
+ * registered through another type with identical traits.
+ */
+template <typename Request>
+inline request_descriptor<Request>*
+descriptor_of() {
+
+    if(request_descriptor<Request>* descriptor = descriptor_slot<Request>()) {
+        return descriptor;
+    }
+
+    return static_cast<request_descriptor<Request>*>(
+            registered_requests().at(Request::public_id).get());
+}
+
 } // namespace detail
 } // namespace hermes
 
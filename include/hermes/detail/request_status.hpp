@@ -1,16 +1,33 @@
 #ifndef __HERMES_DETAIL_REQUEST_STATUS_HPP__
 #define __HERMES_DETAIL_REQUEST_STATUS_HPP__
 
+// C++ includes
+#include <chrono>
+
 namespace hermes {
 namespace detail {
 
+/**
+ * Lifecycle of an outgoing RPC. Once posted, an RPC leaves `created` 
+ * exactly once, either because its completion callback ran (`completed`) or
+ * because it was cancelled after timing out (`cancelled`), and whichever 
+ * side moves it out of `created` owns its Mercury handle from then on. 
+ * Transitions must therefore be done with a compare-exchange.
+ */
 enum class request_status {
     created,
     failed,
-    timeout,
+    completed,
     cancelled
 };
 
+/** How long all handles (and async_engine::call()) wait for an RPC before
+ * cancelling it */
+constexpr std::chrono::seconds
+rpc_timeout() {
+    return std::chrono::seconds(100);
+}
+
 } // namespace detail
 } // namespace hermes
 
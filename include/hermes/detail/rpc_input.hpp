@@ -0,0 +1,180 @@
+#ifndef __HERMES_DETAIL_RPC_INPUT_HPP__
+#define __HERMES_DETAIL_RPC_INPUT_HPP__
+
+// C includes
+#include <mercury.h>
+#include <mercury_proc.h>
+
+// C++ includes
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// project includes
+#include <hermes/logging.hpp>
+#include <hermes/detail/encoding.hpp>
+
+namespace hermes {
+namespace detail {
+
+/**
+ * What hermes hands over to HG_Forward() as the RPC's input: the Mercury
+ * input of the RPC and, optionally, a buffer with that same input already
+ * encoded (e.g. by a broadcast). The envelope only needs to live until
+ * HG_Forward() returns, since Mercury encodes the input synchronously.
+ */
+struct input_envelope {
+    const void* m_mercury_input;
+    const char* m_encoded;
+    hg_size_t m_encoded_size;
+};
+
+/**
+ * Proc callback registered for the input of @a Request. When encoding, it
+ * receives an input_envelope and either copies the pre-encoded bytes into
+ * the RPC's buffer or encodes the Mercury input with the request's own proc
+ * callback. Decoding and freeing (i.e. at the target) are forwarded
+ * untouched to the request's proc callback, so both produce the same bytes
+ * on the wire.
+ */
+template <typename Request>
+inline hg_return_t
+input_proc(hg_proc_t proc, void* data) {
+
+    if(hg_proc_get_op(proc) != HG_ENCODE) {
+        return Request::mercury_in_proc_cb(proc, data);
+    }
+
+    const auto* envelope = static_cast<const input_envelope*>(data);
+
+    if(envelope->m_encoded_size == 0) {
+        return Request::mercury_in_proc_cb(
+                proc, const_cast<void*>(envelope->m_mercury_input));
+    }
+
+    return hg_proc_memcpy(proc, const_cast<char*>(envelope->m_encoded),
+                          envelope->m_encoded_size);
+}
+
+/**
+ * Encode @a hg_input with the proc callback of @a Request into a plain
+ * buffer, so that it can be copied as-is into the handles of several RPCs
+ */
+template <typename Request>
+inline std::vector<char>
+encode_mercury_input(hg_class_t* hg_class,
+                     const typename Request::mercury_input_type& hg_input) {
+    return encode_with_proc(
+            hg_class, Request::mercury_in_proc_cb, 
+            const_cast<typename Request::mercury_input_type*>(&hg_input));
+}
+
+/**
+ * Immutable input shared by all the RPCs of a broadcast: the user's input,
+ * its Mercury counterpart (which may point into it) and, if encoding it
+ * ahead of time succeeded, its encoded bytes
+ */
+template <typename Request>
+struct shared_input {
+
+    using Input = typename Request::input_type;
+    using MercuryInput = typename Request::mercury_input_type;
+
+    explicit shared_input(Input&& input) :
+        m_user_input(std::move(input)),
+        // invoke explicit cast constructor
+        m_mercury_input(m_user_input) { }
+
+    shared_input(const shared_input&) = delete;
+    shared_input& operator=(const shared_input&) = delete;
+
+    Input m_user_input;
+    const MercuryInput m_mercury_input;
+    std::vector<char> m_encoded;
+};
+
+/**
+ * Build the input for a broadcast, encoding it once for all targets. If
+ * the input can't be encoded ahead of time, each RPC encodes it by itself
+ * (but it is still shared).
+ */
+template <typename Request>
+inline std::shared_ptr<const shared_input<Request>>
+make_shared_input(hg_class_t* hg_class,
+                  typename Request::input_type&& input) {
+
+    auto payload = std::make_shared<shared_input<Request>>(std::move(input));
+
+    try {
+        payload->m_encoded = encode_mercury_input<Request>(
+                hg_class, payload->m_mercury_input);
+    }
+    catch(const std::exception& ex) {
+        HERMES_WARNING("Failed to pre-encode input for request \"{}\": {}",
+                       Request::name, ex.what());
+        payload->m_encoded.clear();
+    }
+
+    return payload;
+}
+
+/**
+ * Input of an RPC held by its execution context. It either owns the input
+ * (which lives inline in the context, so that single-target RPCs don't
+ * need any additional allocations) or shares the input of a broadcast.
+ * The context takes ownership of the user's input in order to ensure that
+ * any pointers in the Mercury input that refer back to it (e.g. strings)
+ * survive as long as needed, since Mercury does not take ownership of any
+ * pointers in the user input.
+ */
+template <typename Request>
+class rpc_input {
+
+    using Input = typename Request::input_type;
+    using Payload = shared_input<Request>;
+
+public:
+    explicit rpc_input(Input&& input) {
+        m_payload = ::new(&m_storage) Payload(std::move(input));
+    }
+
+    explicit rpc_input(std::shared_ptr<const Payload> shared) :
+        m_shared(std::move(shared)),
+        m_payload(m_shared.get()) { }
+
+    rpc_input(const rpc_input&) = delete;
+    rpc_input& operator=(const rpc_input&) = delete;
+
+    ~rpc_input() {
+        if(!m_shared) {
+            m_payload->~Payload();
+        }
+    }
+
+    const Input&
+    user_input() const {
+        return m_payload->m_user_input;
+    }
+
+    input_envelope
+    envelope() const {
+        return {&m_payload->m_mercury_input,
+                m_payload->m_encoded.data(),
+                m_payload->m_encoded.size()};
+    }
+
+private:
+    std::shared_ptr<const Payload> m_shared;
+    const Payload* m_payload;
+    typename std::aligned_storage<sizeof(Payload),
+                                  alignof(Payload)>::type m_storage;
+};
+
+} // namespace detail
+} // namespace hermes
+
+#endif // __HERMES_DETAIL_RPC_INPUT_HPP__
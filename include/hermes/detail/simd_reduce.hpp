@@ -0,0 +1,206 @@
+#ifndef __HERMES_DETAIL_SIMD_REDUCE_HPP__
+#define __HERMES_DETAIL_SIMD_REDUCE_HPP__
+
+// C++ includes
+#include <cstddef>
+#include <cstring>
+
+// SIMD kernels are only built with compilers that support GCC's vector
+// extensions and function-level target attributes (i.e. GCC and Clang),
+// and only for x86, since that's where runtime ISA dispatch pays off
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HERMES_SIMD_DISPATCH 1
+#endif
+
+#define HERMES_ALWAYS_INLINE inline __attribute__((always_inline))
+
+namespace hermes {
+namespace detail {
+
+/** Instruction sets that element-wise reductions can be dispatched to */
+enum class simd_isa {
+    scalar,
+    sse2,
+    avx2,
+    avx512
+};
+
+inline const char*
+simd_isa_name(simd_isa isa) {
+    switch(isa) {
+        case simd_isa::sse2:
+            return "sse2";
+        case simd_isa::avx2:
+            return "avx2";
+        case simd_isa::avx512:
+            return "avx512";
+        default:
+            return "scalar";
+    }
+}
+
+/** The widest instruction set supported by this CPU (detected once) */
+inline simd_isa
+detected_simd_isa() {
+#ifdef HERMES_SIMD_DISPATCH
+    static const simd_isa isa = []() {
+        __builtin_cpu_init();
+
+        if(__builtin_cpu_supports("avx512f")) {
+            return simd_isa::avx512;
+        }
+
+        if(__builtin_cpu_supports("avx2")) {
+            return simd_isa::avx2;
+        }
+
+        if(__builtin_cpu_supports("sse2")) {
+            return simd_isa::sse2;
+        }
+
+        return simd_isa::scalar;
+    }();
+
+    return isa;
+#else
+    return simd_isa::scalar;
+#endif // HERMES_SIMD_DISPATCH
+}
+
+// element-wise operations: they work both on scalars and on GCC vectors
+// (where comparisons yield masks that ?: uses to select lanes). Operands 
+// are passed by reference since passing wide vectors by value depends on
+// the ISA the caller is compiled for
+struct op_sum {
+    template <typename V>
+    HERMES_ALWAYS_INLINE void
+    operator()(V& acc, const V& v) const { acc = acc + v; }
+};
+
+struct op_min {
+    template <typename V>
+    HERMES_ALWAYS_INLINE void
+    operator()(V& acc, const V& v) const { acc = v < acc ? v : acc; }
+};
+
+struct op_max {
+    template <typename V>
+    HERMES_ALWAYS_INLINE void
+    operator()(V& acc, const V& v) const { acc = acc < v ? v : acc; }
+};
+
+struct op_and {
+    template <typename V>
+    HERMES_ALWAYS_INLINE void
+    operator()(V& acc, const V& v) const { acc = acc & v; }
+};
+
+struct op_or {
+    template <typename V>
+    HERMES_ALWAYS_INLINE void
+    operator()(V& acc, const V& v) const { acc = acc | v; }
+};
+
+struct op_xor {
+    template <typename V>
+    HERMES_ALWAYS_INLINE void
+    operator()(V& acc, const V& v) const { acc = acc ^ v; }
+};
+
+template <typename T, typename Op>
+HERMES_ALWAYS_INLINE void
+reduce_scalar(T* acc, const T* src, std::size_t n) {
+    for(std::size_t i = 0; i < n; ++i) {
+        Op()(acc[i], src[i]);
+    }
+}
+
+#ifdef HERMES_SIMD_DISPATCH
+
+/** Apply @a Op to @a Bytes worth of elements at a time. This is inlined
+ * into target-specific wrappers, so the vector operations are lowered to
+ * the instructions of the wrapper's target */
+template <typename T, std::size_t Bytes, typename Op>
+HERMES_ALWAYS_INLINE void
+reduce_vector(T* acc, const T* src, std::size_t n) {
+
+    typedef T vec __attribute__((vector_size(Bytes)));
+    constexpr std::size_t lanes = Bytes / sizeof(T);
+
+    std::size_t i = 0;
+
+    // memcpy() keeps unaligned loads and stores well-defined, and
+    // compiles down to plain vector moves
+    for(; i + lanes <= n; i += lanes) {
+        vec a, b;
+        std::memcpy(&a, acc + i, Bytes);
+        std::memcpy(&b, src + i, Bytes);
+        Op()(a, b);
+        std::memcpy(acc + i, &a, Bytes);
+    }
+
+    reduce_scalar<T, Op>(acc + i, src + i, n - i);
+}
+
+template <typename T, typename Op>
+__attribute__((target("sse2"))) void
+reduce_sse2(T* acc, const T* src, std::size_t n) {
+    reduce_vector<T, 16, Op>(acc, src, n);
+}
+
+template <typename T, typename Op>
+__attribute__((target("avx2"))) void
+reduce_avx2(T* acc, const T* src, std::size_t n) {
+    reduce_vector<T, 32, Op>(acc, src, n);
+}
+
+template <typename T, typename Op>
+__attribute__((target("avx512f"))) void
+reduce_avx512(T* acc, const T* src, std::size_t n) {
+    reduce_vector<T, 64, Op>(acc, src, n);
+}
+
+#endif // HERMES_SIMD_DISPATCH
+
+template <typename T, typename Op>
+void
+reduce_portable(T* acc, const T* src, std::size_t n) {
+    reduce_scalar<T, Op>(acc, src, n);
+}
+
+/**
+ * Combine @a n elements of @a src into @a acc with @a Op, using the kernel
+ * for the widest instruction set supported by the CPU. The kernel is
+ * selected the first time each <T, Op> combination is used.
+ */
+template <typename T, typename Op>
+inline void
+simd_reduce(T* acc, const T* src, std::size_t n) {
+
+    using kernel = void (*)(T*, const T*, std::size_t);
+
+    static const kernel selected = []() -> kernel {
+#ifdef HERMES_SIMD_DISPATCH
+        switch(detected_simd_isa()) {
+            case simd_isa::avx512:
+                return &reduce_avx512<T, Op>;
+            case simd_isa::avx2:
+                return &reduce_avx2<T, Op>;
+            case simd_isa::sse2:
+                return &reduce_sse2<T, Op>;
+            default:
+                break;
+        }
+#endif // HERMES_SIMD_DISPATCH
+        return &reduce_portable<T, Op>;
+    }();
+
+    selected(acc, src, n);
+}
+
+} // namespace detail
+} // namespace hermes
+
+#undef HERMES_ALWAYS_INLINE
+
+#endif // __HERMES_DETAIL_SIMD_REDUCE_HPP__
@@ -0,0 +1,207 @@
+#ifndef __HERMES_DETAIL_SMALL_VECTOR_HPP__
+#define __HERMES_DETAIL_SMALL_VECTOR_HPP__
+
+// C++ includes
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace hermes {
+namespace detail {
+
+/**
+ * A minimal vector that keeps up to N elements inline and only moves them
+ * to the heap when it grows beyond that, so that the common case (e.g.
+ * the single context of an rpc_handle for a single target) doesn't need
+ * an allocation. Elements only need to be move-constructible.
+ */
+template <typename T, std::size_t N>
+class small_vector {
+
+    static_assert(N > 0, "small_vector needs room for one element");
+
+    using Storage = typename std::aligned_storage<sizeof(T),
+                                                  alignof(T)>::type;
+
+public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    small_vector() :
+        m_data(inline_data()),
+        m_size(0),
+        m_capacity(N) { }
+
+    small_vector(const small_vector&) = delete;
+    small_vector& operator=(const small_vector&) = delete;
+
+    small_vector(small_vector&& rhs) :
+        m_data(inline_data()),
+        m_size(0),
+        m_capacity(N) {
+        steal(rhs);
+    }
+
+    small_vector&
+    operator=(small_vector&& rhs) {
+
+        if(this != &rhs) {
+            reset();
+            steal(rhs);
+        }
+
+        return *this;
+    }
+
+    ~small_vector() {
+        reset();
+    }
+
+    void
+    reserve(std::size_t capacity) {
+
+        if(capacity <= m_capacity) {
+            return;
+        }
+
+        T* data = reinterpret_cast<T*>(new Storage[capacity]);
+
+        for(std::size_t i = 0; i < m_size; ++i) {
+            ::new(&data[i]) T(std::move(m_data[i]));
+            m_data[i].~T();
+        }
+
+        release_storage();
+
+        m_data = data;
+        m_capacity = capacity;
+    }
+
+    template <typename... Args>
+    T&
+    emplace_back(Args&&... args) {
+
+        if(m_size == m_capacity) {
+            reserve(m_capacity * 2);
+        }
+
+        T* elem = ::new(&m_data[m_size]) T(std::forward<Args>(args)...);
+        ++m_size;
+        return *elem;
+    }
+
+    /** Destroy all elements, keeping the storage */
+    void
+    clear() {
+        for(std::size_t i = 0; i < m_size; ++i) {
+            m_data[i].~T();
+        }
+
+        m_size = 0;
+    }
+
+    std::size_t
+    size() const {
+        return m_size;
+    }
+
+    bool
+    empty() const {
+        return m_size == 0;
+    }
+
+    T&
+    operator[](std::size_t index) {
+        assert(index < m_size);
+        return m_data[index];
+    }
+
+    const T&
+    operator[](std::size_t index) const {
+        assert(index < m_size);
+        return m_data[index];
+    }
+
+    iterator
+    begin() {
+        return m_data;
+    }
+
+    iterator
+    end() {
+        return m_data + m_size;
+    }
+
+    const_iterator
+    begin() const {
+        return m_data;
+    }
+
+    const_iterator
+    end() const {
+        return m_data + m_size;
+    }
+
+private:
+    T*
+    inline_data() {
+        return reinterpret_cast<T*>(&m_inline[0]);
+    }
+
+    bool
+    is_inline() const {
+        return m_capacity == N;
+    }
+
+    void
+    release_storage() {
+        if(!is_inline()) {
+            delete[] reinterpret_cast<Storage*>(m_data);
+        }
+    }
+
+    void
+    reset() {
+        clear();
+        release_storage();
+        m_data = inline_data();
+        m_capacity = N;
+    }
+
+    /** Take over the elements of @a rhs, leaving it empty (this vector
+     * must be empty and inline) */
+    void
+    steal(small_vector& rhs) {
+
+        if(rhs.is_inline()) {
+            for(std::size_t i = 0; i < rhs.m_size; ++i) {
+                ::new(&m_data[i]) T(std::move(rhs.m_data[i]));
+            }
+
+            m_size = rhs.m_size;
+            rhs.clear();
+            return;
+        }
+
+        m_data = rhs.m_data;
+        m_size = rhs.m_size;
+        m_capacity = rhs.m_capacity;
+
+        rhs.m_data = rhs.inline_data();
+        rhs.m_size = 0;
+        rhs.m_capacity = N;
+    }
+
+    Storage m_inline[N];
+    T* m_data;
+    std::size_t m_size;
+    std::size_t m_capacity;
+};
+
+} // namespace detail
+} // namespace hermes
+
+#endif // __HERMES_DETAIL_SMALL_VECTOR_HPP__
@@ -0,0 +1,133 @@
+#ifndef __HERMES_ENGINE_CONFIG_HPP__
+#define __HERMES_ENGINE_CONFIG_HPP__
+
+// C++ includes
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+namespace hermes {
+
+/**
+ * How progress threads (and any other code driving Mercury progress on
+ * behalf of the engine) wait for network events:
+ *   - blocking: block in HG_Progress() until an event arrives or
+ *     @c block_timeout expires. Cheapest in terms of CPU usage.
+ *   - spin_then_block: keep polling HG_Progress() without blocking for
+ *     @c spin_window after the last observed event and then fall back to
+ *     blocking. Trades some CPU for lower latency on bursty workloads.
+ *   - busy_poll: never block. The lowest latency at the expense of
+ *     permanently burning one core per progress thread. Mercury's NA layer
+ *     is configured in non-blocking mode.
+ */
+enum class progress_mode {
+    blocking,
+    spin_then_block,
+    busy_poll
+};
+
+/**
+ * Tunable parameters of an @c async_engine that do not fit in the
+ * @c engine_options bitmask. A default-constructed @c engine_config
+ * reproduces the classic behavior of the engine (i.e. one Mercury context
+ * driven by one progress thread).
+ */
+struct engine_config {
+
+    /** Parameters that control how Mercury progress is driven */
+    struct progress_config {
+
+        /** Number of Mercury contexts created by the engine (each one with
+         * HG_Context_create_id()) and driven by its own progress thread.
+         * Outgoing RPCs are spread across them in a round-robin fashion and,
+         * if the engine is listening, incoming RPCs are delivered to the
+         * context selected by the client (see @c target_contexts). At
+         * most 255 */
+        std::size_t contexts = 1;
+
+        /** Number of contexts that remote engines are listening on. Outgoing
+         * RPCs are spread across them using HG_Set_target_id() so that a
+         * sharded server can process them from all of its progress
+         * threads. At most 255 */
+        std::size_t target_contexts = 1;
+
+        /** Policy used to wait for network events */
+        progress_mode mode = progress_mode::blocking;
+
+        /** Maximum number of completion callbacks run by each call to
+         * HG_Trigger() */
+        unsigned int trigger_batch = 1;
+
+        /** How long to keep polling after the last event before blocking
+         * (only used with progress_mode::spin_then_block) */
+        std::chrono::microseconds spin_window{50};
+
+        /** Maximum time to block in HG_Progress() before checking whether
+         * the engine is shutting down (in milliseconds) */
+        unsigned int block_timeout = 100;
+    };
+
+    /** Parameters for the engine's built-in handler thread pool, used by
+     * request types registered with @c dispatch_policy::handler_pool */
+    struct handler_config {
+
+        /** Number of worker threads in the pool. If 0, the number of
+         * hardware threads is used. The pool is only created if some
+         * request type needs it */
+        std::size_t threads = 0;
+    };
+
+    /** Parameters for the cache of resolved addresses */
+    struct address_cache_config {
+
+        /** Maximum number of cached addresses (0 for unbounded). When full,
+         * the least recently used address is evicted and freed as soon as
+         * no endpoint refers to it */
+        std::size_t capacity = 0;
+
+        /** Number of independently locked partitions of the cache */
+        std::size_t shards = 16;
+
+        /** How long a failed lookup is remembered. While it is, looking up
+         * the same address fails immediately (0 disables this) */
+        std::chrono::milliseconds negative_ttl{0};
+
+        /** If not empty, path of a file where the engine stores the
+         * resolved addresses (in Mercury's serialized form) when it is
+         * destroyed, and from which it reloads them when it is created, so
+         * that restarted clients don't need to look up their peers again.
+         * Requires a transport that supports HG_Addr_serialize() */
+        std::string persist_path;
+    };
+
+    /** Parameters for outgoing RPCs */
+    struct client_config {
+
+        /** Maximum number of idle Mercury handles kept for reuse by later
+         * RPCs with the same type and destination (0 disables reuse and
+         * creates a new handle for each RPC) */
+        std::size_t cached_handles = 1024;
+    };
+
+    /** Parameters for collective operations (e.g. async_engine::barrier()) */
+    struct collective_config {
+
+        /** Messages with larger payloads are not sent inline: the receiver
+         * pulls them through a bulk transfer instead */
+        std::size_t eager_limit = 64 * 1024;
+
+        /** Maximum time a member waits for the other members of the group
+         * during a collective operation */
+        std::chrono::milliseconds timeout{100000};
+    };
+
+    progress_config progress;
+    handler_config handlers;
+    address_cache_config address_cache;
+    client_config client;
+    collective_config collectives;
+};
+
+} // namespace hermes
+
+#endif // __HERMES_ENGINE_CONFIG_HPP__
@@ -5,14 +5,23 @@
 #include <mercury.h>
 
 // C++ includes
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <stdexcept>
 #include <type_traits>
 #include <vector>
 #include <memory>
-#include <future>
 #include <cstdint>
 #include <numeric>
+#include <string>
+#include <utility>
 
 // project includes
+#include <hermes/reduce.hpp>
+#include <hermes/result.hpp>
+#include <hermes/detail/request_status.hpp>
+#include <hermes/detail/small_vector.hpp>
 #if __cplusplus == 201103L
 #include <hermes/make_unique.hpp>
 #endif // __cplusplus == 201103L
@@ -24,13 +33,31 @@ namespace hermes {
 template <typename Request>
 class rpc_handle;
 
+template <typename Request>
+class single_rpc_handle;
+
+template <typename Request>
+class tree_rpc_handle;
+
+template <typename Request>
+class multi_rpc_handle;
+
 // defined elsewhere
 class async_engine;
 
 namespace detail {
 
 struct address;
+class completion_signal;
 template <typename Request> struct execution_context;
+template <typename Request> struct shared_input;
+template <typename Request> struct single_context;
+template <typename Request> class batch_state;
+template <typename Request> class tree_state;
+
+template <typename ExecutionContext>
+bool
+cancel_mercury_rpc(ExecutionContext* ctx);
 
 } // namespace detail
 
@@ -39,48 +66,47 @@ class rpc_handle {
 
     friend class async_engine;
 
-//    template <
-//        typename ExecutionContext, 
-//        typename MercuryInput, 
-//        typename MercuryOutput,
-//        typename Output>
-//    friend void
-//    detail::forward(ExecutionContext* ctx,
-//                    MercuryInput&& input);
-
     using Input = typename Request::input_type;
     using Output = typename Request::output_type;
-
-    // XXX: maybe not needed
     using ExecutionContext = detail::execution_context<Request>;
 
     // XXX: we use SFINAE to make sure that the type of the input 
     // is Request::input_type
+    // (select_slot() is invoked once per target so that the engine can spread
+    // the RPCs among its Mercury contexts)
     template <typename InputData,
-              typename Enable = typename 
-                  std::is_same<InputData, 
-                               typename Request::input_type>::type>
-    rpc_handle(const hg_context_t * const hg_context,
-               const std::vector<std::shared_ptr<detail::address>>& targets,
+              typename SlotSelector,
+              typename Enable = typename std::enable_if<
+                  std::is_same<typename std::decay<InputData>::type, 
+                               typename Request::input_type>::value>::type>
+    rpc_handle(SlotSelector&& select_slot,
+               const std::shared_ptr<detail::address>& target,
                InputData&& input) {
 
+        HERMES_DEBUG2("Creating execution_context for RPC");
+
+        m_ctxs.emplace_back(new ExecutionContext(
+                    select_slot(), target, std::forward<InputData>(input)));
+    }
+
+    // all targets share the same immutable input, so that it is neither
+    // copied nor encoded once per target (see detail::shared_input)
+    template <typename SlotSelector>
+    rpc_handle(SlotSelector&& select_slot,
+               const std::vector<std::shared_ptr<detail::address>>& targets,
+               const std::shared_ptr<const detail::shared_input<Request>>& 
+                   input) :
+        m_signal(std::make_shared<detail::completion_signal>()) {
+
         m_ctxs.reserve(targets.size());
-        m_futures.reserve(targets.size());
 
         for(auto&& addr : targets) {
             HERMES_DEBUG2("Creating execution_context for RPC");
 
-            m_ctxs.emplace_back(
-                compat::make_unique<ExecutionContext>(
-                    this, 
-                    hg_context, 
-                    addr, 
-                    std::forward<InputData>(input)));
-
-            HERMES_DEBUG2("Creating future for RPC");
-
-            m_futures.emplace_back(
-                    m_ctxs.back()->m_output_promise.get_future());
+            m_ctxs.emplace_back(new ExecutionContext(select_slot(), 
+                                                     addr, 
+                                                     input,
+                                                     m_signal));
         }
     }
 
@@ -93,11 +119,22 @@ public:
     ~rpc_handle() {
         HERMES_DEBUG2("{}()", __func__);
 
+        // the outputs are no longer needed, but the RPCs must still have 
+        // completed (e.g. so that any memory they expose can be released)
         if(Request::requires_response) {
-            (void) get();
+            for(auto&& ctx : m_ctxs) {
+                if(!ctx->m_output.retrieved()) {
+                    await(*ctx);
+                }
+            }
         }
     }
 
+    /**
+     * Wait for all RPCs to complete and return their outputs, or rethrow 
+     * the first error found. RPCs that don't complete within 100 seconds 
+     * are cancelled. Outputs that were already retrieved are skipped.
+     */
     std::vector<Output>
     get() const {
 
@@ -106,94 +143,607 @@ public:
                                      "response");
         }
 
-        assert(m_futures.size() == m_ctxs.size());
+        HERMES_DEBUG("Getting RPC results (pending: {})", m_ctxs.size());
 
-        HERMES_DEBUG("Getting RPC results (pending: {})", m_futures.size());
+        std::vector<Output> result_set;
+        result_set.reserve(m_ctxs.size());
 
-        constexpr const auto TIMEOUT = std::chrono::seconds(100);
-        constexpr const auto RETRIES = 0;
+        for(auto&& ctx : m_ctxs) {
 
-        std::vector<Output> result_set;
-        std::vector<bool> retrieved(m_futures.size(), false);
-        std::vector<std::uint8_t> retries(m_futures.size(), RETRIES);
+            if(ctx->m_output.retrieved()) {
+                continue;
+            }
 
-        std::size_t pending_requests = 
-            std::accumulate(m_futures.begin(),
-                            m_futures.end(),
-                            0,
-                            [](std::size_t prev, 
-                               const std::future<Output>& fut) -> std::size_t {
-                                return prev + (fut.valid() ? 1 : 0);
-                            });
+            await(*ctx);
 
-        while(pending_requests > 0) {
+            // the request "completed", i.e. we can retrieve either a valid 
+            // result or an error condition
+            HERMES_DEBUG2("RPC completed. Retrieving result.");
+            result_set.emplace_back(ctx->m_output.take_output());
+        }
 
-            for(std::size_t i = 0; i < m_futures.size(); ++i) {
+        return result_set;
+    }
 
-                if(retrieved[i]) {
-                    continue;
+    /**
+     * Wait for the RPC sent to the target at @a index to complete and 
+     * return its output, or rethrow the error that prevented it. Unlike 
+     * get(), this doesn't allocate a vector of outputs, which makes it the
+     * cheapest way of waiting for an RPC with a single target. Each output
+     * can only be retrieved once.
+     */
+    Output
+    get(std::size_t index) const {
+
+        if(!Request::requires_response) {
+            throw std::runtime_error("This request type does not expect a "
+                                     "response");
+        }
+
+        if(index >= m_ctxs.size()) {
+            throw std::out_of_range("Invalid RPC index " + 
+                                    std::to_string(index));
+        }
+
+        auto& ctx = *m_ctxs[index];
+
+        if(ctx.m_output.retrieved()) {
+            throw std::logic_error("RPC output already retrieved");
+        }
+
+        await(ctx);
+        return ctx.m_output.take_output();
+    }
+
+    /**
+     * Return as soon as @a k RPCs have produced an output (e.g. to collect 
+     * the acknowledgements of a quorum of replicas), without waiting for 
+     * the rest. The outputs are returned in completion order, and the 
+     * remaining RPCs are released in the background: their outputs are 
+     * discarded when they arrive. Throws if @a k outputs can't be collected
+     * before @a deadline, or at all because too many RPCs failed, in which 
+     * case the remaining RPCs are also released. Either way, the handle 
+     * holds no RPCs afterwards.
+     */
+    template <typename Clock, typename Duration>
+    std::vector<Output>
+    get_quorum(std::size_t k, 
+               const std::chrono::time_point<Clock, Duration>& deadline) {
+
+        if(!Request::requires_response) {
+            throw std::runtime_error("This request type does not expect a "
+                                     "response");
+        }
+
+        if(k == 0 || k > m_ctxs.size()) {
+            throw std::invalid_argument("Invalid quorum size " + 
+                    std::to_string(k) + " for " + 
+                    std::to_string(m_ctxs.size()) + " RPCs");
+        }
+
+        HERMES_DEBUG("Getting RPC quorum ({} of {})", k, m_ctxs.size());
+
+        const std::size_t n = m_ctxs.size();
+        std::vector<Output> result_set;
+        std::size_t failed = 0;
+
+        result_set.reserve(k);
+
+        const bool in_time = for_each_completion(deadline, 
+            [&](ExecutionContext& ctx) {
+                try {
+                    result_set.emplace_back(ctx.m_output.take_output());
+                }
+                catch(const std::exception& ex) {
+                    HERMES_DEBUG2("RPC failed: {}", ex.what());
+                    ++failed;
                 }
 
-                switch(m_futures[i].wait_for(TIMEOUT)) {
-                    case std::future_status::timeout: 
-                    {
-
-                        m_ctxs[i]->m_status = 
-                                (retries[i]-- != 0 ?
-                                    detail::request_status::timeout :
-                                    detail::request_status::cancelled);
-
-                        HERMES_DEBUG2("Mercury request timed out, {}",
-                                      m_ctxs[i]->m_status == 
-                                          detail::request_status::timeout ?
-                                          fmt::format(
-                                              "reposting request ({} of {})", 
-                                              RETRIES - retries[i], RETRIES) :
-                                          "cancelling");
-
-                        // cancel the pending Mercury request, this causes
-                        // its completion callback to be invoked and we can
-                        // use it to either repost the request or make it 
-                        // gracefully dispose of itself depending on the value
-                        // of request_status
-                        hg_return_t ret = HG_Cancel(m_ctxs[i]->m_handle);
-
-                        if(ret != HG_SUCCESS) {
-                            HERMES_WARNING("Failed to cancel RPC: {}", 
-                                           HG_Error_to_string(ret));
-                        }
-                        break;
-                    }
+                return result_set.size() < k && n - failed >= k;
+            });
+
+        release_rpcs();
+
+        if(result_set.size() == k) {
+            return result_set;
+        }
+
+        if(n - failed < k) {
+            throw std::runtime_error("Quorum of " + std::to_string(k) + 
+                    " can't be reached: " + std::to_string(failed) + 
+                    " RPCs failed");
+        }
+
+        assert(!in_time);
+        (void) in_time;
+
+        throw std::runtime_error("Quorum of " + std::to_string(k) + 
+                " not reached before deadline (" + 
+                std::to_string(result_set.size()) + " outputs)");
+    }
+
+    /**
+     * Reduce the outputs of all RPCs element-wise with @a op (see 
+     * hermes::reduce_into()) as they arrive, so that the reduction overlaps
+     * with the RPCs still in flight rather than starting once all outputs 
+     * are available. @a values maps an output to the contiguous array of 
+     * arithmetic values to reduce (e.g. a std::vector<std::uint64_t> of 
+     * counters), which must have the same size for all outputs. Throws if 
+     * any RPC fails, if the arrays don't match or if the outputs don't 
+     * arrive before @a deadline. Either way, the handle holds no RPCs 
+     * afterwards.
+     */
+    template <typename Accessor, typename Clock, typename Duration,
+              typename Values = typename std::decay<
+                  decltype(std::declval<Accessor&>()(
+                      std::declval<const Output&>()))>::type>
+    std::vector<typename Values::value_type>
+    reduce(reduce_op op, 
+           Accessor&& values,
+           const std::chrono::time_point<Clock, Duration>& deadline) {
+
+        using T = typename Values::value_type;
+
+        if(!Request::requires_response) {
+            throw std::runtime_error("This request type does not expect a "
+                                     "response");
+        }
+
+        HERMES_DEBUG("Reducing RPC outputs (pending: {})", m_ctxs.size());
 
-                    case std::future_status::ready:
-                    {
-                        // the request "completed", i.e. we can retrieve either
-                        // a valid result or an error condition
-                        HERMES_DEBUG2("RPC completed. Retrieving result.");
-                        result_set.emplace_back(m_futures[i].get());
-                        retrieved[i] = true;
-                        --pending_requests;
-                        break;
+        std::vector<T> acc;
+        bool first = true;
+        bool in_time = false;
+
+        try {
+            in_time = for_each_completion(deadline, 
+                [&](ExecutionContext& ctx) {
+
+                    const Output out = ctx.m_output.take_output();
+                    const auto& v = values(out);
+
+                    if(first) {
+                        acc.assign(std::begin(v), std::end(v));
+                        first = false;
+                        return true;
                     }
 
-                    default:
-                    {
-                        HERMES_DEBUG2("RPC future is in an inconsistent state. "
-                                      "Aborting.");
-                        throw std::runtime_error("Unexpected future_status in "
-                                                 "wait_for()");
+                    if(v.size() != acc.size()) {
+                        throw std::runtime_error("Outputs to reduce have "
+                                                 "different sizes");
                     }
+
+                    reduce_into(op, acc.data(), v.data(), acc.size());
+                    return true;
+                });
+        }
+        catch(...) {
+            release_rpcs();
+            throw;
+        }
+
+        release_rpcs();
+
+        if(!in_time) {
+            throw std::runtime_error("RPC outputs to reduce did not arrive "
+                                     "before deadline");
+        }
+
+        return acc;
+    }
+
+private:
+    // the handle shares its contexts with the in-flight RPCs
+    struct context_deleter {
+        void
+        operator()(ExecutionContext* ctx) const {
+            ctx->release();
+        }
+    };
+
+    using context_ptr = std::unique_ptr<ExecutionContext, context_deleter>;
+
+    /** Wait for the RPC in @a ctx to complete, cancelling it if it takes 
+     * longer than detail::rpc_timeout() */
+    static void
+    await(ExecutionContext& ctx) {
+
+        if(ctx.m_output.wait_until(std::chrono::steady_clock::now() + 
+                                   detail::rpc_timeout())) {
+            return;
+        }
+
+        HERMES_DEBUG2("Mercury request timed out, cancelling");
+
+        // cancel the pending Mercury request (unless it completed in the 
+        // meantime), which causes its completion callback to report the 
+        // timeout
+        (void) detail::cancel_mercury_rpc(&ctx);
+
+        ctx.m_output.wait();
+    }
+
+    /**
+     * Hand the context of each RPC over to @a on_completion as soon as it 
+     * completes (rather than in order), until @a on_completion returns 
+     * false or all RPCs have completed. Returns false if @a deadline 
+     * expired first.
+     */
+    template <typename Clock, typename Duration, typename Callable>
+    bool
+    for_each_completion(
+            const std::chrono::time_point<Clock, Duration>& deadline,
+            Callable&& on_completion) {
+
+        std::size_t pending = 0;
+
+        for(auto&& ctx : m_ctxs) {
+            pending += ctx->m_output.retrieved() ? 0 : 1;
+        }
+
+        while(pending > 0) {
+
+            // read the counter before checking the contexts so that we 
+            // don't miss any completions that happen in between
+            const std::size_t seen = m_signal ? m_signal->completed() : 0;
+            std::size_t next = m_ctxs.size();
+
+            for(std::size_t i = 0; i < m_ctxs.size(); ++i) {
+
+                auto& ctx = *m_ctxs[i];
+
+                if(ctx.m_output.retrieved()) {
+                    continue;
                 }
 
+                if(!ctx.m_output.completed()) {
+                    next = std::min(next, i);
+                    continue;
+                }
+
+                --pending;
+
+                if(!on_completion(ctx)) {
+                    return true;
+                }
+            }
+
+            if(pending == 0) {
+                break;
+            }
+
+            // only single-target handles lack a signal
+            const bool completed = m_signal ? 
+                m_signal->wait_until(seen, deadline) :
+                m_ctxs[next]->m_output.wait_until(deadline);
+
+            if(!completed) {
+                return false;
             }
         }
 
-        return result_set;
+        return true;
+    }
+
+    /** Let go of all RPCs without waiting for those still in flight, which
+     * release their contexts by themselves when they complete */
+    void
+    release_rpcs() {
+        m_ctxs.clear();
+    }
+
+    // a handle usually refers to a single RPC, whose context is kept 
+    // inline so that post() doesn't need any allocations
+    detail::small_vector<context_ptr, 1> m_ctxs;
+    std::shared_ptr<detail::completion_signal> m_signal;
+};
+
+/**
+ * Handle for an RPC sent to a single target (see async_engine::post_one()).
+ * It refers to one execution context directly, and get() returns the 
+ * RPC's output rather than a set of outputs. The handle may be destroyed 
+ * before the RPC completes, in which case the output is discarded.
+ */
+template <typename Request>
+class single_rpc_handle {
+
+    friend class async_engine;
+
+    using Output = typename Request::output_type;
+    using Context = detail::single_context<Request>;
+
+    explicit single_rpc_handle(Context* ctx) :
+        m_ctx(ctx) { }
+
+public:
+    single_rpc_handle(const single_rpc_handle&) = delete;
+    single_rpc_handle& operator=(const single_rpc_handle&) = delete;
+
+    single_rpc_handle(single_rpc_handle&& rhs) noexcept :
+        m_ctx(rhs.m_ctx) {
+        rhs.m_ctx = nullptr;
+    }
+
+    single_rpc_handle& 
+    operator=(single_rpc_handle&& rhs) noexcept {
+
+        if(this != &rhs) {
+            if(m_ctx) {
+                m_ctx->release();
+            }
+
+            m_ctx = rhs.m_ctx;
+            rhs.m_ctx = nullptr;
+        }
+
+        return *this;
+    }
+
+    ~single_rpc_handle() {
+        if(m_ctx) {
+            m_ctx->release();
+        }
+    }
+
+    /** Whether the RPC has completed (i.e. get() won't block) */
+    bool
+    ready() const {
+        return m_ctx && m_ctx->m_output.completed();
+    }
+
+    /**
+     * Wait for the RPC to complete and return its output, or rethrow the 
+     * error that prevented it. As with rpc_handle::get(), the RPC is 
+     * cancelled if it doesn't complete within 100 seconds. The output can 
+     * only be retrieved once.
+     */
+    Output
+    get() {
+
+        if(!Request::requires_response) {
+            throw std::runtime_error("This request type does not expect a "
+                                     "response");
+        }
+
+        if(!m_ctx) {
+            throw std::logic_error("Invalid RPC handle");
+        }
+
+        const auto deadline = 
+            std::chrono::steady_clock::now() + detail::rpc_timeout();
+
+        if(!m_ctx->m_output.wait_until(deadline)) {
+
+            HERMES_DEBUG2("Mercury request timed out, cancelling");
+
+            // the completion callback will report the timeout, unless it 
+            // won the race and is delivering the output right now
+            (void) detail::cancel_mercury_rpc(m_ctx);
+
+            m_ctx->m_output.wait();
+        }
+
+        return m_ctx->m_output.take_output();
+    }
+
+private:
+    Context* m_ctx;
+};
+
+/**
+ * Handle for a batch of RPCs sent by async_engine::post_many(), each one 
+ * to its own target and with its own input. Outputs can be retrieved by 
+ * index (in the order the RPCs were given) or in completion order, and 
+ * each one can only be retrieved once. Like single_rpc_handle, the handle 
+ * may be destroyed before its RPCs complete, in which case their outputs 
+ * are discarded.
+ */
+template <typename Request>
+class multi_rpc_handle {
+
+    friend class async_engine;
+
+    using Output = typename Request::output_type;
+    using Batch = detail::batch_state<Request>;
+
+    explicit multi_rpc_handle(Batch* batch) :
+        m_batch(batch),
+        m_retrieved(0) { }
+
+public:
+    multi_rpc_handle(const multi_rpc_handle&) = delete;
+    multi_rpc_handle& operator=(const multi_rpc_handle&) = delete;
+
+    multi_rpc_handle(multi_rpc_handle&& rhs) noexcept :
+        m_batch(rhs.m_batch),
+        m_retrieved(rhs.m_retrieved) {
+        rhs.m_batch = nullptr;
+    }
+
+    multi_rpc_handle& 
+    operator=(multi_rpc_handle&& rhs) noexcept {
+
+        if(this != &rhs) {
+            if(m_batch) {
+                m_batch->release();
+            }
+
+            m_batch = rhs.m_batch;
+            m_retrieved = rhs.m_retrieved;
+            rhs.m_batch = nullptr;
+        }
+
+        return *this;
+    }
+
+    ~multi_rpc_handle() {
+        if(m_batch) {
+            m_batch->release();
+        }
+    }
+
+    /** Number of RPCs in the batch */
+    std::size_t
+    size() const {
+        return m_batch ? m_batch->size() : 0;
+    }
+
+    /** Whether the RPC at @a index has completed (i.e. get() won't block) */
+    bool
+    ready(std::size_t index) const {
+        return m_batch && m_batch->completed(checked(index));
+    }
+
+    /**
+     * Wait for the RPC at @a index to complete and return its output, or 
+     * rethrow the error that prevented it. As with rpc_handle::get(), the 
+     * RPC is cancelled if it doesn't complete within 100 seconds.
+     */
+    Output
+    get(std::size_t index) {
+
+        if(!Request::requires_response) {
+            throw std::runtime_error("This request type does not expect a "
+                                     "response");
+        }
+
+        checked(index);
+
+        if(!m_batch->wait_until(index, std::chrono::steady_clock::now() + 
+                                       detail::rpc_timeout())) {
+
+            HERMES_DEBUG2("Mercury request timed out, cancelling");
+
+            // the completion callback will report the timeout, unless it 
+            // won the race and is delivering the output right now
+            (void) detail::cancel_mercury_rpc(&m_batch->context(index));
+
+            m_batch->wait(index);
+        }
+
+        result<Output> rv = m_batch->take(index);
+        ++m_retrieved;
+
+        return std::move(rv).value();
+    }
+
+    /**
+     * Wait for the next RPC to complete (in completion order) among those 
+     * whose outputs haven't been retrieved yet, and return its index along
+     * with its output or the error that prevented it. Throws if all outputs
+     * have been retrieved or if no RPC completes within 100 seconds.
+     */
+    std::pair<std::size_t, result<Output>>
+    next() {
+
+        if(!Request::requires_response) {
+            throw std::runtime_error("This request type does not expect a "
+                                     "response");
+        }
+
+        if(m_retrieved == size()) {
+            throw std::logic_error("All RPC outputs already retrieved");
+        }
+
+        std::size_t index = 0;
+        result<Output> rv{std::exception_ptr()};
+
+        if(!m_batch->take_next(index, rv, std::chrono::steady_clock::now() + 
+                                          detail::rpc_timeout())) {
+            throw std::runtime_error("Timed out waiting for RPC outputs");
+        }
+
+        ++m_retrieved;
+
+        return std::make_pair(index, std::move(rv));
+    }
+
+private:
+    std::size_t
+    checked(std::size_t index) const {
+
+        if(index >= size()) {
+            throw std::out_of_range("Invalid RPC index " + 
+                                    std::to_string(index));
+        }
+
+        return index;
+    }
+
+    Batch* m_batch;
+    std::size_t m_retrieved;
+};
+
+/**
+ * Handle for an RPC sent to several targets through a tree of relays (see
+ * async_engine::tree_broadcast()). Unlike rpc_handle, destroying it doesn't
+ * wait for the RPCs to complete.
+ */
+template <typename Request>
+class tree_rpc_handle {
+
+    friend class async_engine;
+
+    using Output = typename Request::output_type;
+    using State = detail::tree_state<Request>;
+
+    explicit tree_rpc_handle(std::shared_ptr<State> state) :
+        m_state(std::move(state)) { }
+
+public:
+    tree_rpc_handle(const tree_rpc_handle&) = delete;
+    tree_rpc_handle(tree_rpc_handle&&) = default;
+    tree_rpc_handle& operator=(const tree_rpc_handle&) = delete;
+    tree_rpc_handle& operator=(tree_rpc_handle&&) = default;
+
+    /** Whether all targets have completed (i.e. get() won't block) */
+    bool
+    ready() const {
+        return m_state && m_state->completed();
+    }
+
+    /**
+     * Wait for all targets to complete and return the result for each of
+     * them, in the same order as the targets were given. Results can only
+     * be retrieved once.
+     */
+    std::vector<result<Output>>
+    results() {
+
+        if(!m_state) {
+            throw std::logic_error("Invalid RPC handle");
+        }
+
+        if(!m_state->wait_until(std::chrono::steady_clock::now() + 
+                                detail::rpc_timeout())) {
+            throw std::runtime_error("Request timed out");
+        }
+
+        const auto state = std::move(m_state);
+        return std::move(state->results());
+    }
+
+    /**
+     * Wait for all targets to complete and return their outputs, in the 
+     * same order as the targets were given, or rethrow the first error
+     */
+    std::vector<Output>
+    get() {
+
+        auto rs = results();
+
+        std::vector<Output> outputs;
+        outputs.reserve(rs.size());
+
+        for(auto&& rv : rs) {
+            outputs.emplace_back(std::move(rv).value());
+        }
+
+        return outputs;
     }
 
 private:
-    std::vector<std::unique_ptr<ExecutionContext>> m_ctxs;
-    mutable std::vector<std::future<Output>> m_futures;
+    std::shared_ptr<State> m_state;
 };
 
 } // namespace hermes
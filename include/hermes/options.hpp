@@ -9,6 +9,7 @@ enum __engine_opts {
     __print_stats      = 1L << 1,
     __force_no_block_progress = 1L << 2,
     __process_may_fork = 1L << 3,
+    __external_progress = 1L << 4,
     __engine_opts_end = 1L << 16,
     __engine_opts_max = __INT_MAX__,
     __engine_opts_min = ~__INT_MAX__
@@ -56,6 +57,25 @@ static const constexpr engine_options use_auto_sm = __engine_opts::__use_auto_sm
 static const constexpr engine_options force_no_block_progress = __engine_opts::__force_no_block_progress;
 static const constexpr engine_options print_stats = __engine_opts::__print_stats;
 static const constexpr engine_options process_may_fork = __engine_opts::__process_may_fork;
+// the engine never starts progress threads: the application is responsible
+// for driving progress with async_engine::progress_once() and 
+// async_engine::trigger_ready() (e.g. when async_engine::wait_fd() becomes
+// readable in its own event loop)
+static const constexpr engine_options external_progress = __engine_opts::__external_progress;
+
+/**
+ * Where the user handler for a request type is executed:
+ *   - progress_thread: inline, in the progress thread that received the
+ *     request (this is the default).
+ *   - handler_pool: in the engine's built-in work-stealing thread pool. The
+ *     progress thread only decodes the request and enqueues it, which keeps
+ *     slow handlers from stalling other RPCs and bulk transfers.
+ */
+enum class dispatch_policy {
+    progress_thread,
+    handler_pool
+};
+
 } // namespace hermes
 
 #endif // __HERMES_OPTION_HPP__
@@ -0,0 +1,104 @@
+#ifndef __HERMES_REDUCE_HPP__
+#define __HERMES_REDUCE_HPP__
+
+// C++ includes
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+
+// project includes
+#include <hermes/detail/simd_reduce.hpp>
+
+namespace hermes {
+
+/** Element-wise operations supported by reduce_into() */
+enum class reduce_op {
+    sum,
+    min,
+    max,
+    bit_and,    // integral types only
+    bit_or,     // integral types only
+    bit_xor     // integral types only
+};
+
+namespace detail {
+
+// integral sums are computed on the corresponding unsigned type, whose 
+// overflow is well-defined, so that sums of signed values wrap around 
+// rather than being undefined behavior (accessing an integer through its
+// unsigned counterpart is allowed by the aliasing rules)
+template <typename T>
+inline void
+reduce_sum(T* acc, const T* src, std::size_t n,
+           std::true_type /* is_integral */) {
+
+    using U = typename std::make_unsigned<T>::type;
+
+    simd_reduce<U, op_sum>(reinterpret_cast<U*>(acc), 
+                           reinterpret_cast<const U*>(src), n);
+}
+
+template <typename T>
+inline void
+reduce_sum(T* acc, const T* src, std::size_t n,
+           std::false_type /* is_integral */) {
+    simd_reduce<T, op_sum>(acc, src, n);
+}
+
+template <typename T>
+inline void
+reduce_bitwise(reduce_op op, T* acc, const T* src, std::size_t n,
+               std::true_type /* is_integral */) {
+    switch(op) {
+        case reduce_op::bit_and:
+            return simd_reduce<T, op_and>(acc, src, n);
+        case reduce_op::bit_or:
+            return simd_reduce<T, op_or>(acc, src, n);
+        case reduce_op::bit_xor:
+            return simd_reduce<T, op_xor>(acc, src, n);
+        default:
+            throw std::invalid_argument("Invalid reduction");
+    }
+}
+
+template <typename T>
+inline void
+reduce_bitwise(reduce_op, T*, const T*, std::size_t,
+               std::false_type /* is_integral */) {
+    throw std::invalid_argument("Bitwise reductions require integral types");
+}
+
+} // namespace detail
+
+/**
+ * Combine the @a n elements of @a src into @a acc element-wise with @a op
+ * (i.e. acc[i] = op(acc[i], src[i])). The work is done by SIMD kernels for
+ * the widest instruction set that the CPU supports (SSE2, AVX2 or
+ * AVX-512F), which is detected at runtime. Integral sums wrap around on
+ * overflow (modulo 2^N) for both unsigned and signed types, since they are
+ * computed on the corresponding unsigned type.
+ */
+template <typename T>
+inline void
+reduce_into(reduce_op op, T* acc, const T* src, std::size_t n) {
+
+    static_assert(std::is_arithmetic<T>::value &&
+                  !std::is_same<T, bool>::value,
+                  "reductions require arithmetic types");
+
+    switch(op) {
+        case reduce_op::sum:
+            return detail::reduce_sum(acc, src, n, std::is_integral<T>());
+        case reduce_op::min:
+            return detail::simd_reduce<T, detail::op_min>(acc, src, n);
+        case reduce_op::max:
+            return detail::simd_reduce<T, detail::op_max>(acc, src, n);
+        default:
+            return detail::reduce_bitwise(op, acc, src, n,
+                                          std::is_integral<T>());
+    }
+}
+
+} // namespace hermes
+
+#endif // __HERMES_REDUCE_HPP__
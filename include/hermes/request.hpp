@@ -1,7 +1,11 @@
 #ifndef __HERMES_REQUEST_HPP__
 #define __HERMES_REQUEST_HPP__
 
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
 
 // project includes
 #if __cplusplus == 201103L
@@ -9,6 +13,7 @@
 #endif // __cplusplus == 201103L
 
 #include "logging.hpp"
+#include <hermes/detail/object_pool.hpp>
 
 #ifdef HERMES_MARGO_COMPATIBLE_MODE
 #include <hermes/detail/margo_compatibility.hpp>
@@ -32,15 +37,159 @@ mercury_bulk_transfer(hermes::request<Input>&& req,
                       Callable&& completion_callback);
 
 template <typename Request>
-static inline typename Request::mercury_input_type
-decode_mercury_input(hg_handle_t handle);
+static inline void
+decode_mercury_input(hg_handle_t handle,
+                     typename Request::mercury_input_type& hg_input);
 
 // defined elsewhere
 template <typename Input, typename Output>
 inline void
 mercury_respond(request<Input>&& req, Output&& out);
 
-}
+// defined elsewhere
+template <typename Request>
+inline typename Request::routing_key_type
+decode_routing_key(hg_handle_t handle);
+
+template <typename T>
+struct type_sink {
+    using type = void;
+};
+
+// the type returned by request<Request>::args_view(): a reference to the
+// decoded Mercury input, unless the request type declares its own view
+template <typename Request, typename = void>
+struct request_view {
+
+    using type = const typename Request::mercury_input_type&;
+
+    static type
+    make(const typename Request::mercury_input_type& in) {
+        return in;
+    }
+};
+
+template <typename Request>
+struct request_view<Request,
+        typename type_sink<typename Request::view_type>::type> {
+
+    using type = typename Request::view_type;
+
+    static type
+    make(const typename Request::mercury_input_type& in) {
+        return type(in);
+    }
+};
+
+} // namespace detail
+
+namespace detail {
+
+/**
+ * Everything a server needs to keep for an incoming RPC: the Mercury
+ * handle, the decoded Mercury input and the user-facing Input built from
+ * it, all in a single block. Both inputs are built in place on first use,
+ * exactly once even if several threads access them concurrently (e.g. a
+ * handler that shares the request with worker threads). Blocks are 
+ * recycled through a per-request-type free list, so that
+ * serving an RPC doesn't hit the allocator in steady state.
+ */
+template <typename Request>
+struct request_state : public pooled<request_state<Request>> {
+
+    using Input = typename Request::input_type;
+    using MercuryInput = typename Request::mercury_input_type;
+
+    explicit request_state(hg_handle_t handle) :
+        m_handle(handle),
+        m_decoded(false),
+        m_has_input(false),
+        m_mercury_input() { }
+
+    request_state(const request_state& other) = delete;
+    request_state& operator=(const request_state& other) = delete;
+
+    ~request_state() {
+
+        if(m_has_input.load(std::memory_order_relaxed)) {
+            input()->~Input();
+        }
+
+        if(m_handle == HG_HANDLE_NULL) {
+            return;
+        }
+
+        hg_return_t ret = HG_SUCCESS;
+
+        if(m_decoded.load(std::memory_order_relaxed)) {
+#ifdef HERMES_MARGO_COMPATIBLE_MODE
+            ret = margo::free_input(m_handle, Request::mercury_in_proc_cb,
+                                    &m_mercury_input);
+#else
+            ret = HG_Free_input(m_handle, &m_mercury_input);
+#endif // HERMES_MARGO_COMPATIBLE_MODE
+
+            HERMES_DEBUG2("margo::free_input({}, {}) = {}",
+                          fmt::ptr(m_handle), fmt::ptr(&m_mercury_input), 
+                          HG_Error_to_string(ret));
+        }
+
+        ret = HG_Destroy(m_handle);
+
+        HERMES_DEBUG2("HG_Destroy({}) = {}", 
+                      fmt::ptr(m_handle), HG_Error_to_string(ret));
+
+        (void) ret; // avoid warnings if !DEBUG
+    }
+
+    // the flags are only checked under the mutex until they are set, so 
+    // accessing inputs that have already been built costs a single load
+
+    const MercuryInput&
+    mercury_input() {
+
+        if(!m_decoded.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if(!m_decoded.load(std::memory_order_relaxed)) {
+                decode_mercury_input<Request>(m_handle, m_mercury_input);
+                m_decoded.store(true, std::memory_order_release);
+            }
+        }
+
+        return m_mercury_input;
+    }
+
+    const Input&
+    args() {
+
+        if(!m_has_input.load(std::memory_order_acquire)) {
+            const MercuryInput& hg_input = mercury_input();
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if(!m_has_input.load(std::memory_order_relaxed)) {
+                ::new(input()) Input(hg_input);
+                m_has_input.store(true, std::memory_order_release);
+            }
+        }
+
+        return *input();
+    }
+
+    Input*
+    input() {
+        return reinterpret_cast<Input*>(&m_input);
+    }
+
+    const hg_handle_t m_handle;
+    std::mutex m_mutex;
+    std::atomic<bool> m_decoded;
+    std::atomic<bool> m_has_input;
+    MercuryInput m_mercury_input;
+    typename std::aligned_storage<sizeof(Input), alignof(Input)>::type m_input;
+};
+
+} // namespace detail
 
 template <typename Request>
 class request {
@@ -66,22 +215,19 @@ class request {
 // TODO: move this 'public' after ctors
 public:
 
+    // the input is not decoded until it is first accessed, so that
+    // requests can be handed over (e.g. to a thread pool) without paying
+    // for it in the progress thread
     request(hg_handle_t handle) :
-        m_handle(handle),
-        m_mercury_input(compat::make_unique<MercuryInput>(
-                    detail::decode_mercury_input<Request>(m_handle))),
-        m_input(compat::make_unique<Input>(*m_mercury_input)),
+        m_state(new detail::request_state<Request>(handle)),
         m_requires_response(Request::requires_response) { }
 
     request(const request& other) = delete;
 
     request(request&& rhs) :
-        m_handle(std::move(rhs.m_handle)),
-        m_mercury_input(std::move(rhs.m_mercury_input)),
-        m_input(std::move(rhs.m_input)),
+        m_state(std::move(rhs.m_state)),
         m_requires_response(std::move(rhs.m_requires_response)) { 
 
-        rhs.m_handle = HG_HANDLE_NULL;
         rhs.m_requires_response = false;
     }
 
@@ -91,20 +237,61 @@ public:
     operator=(request&& rhs) {
 
         if(this != &rhs) {
-            m_handle = std::move(rhs.m_handle);
-            m_mercury_input = std::move(rhs.m_mercury_input);
-            m_input = std::move(rhs.m_input);
+            m_state = std::move(rhs.m_state);
             m_requires_response = std::move(rhs.m_requires_response);
 
-            rhs.m_handle = HG_HANDLE_NULL;
             rhs.m_requires_response = false;
         }
 
         return *this;
     }
 
-    Input args() const {
-        return *m_input;
+    /**
+     * The request's arguments. They are built from the decoded Mercury
+     * input on first use and kept for the lifetime of the request, so
+     * repeated calls are free. Handlers that only read the arguments
+     * should prefer args_view(), which doesn't copy them at all. It's safe
+     * to call this (and args_view()) from several threads at once.
+     */
+    const Input&
+    args() const {
+        return m_state->args();
+    }
+
+    /**
+     * A zero-copy view of the request's arguments, which is only valid 
+     * while the request is alive. By default this is the decoded Mercury
+     * input itself, whose strings and buffers point into Mercury's own
+     * decoding buffer. Request types may instead declare a 
+     * `view_type` constructible from `const mercury_input_type&` (e.g.
+     * exposing std::string_views), which is returned by value.
+     */
+    typename detail::request_view<Request>::type
+    args_view() const {
+        return detail::request_view<Request>::make(m_state->mercury_input());
+    }
+
+    /**
+     * Decode only the routing key of the request, so that servers that
+     * merely route requests (e.g. gateways or shards) can decide where to
+     * forward them, or reject them, without decoding the whole input.
+     * Request types opt in by declaring:
+     *
+     *  - mercury_routing_key_type: a Mercury struct whose fields are the
+     *    same as the first fields of mercury_input_type, in the same order
+     *    (i.e. a prefix of the encoded input);
+     *  - mercury_routing_key_proc_cb: its Mercury proc callback;
+     *  - routing_key_type: a public type constructible from
+     *    `const mercury_routing_key_type&`.
+     *
+     * The key is read straight from the front of Mercury's input buffer
+     * every time this is called, regardless of whether the full input has 
+     * been decoded.
+     */
+    template <typename R = Request>
+    typename R::routing_key_type
+    routing_key() const {
+        return detail::decode_routing_key<R>(mercury_handle());
     }
 
     bool
@@ -116,50 +303,21 @@ public:
         HERMES_DEBUG2("{}(this={})", __func__, fmt::ptr(this));
 #if 0
         HERMES_DEBUG2("this = {");
-        HERMES_DEBUG2("  m_handle = {},", fmt::ptr(m_handle));
-        HERMES_DEBUG2("  m_mercury_input = {},", 
-                      fmt::ptr(m_mercury_input.get()));
-        HERMES_DEBUG2("  m_input = {},", 
-                      fmt::ptr(m_input.get()));
+        HERMES_DEBUG2("  m_state = {},", fmt::ptr(m_state.get()));
         HERMES_DEBUG2("  m_requires_response = {}", m_requires_response);
         HERMES_DEBUG2("};");
         HERMES_DEBUG_FLUSH();
 #endif
-
-
-        if(m_handle != HG_HANDLE_NULL) {
-
-            hg_return_t ret = HG_SUCCESS;
-
-            if(m_mercury_input) {
-#ifdef HERMES_MARGO_COMPATIBLE_MODE
-                ret = detail::margo::free_input(m_handle, m_mercury_input_cb,
-                                                m_mercury_input.get());
-#else
-                ret = HG_Free_input(m_handle, m_mercury_input.get());
-#endif // HERMES_MARGO_COMPATIBLE_MODE
-
-                HERMES_DEBUG2("margo::free_input({}, {}) = {}",
-                              fmt::ptr(m_handle), fmt::ptr(&m_mercury_input), 
-                              HG_Error_to_string(ret));
-            }
-
-            ret = HG_Destroy(m_handle);
-
-            HERMES_DEBUG2("HG_Destroy({}) = {}", 
-                          fmt::ptr(m_handle), HG_Error_to_string(ret));
-
-            (void) ret; // avoid warnings if !DEBUG
-        }
     }
 
 private:
-    hg_handle_t m_handle;
-    std::unique_ptr<MercuryInput> m_mercury_input;
-    std::unique_ptr<Input> m_input;
+    hg_handle_t
+    mercury_handle() const {
+        return m_state ? m_state->m_handle : HG_HANDLE_NULL;
+    }
+
+    std::unique_ptr<detail::request_state<Request>> m_state;
     bool m_requires_response;
-    constexpr static const auto m_mercury_input_cb =
-            Request::mercury_in_proc_cb;
 };
 
 
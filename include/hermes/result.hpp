@@ -0,0 +1,176 @@
+#ifndef __HERMES_RESULT_HPP__
+#define __HERMES_RESULT_HPP__
+
+// C++ includes
+#include <exception>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace hermes {
+
+/**
+ * The outcome of an operation that may fail independently of other
+ * operations in the same batch: either a value of type T or the exception
+ * that prevented the operation from producing it.
+ */
+template <typename T>
+class result {
+
+public:
+    result(const T& value) :
+        m_has_value(true) {
+        ::new(&m_storage) T(value);
+    }
+
+    result(T&& value) :
+        m_has_value(true) {
+        ::new(&m_storage) T(std::move(value));
+    }
+
+    result(std::exception_ptr error) :
+        m_has_value(false),
+        m_error(error) { }
+
+    result(const result& other) :
+        m_has_value(other.m_has_value),
+        m_error(other.m_error) {
+
+        if(m_has_value) {
+            ::new(&m_storage) T(*other.ptr());
+        }
+    }
+
+    result(result&& rhs) :
+        m_has_value(rhs.m_has_value),
+        m_error(std::move(rhs.m_error)) {
+
+        if(m_has_value) {
+            ::new(&m_storage) T(std::move(*rhs.ptr()));
+        }
+    }
+
+    result&
+    operator=(const result& other) {
+
+        if(this != &other) {
+            result tmp(other);
+            *this = std::move(tmp);
+        }
+
+        return *this;
+    }
+
+    result&
+    operator=(result&& rhs) {
+
+        if(this != &rhs) {
+            reset();
+
+            m_has_value = rhs.m_has_value;
+            m_error = std::move(rhs.m_error);
+
+            if(m_has_value) {
+                ::new(&m_storage) T(std::move(*rhs.ptr()));
+            }
+        }
+
+        return *this;
+    }
+
+    ~result() {
+        reset();
+    }
+
+    bool
+    has_value() const noexcept {
+        return m_has_value;
+    }
+
+    explicit operator bool() const noexcept {
+        return m_has_value;
+    }
+
+    /** Return the value, or rethrow the error if the operation failed */
+    T&
+    value() & {
+        check();
+        return *ptr();
+    }
+
+    const T&
+    value() const & {
+        check();
+        return *ptr();
+    }
+
+    T&&
+    value() && {
+        check();
+        return std::move(*ptr());
+    }
+
+    std::exception_ptr
+    error() const noexcept {
+        return m_error;
+    }
+
+    /** Return a description of the error, or an empty string if the
+     * operation succeeded */
+    std::string
+    error_message() const {
+
+        if(m_has_value || !m_error) {
+            return {};
+        }
+
+        try {
+            std::rethrow_exception(m_error);
+        }
+        catch(const std::exception& ex) {
+            return ex.what();
+        }
+        catch(...) {
+            return "unknown error";
+        }
+    }
+
+private:
+    void
+    check() const {
+        if(!m_has_value) {
+            if(m_error) {
+                std::rethrow_exception(m_error);
+            }
+            throw std::logic_error("result has neither value nor error");
+        }
+    }
+
+    void
+    reset() {
+        if(m_has_value) {
+            ptr()->~T();
+            m_has_value = false;
+        }
+    }
+
+    T*
+    ptr() {
+        return reinterpret_cast<T*>(&m_storage);
+    }
+
+    const T*
+    ptr() const {
+        return reinterpret_cast<const T*>(&m_storage);
+    }
+
+    bool m_has_value;
+    std::exception_ptr m_error;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type m_storage;
+};
+
+} // namespace hermes
+
+#endif // __HERMES_RESULT_HPP__
@@ -0,0 +1,296 @@
+#ifndef __HERMES_THREAD_POOL_HPP__
+#define __HERMES_THREAD_POOL_HPP__
+
+// C++ includes
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// project includes
+#include <hermes/logging.hpp>
+#include <hermes/make_unique.hpp>
+#include <hermes/detail/object_pool.hpp>
+
+namespace hermes {
+
+namespace detail {
+
+/**
+ * A type-erased, move-only callable. Unlike std::function, it can wrap
+ * callables that own move-only state (e.g. a hermes::request)
+ */
+class task {
+
+    struct concept_t {
+        virtual ~concept_t() = default;
+        virtual void run() = 0;
+    };
+
+    // models are recycled per callable type, since tasks are created for
+    // every request served by a pool (see detail::deferred_request)
+    template <typename Callable>
+    struct model_t : public concept_t, public pooled<model_t<Callable>> {
+
+        explicit model_t(Callable&& fn) :
+            m_fn(std::move(fn)) { }
+
+        void
+        run() override {
+            m_fn();
+        }
+
+        Callable m_fn;
+    };
+
+public:
+    task() = default;
+
+    template <typename Callable,
+              typename = typename std::enable_if<
+                  !std::is_same<typename std::decay<Callable>::type,
+                                task>::value>::type>
+    task(Callable&& fn) :
+        m_impl(compat::make_unique<
+                model_t<typename std::decay<Callable>::type>>(
+                    typename std::decay<Callable>::type(
+                        std::forward<Callable>(fn)))) { }
+
+    task(task&& rhs) = default;
+    task& operator=(task&& rhs) = default;
+    task(const task& other) = delete;
+    task& operator=(const task& other) = delete;
+
+    explicit operator bool() const {
+        return static_cast<bool>(m_impl);
+    }
+
+    void
+    operator()() {
+        m_impl->run();
+    }
+
+private:
+    std::unique_ptr<concept_t> m_impl;
+};
+
+} // namespace detail
+
+/**
+ * A fixed-size pool of worker threads with one task queue per worker.
+ * Workers consume tasks from the front of their own queue and, when it is
+ * empty, steal tasks from the back of other workers' queues. Tasks submitted
+ * from outside the pool are distributed among the queues in a round-robin
+ * fashion, whereas tasks submitted by a worker go to its own queue.
+ *
+ * The destructor runs any tasks still queued before joining the workers.
+ */
+class thread_pool {
+
+    struct worker_queue {
+        std::mutex m_mutex;
+        std::deque<detail::task> m_tasks;
+    };
+
+public:
+    explicit thread_pool(std::size_t num_threads) :
+        m_pending(0),
+        m_idle(0),
+        m_next_queue(0),
+        m_shutdown(false) {
+
+        if(num_threads == 0) {
+            throw std::invalid_argument("A thread pool needs at least "
+                                        "one thread");
+        }
+
+        HERMES_DEBUG("Starting thread pool with {} threads", num_threads);
+
+        m_queues.reserve(num_threads);
+
+        for(std::size_t i = 0; i < num_threads; ++i) {
+            m_queues.emplace_back(compat::make_unique<worker_queue>());
+        }
+
+        m_workers.reserve(num_threads);
+
+        for(std::size_t i = 0; i < num_threads; ++i) {
+            m_workers.emplace_back(&thread_pool::worker, this, i);
+        }
+    }
+
+    thread_pool(const thread_pool& other) = delete;
+    thread_pool(thread_pool&& rhs) = delete;
+    thread_pool& operator=(const thread_pool& other) = delete;
+    thread_pool& operator=(thread_pool&& rhs) = delete;
+
+    ~thread_pool() {
+
+        HERMES_DEBUG("Stopping thread pool");
+
+        {
+            std::lock_guard<std::mutex> lock(m_idle_mutex);
+            m_shutdown = true;
+        }
+
+        m_idle_cv.notify_all();
+
+        for(auto&& w : m_workers) {
+            if(w.joinable()) {
+                w.join();
+            }
+        }
+    }
+
+    std::size_t
+    size() const {
+        return m_workers.size();
+    }
+
+    /**
+     * Schedule @a fn for execution in one of the pool's workers. Callable
+     * may be move-only.
+     */
+    template <typename Callable>
+    void
+    submit(Callable&& fn) {
+
+        const std::size_t index =
+            (current_pool() == this) ?
+                current_index() :
+                m_next_queue.fetch_add(1, std::memory_order_relaxed) %
+                    m_queues.size();
+
+        {
+            auto& q = *m_queues[index];
+            std::lock_guard<std::mutex> lock(q.m_mutex);
+            q.m_tasks.emplace_back(std::forward<Callable>(fn));
+        }
+
+        // both operations need to be sequentially consistent so that they
+        // can't be reordered with the m_idle increment/m_pending check done
+        // by a worker about to go to sleep
+        ++m_pending;
+
+        // only pay for a wakeup if somebody is actually sleeping
+        if(m_idle.load() != 0) {
+            std::lock_guard<std::mutex> lock(m_idle_mutex);
+            m_idle_cv.notify_one();
+        }
+    }
+
+private:
+    static thread_pool*&
+    current_pool() {
+        static thread_local thread_pool* pool = nullptr;
+        return pool;
+    }
+
+    static std::size_t&
+    current_index() {
+        static thread_local std::size_t index = 0;
+        return index;
+    }
+
+    bool
+    pop_local(std::size_t index, detail::task& t) {
+
+        auto& q = *m_queues[index];
+        std::lock_guard<std::mutex> lock(q.m_mutex);
+
+        if(q.m_tasks.empty()) {
+            return false;
+        }
+
+        t = std::move(q.m_tasks.front());
+        q.m_tasks.pop_front();
+        return true;
+    }
+
+    bool
+    steal(std::size_t index, detail::task& t) {
+
+        for(std::size_t i = 1; i < m_queues.size(); ++i) {
+
+            auto& q = *m_queues[(index + i) % m_queues.size()];
+            std::unique_lock<std::mutex> lock(q.m_mutex, std::try_to_lock);
+
+            if(!lock.owns_lock() || q.m_tasks.empty()) {
+                continue;
+            }
+
+            t = std::move(q.m_tasks.back());
+            q.m_tasks.pop_back();
+            return true;
+        }
+
+        return false;
+    }
+
+    void
+    worker(std::size_t index) {
+
+        current_pool() = this;
+        current_index() = index;
+
+        detail::task t;
+
+        while(true) {
+
+            if(m_pending.load(std::memory_order_acquire) != 0 &&
+               (pop_local(index, t) || steal(index, t))) {
+
+                m_pending.fetch_sub(1, std::memory_order_relaxed);
+
+                try {
+                    t();
+                }
+                catch(const std::exception& ex) {
+                    HERMES_ERROR("Uncaught exception in thread pool task: {}",
+                                 ex.what());
+                }
+                catch(...) {
+                    HERMES_ERROR("Uncaught exception in thread pool task");
+                }
+
+                t = detail::task{};
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_idle_mutex);
+
+            // queued tasks are always run before exiting
+            if(m_shutdown && m_pending.load() == 0) {
+                break;
+            }
+
+            ++m_idle;
+            m_idle_cv.wait(lock, [this]() {
+                return m_pending.load() != 0 || m_shutdown;
+            });
+            --m_idle;
+        }
+
+        current_pool() = nullptr;
+    }
+
+    std::vector<std::unique_ptr<worker_queue>> m_queues;
+    std::vector<std::thread> m_workers;
+    std::atomic<std::size_t> m_pending;
+    std::atomic<std::size_t> m_idle;
+    std::atomic<std::size_t> m_next_queue;
+    bool m_shutdown;
+    std::mutex m_idle_mutex;
+    std::condition_variable m_idle_cv;
+};
+
+} // namespace hermes
+
+#endif // __HERMES_THREAD_POOL_HPP__
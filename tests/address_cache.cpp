@@ -0,0 +1,158 @@
+// Unit tests for detail::address_cache. Cached addresses don't refer to
+// actual Mercury addresses, so no network is needed.
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <hermes.hpp>
+
+#include "check.hpp"
+
+using hermes::detail::address;
+using hermes::detail::address_cache;
+using hermes::detail::address_key;
+
+namespace {
+
+std::shared_ptr<address>
+make_address() {
+    return std::make_shared<address>();
+}
+
+bool
+cached(address_cache& cache, const std::string& key) {
+    return cache.find(address_key{key, {}}).m_address != nullptr;
+}
+
+// failed lookups are remembered until their TTL expires
+void
+test_negative_ttl() {
+
+    address_cache cache(0, 4, std::chrono::milliseconds(50));
+
+    cache.insert_negative("ofi+tcp://unreachable:1", HG_NOENTRY);
+
+    auto rv = cache.find(address_key{"ofi+tcp://", "unreachable:1"});
+    CHECK(rv.m_address == nullptr);
+    CHECK(rv.m_error == HG_NOENTRY);
+    CHECK(cache.stats().negative_hits == 1);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    rv = cache.find(address_key{"ofi+tcp://", "unreachable:1"});
+    CHECK(rv.m_address == nullptr);
+    CHECK(rv.m_error == HG_SUCCESS);
+    CHECK(cache.stats().entries == 0);
+
+    // a TTL of 0 disables negative caching altogether
+    address_cache disabled(0, 4, std::chrono::milliseconds(0));
+    disabled.insert_negative("ofi+tcp://unreachable:1", HG_NOENTRY);
+    CHECK(disabled.find(address_key{"ofi+tcp://unreachable:1", {}})
+                  .m_error == HG_SUCCESS);
+    CHECK(disabled.stats().entries == 0);
+}
+
+// a negative entry must never hide an address that is already resolved,
+// while resolving an address replaces its negative entry
+void
+test_negative_never_replaces_valid() {
+
+    address_cache cache(0, 4, std::chrono::seconds(60));
+
+    const auto addr = make_address();
+    CHECK(cache.insert("ofi+tcp://host:1", addr) == addr);
+
+    cache.insert_negative("ofi+tcp://host:1", HG_TIMEOUT);
+
+    auto rv = cache.find(address_key{"ofi+tcp://host:1", {}});
+    CHECK(rv.m_address == addr);
+    CHECK(rv.m_error == HG_SUCCESS);
+
+    cache.insert_negative("ofi+tcp://host:2", HG_TIMEOUT);
+    CHECK(cache.find(address_key{"ofi+tcp://host:2", {}}).m_error ==
+          HG_TIMEOUT);
+
+    const auto addr2 = make_address();
+    CHECK(cache.insert("ofi+tcp://host:2", addr2) == addr2);
+
+    rv = cache.find(address_key{"ofi+tcp://host:2", {}});
+    CHECK(rv.m_address == addr2);
+    CHECK(rv.m_error == HG_SUCCESS);
+
+    // inserting an address that is already cached keeps the cached one
+    CHECK(cache.insert("ofi+tcp://host:2", make_address()) == addr2);
+    CHECK(cache.stats().entries == 2);
+}
+
+// with a single shard, the least recently used entry is the one evicted
+void
+test_lru_eviction() {
+
+    address_cache cache(3, 1, std::chrono::milliseconds(0));
+
+    cache.insert("a", make_address());
+    cache.insert("b", make_address());
+    cache.insert("c", make_address());
+
+    // "a" becomes the most recently used, so "b" is evicted next
+    CHECK(cached(cache, "a"));
+
+    cache.insert("d", make_address());
+
+    CHECK(cached(cache, "a"));
+    CHECK(!cached(cache, "b"));
+    CHECK(cached(cache, "c"));
+    CHECK(cached(cache, "d"));
+    CHECK(cache.stats().evictions == 1);
+    CHECK(cache.stats().entries == 3);
+}
+
+// each shard evicts its own least recently used entry, so the capacity is
+// honored globally and an entry that keeps being used is never evicted,
+// whichever shards other keys fall into
+void
+test_lru_eviction_across_shards() {
+
+    constexpr std::size_t num_shards = 4;
+    constexpr std::size_t capacity = 2 * num_shards;
+    constexpr std::size_t num_keys = 100;
+
+    address_cache cache(capacity, num_shards, std::chrono::milliseconds(0));
+
+    const auto hot = make_address();
+    cache.insert("hot", hot);
+
+    for(std::size_t i = 0; i < num_keys; ++i) {
+        cache.insert("key" + std::to_string(i), make_address());
+        CHECK(cache.find(address_key{"hot", {}}).m_address == hot);
+    }
+
+    const auto stats = cache.stats();
+    CHECK(stats.entries == capacity);
+    CHECK(stats.evictions == num_keys + 1 - capacity);
+
+    // the first keys are long gone, the last one is still there
+    CHECK(!cached(cache, "key0"));
+    CHECK(cached(cache, "key" + std::to_string(num_keys - 1)));
+
+    // evicted addresses are only freed once nobody else refers to them
+    const auto held = make_address();
+    address_cache small(1, 1, std::chrono::milliseconds(0));
+    small.insert("held", held);
+    small.insert("other", make_address());
+    CHECK(!cached(small, "held"));
+    CHECK(held.use_count() == 1);
+}
+
+} // anonymous namespace
+
+int
+main() {
+    test_negative_ttl();
+    test_negative_never_replaces_valid();
+    test_lru_eviction();
+    test_lru_eviction_across_shards();
+    return 0;
+}
@@ -0,0 +1,133 @@
+// Unit tests for detail::address_cache_file: round trips and how corrupt
+// or truncated files are handled.
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <hermes.hpp>
+
+#include "check.hpp"
+
+using hermes::detail::address_cache_file;
+
+namespace {
+
+const std::string path = "address_cache_file_test.bin";
+const std::string prefix = "ofi+tcp://";
+
+std::vector<address_cache_file::record>
+sample_records() {
+    return {
+        {"ofi+tcp://host:1", {'a', 'b', 'c'}},
+        {"ofi+tcp://host:2", {}},
+        {"ofi+tcp://host:3", std::vector<char>(1000, '\0')},
+    };
+}
+
+std::string
+read_file() {
+    std::ifstream in(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in),
+            std::istreambuf_iterator<char>()};
+}
+
+void
+write_file(const std::string& contents) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(contents.data(), contents.size());
+}
+
+void
+test_round_trip() {
+
+    const auto records = sample_records();
+
+    address_cache_file::save(path, prefix, records);
+    CHECK(address_cache_file::load(path, prefix) == records);
+
+    // an empty cache is also a valid one
+    address_cache_file::save(path, prefix, {});
+    CHECK(address_cache_file::load(path, prefix).empty());
+
+    // saving replaces the previous contents
+    address_cache_file::save(path, prefix, records);
+    CHECK(address_cache_file::load(path, prefix) == records);
+}
+
+void
+test_ignored_files() {
+
+    std::remove(path.c_str());
+    CHECK(address_cache_file::load(path, prefix).empty());
+
+    // addresses resolved for another transport are of no use
+    address_cache_file::save(path, "ofi+verbs://", sample_records());
+    CHECK(address_cache_file::load(path, prefix).empty());
+}
+
+void
+test_corrupt_files() {
+
+    address_cache_file::save(path, prefix, sample_records());
+    const std::string contents = read_file();
+
+    // wrong magic
+    std::string bad = contents;
+    bad[0] = 'X';
+    write_file(bad);
+    CHECK_THROWS(address_cache_file::load(path, prefix), std::runtime_error);
+
+    // not even a full magic
+    write_file("HRMS");
+    CHECK_THROWS(address_cache_file::load(path, prefix), std::runtime_error);
+
+    // unsupported version
+    bad = contents;
+    bad[8] = static_cast<char>(address_cache_file::version + 1);
+    write_file(bad);
+    CHECK_THROWS(address_cache_file::load(path, prefix), std::runtime_error);
+
+    // a record whose size is absurdly large must be rejected before 
+    // allocating anything
+    bad = contents;
+    const std::size_t first_key_size = 8 + 4 + 4 + prefix.size() + 8;
+    const std::uint32_t huge = 0xffffffff;
+    bad.replace(first_key_size, sizeof(huge),
+                reinterpret_cast<const char*>(&huge), sizeof(huge));
+    write_file(bad);
+    CHECK_THROWS(address_cache_file::load(path, prefix), std::runtime_error);
+}
+
+void
+test_truncated_files() {
+
+    address_cache_file::save(path, prefix, sample_records());
+    const std::string contents = read_file();
+
+    // cutting the file anywhere (but at its end) must be detected
+    for(std::size_t size = 0; size < contents.size(); ++size) {
+        write_file(contents.substr(0, size));
+        CHECK_THROWS(address_cache_file::load(path, prefix), 
+                     std::runtime_error);
+    }
+
+    write_file(contents);
+    CHECK(address_cache_file::load(path, prefix) == sample_records());
+}
+
+} // anonymous namespace
+
+int
+main() {
+    test_round_trip();
+    test_ignored_files();
+    test_corrupt_files();
+    test_truncated_files();
+    std::remove(path.c_str());
+    return 0;
+}
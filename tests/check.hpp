@@ -0,0 +1,36 @@
+#ifndef __HERMES_TESTS_CHECK_HPP__
+#define __HERMES_TESTS_CHECK_HPP__
+
+// C++ includes
+#include <cstdlib>
+#include <iostream>
+
+// Minimal assertions for the unit tests in this directory: a failed check
+// is reported and makes the test program exit with a non-zero status
+#define CHECK(expr)                                                         \
+    do {                                                                    \
+        if(!(expr)) {                                                       \
+            std::cerr << __FILE__ << ":" << __LINE__                        \
+                      << ": check failed: " #expr "\n";                     \
+            std::exit(EXIT_FAILURE);                                        \
+        }                                                                   \
+    } while(0)
+
+// Check that evaluating @a expr throws an exception of type @a type
+#define CHECK_THROWS(expr, type)                                            \
+    do {                                                                    \
+        bool thrown = false;                                                \
+        try {                                                               \
+            (void) (expr);                                                  \
+        }                                                                   \
+        catch(const type&) {                                                \
+            thrown = true;                                                  \
+        }                                                                   \
+        if(!thrown) {                                                       \
+            std::cerr << __FILE__ << ":" << __LINE__                        \
+                      << ": expected " #type " from: " #expr "\n";          \
+            std::exit(EXIT_FAILURE);                                        \
+        }                                                                   \
+    } while(0)
+
+#endif // __HERMES_TESTS_CHECK_HPP__
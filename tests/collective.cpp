@@ -0,0 +1,219 @@
+// Unit tests for the bookkeeping of collective operations: messages
+// delivered to a collective_mailbox before or after the receiver asks for
+// them, messages of different operations and steps kept apart, operations
+// numbered per group, and collective_sends waiting for acknowledgements.
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <hermes.hpp>
+
+#include "check.hpp"
+
+using hermes::detail::collective_key;
+using hermes::detail::collective_mailbox;
+using hermes::detail::collective_sends;
+
+namespace {
+
+std::chrono::steady_clock::time_point
+in(std::chrono::milliseconds ms) {
+    return std::chrono::steady_clock::now() + ms;
+}
+
+const auto long_wait = std::chrono::milliseconds(10000);
+const auto short_wait = std::chrono::milliseconds(20);
+
+collective_key
+make_key(hg_uint64_t tag, hg_uint32_t size, hg_uint64_t sequence,
+         hg_uint32_t step, hg_uint32_t source) {
+    collective_key key;
+    key.m_tag = tag;
+    key.m_size = size;
+    key.m_sequence = sequence;
+    key.m_step = step;
+    key.m_source = source;
+    return key;
+}
+
+std::vector<char>
+bytes(const char* s) {
+    return std::vector<char>(s, s + std::char_traits<char>::length(s));
+}
+
+// a message can arrive before its receiver reaches the step it belongs to
+void
+test_deliver_then_take() {
+
+    collective_mailbox mbox;
+    const auto key = make_key(1, 4, 0, 0, 2);
+
+    mbox.deliver(key, bytes("early"));
+    CHECK(mbox.take(key, in(long_wait)) == bytes("early"));
+
+    // messages are consumed once taken
+    CHECK_THROWS(mbox.take(key, in(short_wait)), std::runtime_error);
+}
+
+void
+test_take_then_deliver() {
+
+    collective_mailbox mbox;
+    const auto key = make_key(1, 4, 0, 1, 3);
+
+    std::thread sender([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        mbox.deliver(key, bytes("late"));
+    });
+
+    CHECK(mbox.take(key, in(long_wait)) == bytes("late"));
+    sender.join();
+}
+
+void
+test_timeout() {
+
+    collective_mailbox mbox;
+
+    // messages for other keys don't satisfy the wait
+    mbox.deliver(make_key(1, 4, 0, 0, 1), bytes("other"));
+
+    const auto start = std::chrono::steady_clock::now();
+    CHECK_THROWS(mbox.take(make_key(1, 4, 0, 0, 2), in(short_wait)),
+                 std::runtime_error);
+    CHECK(std::chrono::steady_clock::now() - start >= short_wait);
+}
+
+// every field of the key tells messages apart
+void
+test_keys_are_distinct() {
+
+    collective_mailbox mbox;
+
+    const std::vector<collective_key> keys = {
+        make_key(1, 4, 0, 0, 0),
+        make_key(2, 4, 0, 0, 0),
+        make_key(1, 5, 0, 0, 0),
+        make_key(1, 4, 1, 0, 0),
+        make_key(1, 4, 0, 1, 0),
+        make_key(1, 4, 0, 0, 1),
+    };
+
+    for(std::size_t i = 0; i < keys.size(); ++i) {
+        mbox.deliver(keys[i], std::vector<char>(1, static_cast<char>(i)));
+    }
+
+    // take them in reverse order to make sure none was overwritten
+    for(std::size_t i = keys.size(); i-- > 0;) {
+        CHECK(mbox.take(keys[i], in(long_wait)) ==
+              std::vector<char>(1, static_cast<char>(i)));
+    }
+}
+
+void
+test_many_senders() {
+
+    constexpr hg_uint32_t ranks = 16;
+    collective_mailbox mbox;
+    std::vector<std::thread> senders;
+
+    for(hg_uint32_t r = 0; r < ranks; ++r) {
+        senders.emplace_back([&mbox, r]() {
+            mbox.deliver(make_key(7, ranks, 3, 0, r),
+                         std::vector<char>(r, 'x'));
+        });
+    }
+
+    for(hg_uint32_t r = ranks; r-- > 0;) {
+        CHECK(mbox.take(make_key(7, ranks, 3, 0, r), in(long_wait)) ==
+              std::vector<char>(r, 'x'));
+    }
+
+    for(auto& t : senders) {
+        t.join();
+    }
+}
+
+void
+test_sequences() {
+
+    collective_mailbox mbox;
+
+    CHECK(mbox.next_sequence(1, 4) == 0);
+    CHECK(mbox.next_sequence(1, 4) == 1);
+
+    // groups with a different tag or size are numbered independently
+    CHECK(mbox.next_sequence(2, 4) == 0);
+    CHECK(mbox.next_sequence(1, 8) == 0);
+
+    CHECK(mbox.next_sequence(1, 4) == 2);
+}
+
+void
+test_sends() {
+
+    // nothing sent
+    {
+        collective_sends sends;
+        sends.wait_until(in(short_wait));
+    }
+
+    // acknowledgements arriving from other threads
+    {
+        collective_sends sends;
+        std::vector<std::thread> acks;
+
+        for(int i = 0; i < 8; ++i) {
+            sends.start();
+            acks.emplace_back([&sends]() {
+                sends.complete(std::exception_ptr{});
+            });
+        }
+
+        sends.wait_until(in(long_wait));
+
+        for(auto& t : acks) {
+            t.join();
+        }
+    }
+
+    // the first error is reported once all sends are acknowledged
+    {
+        collective_sends sends;
+        sends.start();
+        sends.start();
+        sends.start();
+
+        sends.complete(std::exception_ptr{});
+        sends.complete(std::make_exception_ptr(
+                std::invalid_argument("first")));
+        sends.complete(std::make_exception_ptr(
+                std::runtime_error("second")));
+
+        CHECK_THROWS(sends.wait_until(in(long_wait)), std::invalid_argument);
+    }
+
+    // missing acknowledgements
+    {
+        collective_sends sends;
+        sends.start();
+        CHECK_THROWS(sends.wait_until(in(short_wait)), std::runtime_error);
+        sends.complete(std::exception_ptr{});
+    }
+}
+
+} // namespace
+
+int
+main() {
+    test_deliver_then_take();
+    test_take_then_deliver();
+    test_timeout();
+    test_keys_are_distinct();
+    test_many_senders();
+    test_sequences();
+    test_sends();
+}
@@ -0,0 +1,205 @@
+// Unit tests for completion queues. Completions are pushed directly to the
+// shared state of a queue (as the contexts of completed RPCs do), so no
+// network is needed: results are delivered in completion order, in-flight
+// RPCs are accounted for, and waiters are woken up when the last in-flight
+// RPC goes away without producing a completion.
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <hermes.hpp>
+
+#include "check.hpp"
+
+namespace {
+
+// completion queues only care about the output of a request
+struct test_rpc {
+    using output_type = int;
+};
+
+using queue = hermes::completion_queue<test_rpc>;
+using state = hermes::detail::completion_queue_state<test_rpc>;
+using completion = queue::completion;
+
+void
+test_idle_queue() {
+
+    queue q;
+    completion c;
+
+    CHECK(q.empty());
+    CHECK(q.in_flight() == 0);
+    CHECK(q.ready() == 0);
+    CHECK(!q.try_pop(c));
+
+    // nothing can ever complete, so waiting must not block
+    const auto start = std::chrono::steady_clock::now();
+    CHECK(!q.pop_for(c, std::chrono::seconds(10)));
+    CHECK(std::chrono::steady_clock::now() - start <
+          std::chrono::seconds(5));
+
+    CHECK_THROWS(q.pop(), std::logic_error);
+}
+
+void
+test_handle_ids() {
+
+    state s;
+    std::vector<std::uint64_t> ids;
+
+    for(int i = 0; i < 4; ++i) {
+        ids.push_back(s.next_handle_id());
+    }
+
+    for(std::size_t i = 1; i < ids.size(); ++i) {
+        CHECK(ids[i] != ids[i - 1]);
+    }
+}
+
+void
+test_completion_order() {
+
+    state s;
+    s.add_in_flight(3);
+
+    // RPCs complete in a different order than the one they were posted in
+    s.push({2, 0, hermes::result<int>(20)});
+    s.push({0, 0, hermes::result<int>(0)});
+    s.push({1, 0, hermes::result<int>(10)});
+
+    CHECK(s.m_in_flight == 0);
+    CHECK(s.m_ready.size() == 3);
+
+    const std::uint64_t expected[] = { 2, 0, 1 };
+    completion c;
+
+    for(auto h : expected) {
+        CHECK(s.pop_locked(c));
+        CHECK(c.handle == h);
+        CHECK(c.index == 0);
+        CHECK(c.output.value() == static_cast<int>(h) * 10);
+    }
+
+    CHECK(!s.pop_locked(c));
+}
+
+void
+test_broadcast_indexes() {
+
+    state s;
+    const auto handle = s.next_handle_id();
+    s.add_in_flight(3);
+
+    s.push({handle, 1, hermes::result<int>(1)});
+    s.push({handle, 2, hermes::result<int>(
+            std::make_exception_ptr(std::runtime_error("unreachable")))});
+    s.push({handle, 0, hermes::result<int>(0)});
+
+    completion c;
+
+    CHECK(s.pop_locked(c));
+    CHECK(c.handle == handle && c.index == 1);
+    CHECK(c.output.value() == 1);
+
+    CHECK(s.pop_locked(c));
+    CHECK(c.handle == handle && c.index == 2);
+    CHECK_THROWS(c.output.value(), std::runtime_error);
+
+    CHECK(s.pop_locked(c));
+    CHECK(c.handle == handle && c.index == 0);
+    CHECK(c.output.value() == 0);
+}
+
+// an RPC that can't be posted leaves the queue without producing a
+// completion: anyone waiting must be woken up once nothing is in flight
+void
+test_remove_in_flight_wakes_waiters() {
+
+    state s;
+    s.add_in_flight(1);
+
+    bool woken = false;
+
+    std::thread waiter([&]() {
+        std::unique_lock<std::mutex> lock(s.m_mutex);
+        woken = s.m_cv.wait_for(lock, std::chrono::seconds(10), [&]() {
+            return !s.m_ready.empty() || s.m_in_flight == 0;
+        });
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    s.remove_in_flight();
+    waiter.join();
+
+    CHECK(woken);
+    CHECK(s.m_in_flight == 0);
+    CHECK(s.m_ready.empty());
+}
+
+void
+test_concurrent_completions() {
+
+    constexpr int threads = 8;
+    constexpr int per_thread = 1000;
+
+    state s;
+    s.add_in_flight(threads * per_thread);
+
+    std::vector<std::thread> producers;
+
+    for(int t = 0; t < threads; ++t) {
+        producers.emplace_back([&s, t]() {
+            for(int i = 0; i < per_thread; ++i) {
+                s.push({static_cast<std::uint64_t>(t * per_thread + i), 0,
+                        hermes::result<int>(t)});
+            }
+        });
+    }
+
+    // consume while the producers are still running
+    std::vector<bool> seen(threads * per_thread, false);
+    int consumed = 0;
+
+    while(consumed < threads * per_thread) {
+
+        std::unique_lock<std::mutex> lock(s.m_mutex);
+        CHECK(s.m_cv.wait_for(lock, std::chrono::seconds(10), [&]() {
+            return !s.m_ready.empty();
+        }));
+
+        completion c;
+
+        while(s.pop_locked(c)) {
+            CHECK(c.handle < seen.size());
+            CHECK(!seen[c.handle]);
+            CHECK(c.output.value() ==
+                  static_cast<int>(c.handle) / per_thread);
+            seen[c.handle] = true;
+            ++consumed;
+        }
+    }
+
+    for(auto& t : producers) {
+        t.join();
+    }
+
+    CHECK(s.m_in_flight == 0);
+    CHECK(s.m_ready.empty());
+}
+
+} // namespace
+
+int
+main() {
+    test_idle_queue();
+    test_handle_ids();
+    test_completion_order();
+    test_broadcast_indexes();
+    test_remove_in_flight_wakes_waiters();
+    test_concurrent_completions();
+}
@@ -0,0 +1,292 @@
+// Unit tests for reduce_into(): every operation and element type is
+// checked against a plain scalar reference, with each of the SIMD kernels
+// that the CPU supports, for lengths that exercise both the vector loop
+// and the scalar tail, and for unaligned buffers.
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include <hermes/reduce.hpp>
+
+#include "check.hpp"
+
+using hermes::reduce_op;
+
+namespace {
+
+std::mt19937_64 rng(42);
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value, T>::type
+random_value() {
+    return static_cast<T>(rng());
+}
+
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value, T>::type
+random_value() {
+    return std::uniform_real_distribution<T>(-1e6, 1e6)(rng);
+}
+
+// sums of integers wrap around, also for signed types
+template <typename T>
+T
+reference_sum(T a, T b, std::true_type /* is_integral */) {
+    using U = typename std::make_unsigned<T>::type;
+    return static_cast<T>(static_cast<U>(static_cast<U>(a) + 
+                                         static_cast<U>(b)));
+}
+
+template <typename T>
+T
+reference_sum(T a, T b, std::false_type /* is_integral */) {
+    return a + b;
+}
+
+template <typename T>
+T
+reference_bitwise(reduce_op op, T a, T b, std::true_type /* is_integral */) {
+    switch(op) {
+        case reduce_op::bit_and:
+            return a & b;
+        case reduce_op::bit_or:
+            return a | b;
+        default:
+            return a ^ b;
+    }
+}
+
+template <typename T>
+T
+reference_bitwise(reduce_op, T a, T, std::false_type /* is_integral */) {
+    return a;
+}
+
+template <typename T>
+T
+reference(reduce_op op, T a, T b) {
+    switch(op) {
+        case reduce_op::sum:
+            return reference_sum(a, b, std::is_integral<T>());
+        case reduce_op::min:
+            return b < a ? b : a;
+        case reduce_op::max:
+            return a < b ? b : a;
+        default:
+            return reference_bitwise(op, a, b, std::is_integral<T>());
+    }
+}
+
+template <typename T>
+using kernel = void (*)(reduce_op, T*, const T*, std::size_t);
+
+/** Check @a fn against the reference for @a op, for lengths 0..@a max_n
+ * and for buffers that start at any offset of a vector */
+template <typename T>
+void
+check_kernel(kernel<T> fn, reduce_op op) {
+
+    constexpr std::size_t max_n = 150;
+    constexpr std::size_t max_offset = 64 / sizeof(T);
+
+    for(std::size_t offset = 0; offset < max_offset; offset += 3) {
+        for(std::size_t n = 0; n <= max_n; ++n) {
+
+            std::vector<T> acc(offset + n + 1);
+            std::vector<T> src(offset + n + 1);
+
+            for(std::size_t i = 0; i < acc.size(); ++i) {
+                acc[i] = random_value<T>();
+                src[i] = random_value<T>();
+            }
+
+            // make sure that min/max also see equal elements
+            if(n != 0) {
+                src[offset] = acc[offset];
+            }
+
+            std::vector<T> expected(acc);
+
+            for(std::size_t i = 0; i < n; ++i) {
+                expected[offset + i] = 
+                    reference(op, acc[offset + i], src[offset + i]);
+            }
+
+            fn(op, acc.data() + offset, src.data() + offset, n);
+
+            // elements past the end must be left untouched
+            CHECK(acc == expected);
+        }
+    }
+}
+
+// wrappers with the signature of reduce_into() for each kernel, so that 
+// the kernels for each instruction set can be tested on their own
+template <typename T, template <typename, typename> class Kernel>
+struct dispatch {
+
+    static void
+    run(reduce_op op, T* acc, const T* src, std::size_t n) {
+
+        using namespace hermes::detail;
+
+        switch(op) {
+            case reduce_op::sum:
+                return sum(acc, src, n, std::is_integral<T>());
+            case reduce_op::min:
+                return Kernel<T, op_min>::run(acc, src, n);
+            case reduce_op::max:
+                return Kernel<T, op_max>::run(acc, src, n);
+            default:
+                return bitwise(op, acc, src, n, std::is_integral<T>());
+        }
+    }
+
+    static void
+    sum(T* acc, const T* src, std::size_t n, std::true_type) {
+        using U = typename std::make_unsigned<T>::type;
+        Kernel<U, hermes::detail::op_sum>::run(
+                reinterpret_cast<U*>(acc), 
+                reinterpret_cast<const U*>(src), n);
+    }
+
+    static void
+    sum(T* acc, const T* src, std::size_t n, std::false_type) {
+        Kernel<T, hermes::detail::op_sum>::run(acc, src, n);
+    }
+
+    static void
+    bitwise(reduce_op op, T* acc, const T* src, std::size_t n, 
+            std::true_type) {
+
+        using namespace hermes::detail;
+
+        switch(op) {
+            case reduce_op::bit_and:
+                return Kernel<T, op_and>::run(acc, src, n);
+            case reduce_op::bit_or:
+                return Kernel<T, op_or>::run(acc, src, n);
+            default:
+                return Kernel<T, op_xor>::run(acc, src, n);
+        }
+    }
+
+    static void
+    bitwise(reduce_op, T*, const T*, std::size_t, std::false_type) { }
+};
+
+template <typename T, typename Op>
+struct portable_kernel {
+    static void
+    run(T* acc, const T* src, std::size_t n) {
+        hermes::detail::reduce_portable<T, Op>(acc, src, n);
+    }
+};
+
+#ifdef HERMES_SIMD_DISPATCH
+template <typename T, typename Op>
+struct sse2_kernel {
+    static void
+    run(T* acc, const T* src, std::size_t n) {
+        hermes::detail::reduce_sse2<T, Op>(acc, src, n);
+    }
+};
+
+template <typename T, typename Op>
+struct avx2_kernel {
+    static void
+    run(T* acc, const T* src, std::size_t n) {
+        hermes::detail::reduce_avx2<T, Op>(acc, src, n);
+    }
+};
+
+template <typename T, typename Op>
+struct avx512_kernel {
+    static void
+    run(T* acc, const T* src, std::size_t n) {
+        hermes::detail::reduce_avx512<T, Op>(acc, src, n);
+    }
+};
+#endif // HERMES_SIMD_DISPATCH
+
+template <typename T>
+void
+test_type() {
+
+    std::vector<reduce_op> ops = {
+        reduce_op::sum, reduce_op::min, reduce_op::max
+    };
+
+    if(std::is_integral<T>::value) {
+        ops.insert(ops.end(), {reduce_op::bit_and, reduce_op::bit_or,
+                               reduce_op::bit_xor});
+    }
+
+    for(const auto op : ops) {
+
+        check_kernel<T>(&hermes::reduce_into<T>, op);
+        check_kernel<T>(&dispatch<T, portable_kernel>::run, op);
+
+#ifdef HERMES_SIMD_DISPATCH
+        using hermes::detail::simd_isa;
+        const auto isa = hermes::detail::detected_simd_isa();
+
+        if(isa >= simd_isa::sse2) {
+            check_kernel<T>(&dispatch<T, sse2_kernel>::run, op);
+        }
+
+        if(isa >= simd_isa::avx2) {
+            check_kernel<T>(&dispatch<T, avx2_kernel>::run, op);
+        }
+
+        if(isa >= simd_isa::avx512) {
+            check_kernel<T>(&dispatch<T, avx512_kernel>::run, op);
+        }
+#endif // HERMES_SIMD_DISPATCH
+    }
+}
+
+void
+test_signed_wraparound() {
+
+    std::int32_t acc[] = {std::numeric_limits<std::int32_t>::max(),
+                          std::numeric_limits<std::int32_t>::min()};
+    const std::int32_t src[] = {1, -1};
+
+    hermes::reduce_into(reduce_op::sum, acc, src, 2);
+
+    CHECK(acc[0] == std::numeric_limits<std::int32_t>::min());
+    CHECK(acc[1] == std::numeric_limits<std::int32_t>::max());
+}
+
+void
+test_invalid_ops() {
+    double acc = 0;
+    const double src = 1;
+    CHECK_THROWS(hermes::reduce_into(reduce_op::bit_xor, &acc, &src, 1),
+                 std::invalid_argument);
+}
+
+} // anonymous namespace
+
+int
+main() {
+    test_type<std::int8_t>();
+    test_type<std::uint8_t>();
+    test_type<std::int16_t>();
+    test_type<std::uint16_t>();
+    test_type<std::int32_t>();
+    test_type<std::uint32_t>();
+    test_type<std::int64_t>();
+    test_type<std::uint64_t>();
+    test_type<float>();
+    test_type<double>();
+    test_signed_wraparound();
+    test_invalid_ops();
+    return 0;
+}
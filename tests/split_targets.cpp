@@ -0,0 +1,79 @@
+// Unit tests for detail::split_targets(), which splits the targets of a
+// relayed broadcast into the subtrees handed to each relay: every target
+// belongs to exactly one group, there are never more groups than the
+// fanout, and group sizes differ by at most one.
+
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <vector>
+
+#include <hermes.hpp>
+
+#include "check.hpp"
+
+using hermes::detail::split_targets;
+
+namespace {
+
+void
+check_split(std::size_t count, std::size_t fanout) {
+
+    const std::vector<std::size_t> sizes = split_targets(count, fanout);
+
+    CHECK(sizes.size() == std::min(count, fanout));
+    CHECK(std::accumulate(sizes.begin(), sizes.end(), std::size_t{0}) ==
+          count);
+
+    if(sizes.empty()) {
+        return;
+    }
+
+    // no empty subtrees, and larger groups come first so that the
+    // first targets are never deeper in the tree than the last ones
+    CHECK(sizes.back() > 0);
+    CHECK(std::is_sorted(sizes.rbegin(), sizes.rend()));
+    CHECK(sizes.front() - sizes.back() <= 1);
+}
+
+void
+test_examples() {
+
+    CHECK(split_targets(10, 3) == (std::vector<std::size_t>{ 4, 3, 3 }));
+    CHECK(split_targets(9, 3) == (std::vector<std::size_t>{ 3, 3, 3 }));
+    CHECK(split_targets(2, 4) == (std::vector<std::size_t>{ 1, 1 }));
+    CHECK(split_targets(7, 1) == (std::vector<std::size_t>{ 7 }));
+}
+
+// a relay with no targets left below it doesn't forward anything
+void
+test_no_targets() {
+    CHECK(split_targets(0, 1).empty());
+    CHECK(split_targets(0, 8).empty());
+}
+
+void
+test_exhaustive() {
+    for(std::size_t count = 0; count <= 200; ++count) {
+        for(std::size_t fanout = 1; fanout <= 40; ++fanout) {
+            check_split(count, fanout);
+        }
+    }
+}
+
+void
+test_large() {
+    check_split(1000003, 2);
+    check_split(1000003, 64);
+    check_split(64, 1000003);
+}
+
+} // namespace
+
+int
+main() {
+    test_examples();
+    test_no_targets();
+    test_exhaustive();
+    test_large();
+}
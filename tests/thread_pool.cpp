@@ -0,0 +1,241 @@
+// Unit tests for thread_pool: tasks submitted from outside the pool and 
+// from its workers all run, idle workers steal tasks from busy ones, no
+// wakeup is lost, queued tasks are drained at shutdown, and move-only 
+// callables are supported.
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+#include <hermes/thread_pool.hpp>
+
+#include "check.hpp"
+
+using hermes::thread_pool;
+
+namespace {
+
+// long enough to never expire unless a task is really lost
+constexpr std::chrono::seconds timeout(10);
+
+/** Counts down completed tasks and lets a thread wait for all of them */
+class latch {
+
+public:
+    explicit latch(std::size_t count) :
+        m_count(count) { }
+
+    void
+    count_down() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if(--m_count == 0) {
+            m_cv.notify_all();
+        }
+    }
+
+    bool
+    wait_for(std::chrono::seconds t) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_cv.wait_for(lock, t, [this]() { return m_count == 0; });
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::size_t m_count;
+};
+
+void
+test_external_submissions() {
+
+    constexpr std::size_t num_tasks = 10000;
+
+    thread_pool pool(4);
+    latch done(num_tasks);
+    std::atomic<std::size_t> runs(0);
+
+    for(std::size_t i = 0; i < num_tasks; ++i) {
+        pool.submit([&]() {
+            ++runs;
+            done.count_down();
+        });
+    }
+
+    CHECK(done.wait_for(timeout));
+    CHECK(runs == num_tasks);
+}
+
+// each task submits two more from inside the pool until the tree is 
+// complete, so most tasks go to the submitting worker's own queue
+void
+spawn(thread_pool& pool, std::size_t depth, latch& done) {
+
+    if(depth != 0) {
+        pool.submit([&pool, depth, &done]() { spawn(pool, depth - 1, done); });
+        pool.submit([&pool, depth, &done]() { spawn(pool, depth - 1, done); });
+    }
+
+    done.count_down();
+}
+
+void
+test_worker_submissions() {
+
+    constexpr std::size_t depth = 12;
+    constexpr std::size_t num_tasks = (std::size_t(1) << (depth + 1)) - 1;
+
+    thread_pool pool(4);
+    latch done(num_tasks);
+
+    pool.submit([&pool, &done]() { spawn(pool, depth, done); });
+
+    CHECK(done.wait_for(timeout));
+}
+
+// a worker queues tasks on itself and then blocks until they have run, 
+// which can only happen if other workers steal them
+void
+test_stealing() {
+
+    constexpr std::size_t num_tasks = 16;
+
+    thread_pool pool(2);
+    latch stolen(num_tasks);
+    latch finished(1);
+    std::atomic<bool> ok(false);
+
+    pool.submit([&]() {
+        for(std::size_t i = 0; i < num_tasks; ++i) {
+            pool.submit([&]() { stolen.count_down(); });
+        }
+
+        ok = stolen.wait_for(timeout);
+        finished.count_down();
+    });
+
+    CHECK(finished.wait_for(timeout));
+    CHECK(ok);
+}
+
+// workers go to sleep between tasks: a lost wakeup (i.e. a task submitted
+// while a worker is deciding whether to sleep) would leave a task behind
+void
+test_no_lost_wakeups() {
+
+    constexpr std::size_t rounds = 20000;
+
+    thread_pool pool(2);
+
+    for(std::size_t i = 0; i < rounds; ++i) {
+        latch done(1);
+        pool.submit([&done]() { done.count_down(); });
+        CHECK(done.wait_for(timeout));
+    }
+}
+
+void
+test_drain_at_shutdown() {
+
+    constexpr std::size_t num_tasks = 1000;
+
+    std::atomic<std::size_t> runs(0);
+
+    {
+        thread_pool pool(1);
+        latch started(1);
+        std::mutex gate;
+        std::unique_lock<std::mutex> closed(gate);
+
+        // keep the only worker busy so that everything else stays queued
+        pool.submit([&]() {
+            started.count_down();
+            std::lock_guard<std::mutex> lock(gate);
+            ++runs;
+        });
+
+        CHECK(started.wait_for(timeout));
+
+        for(std::size_t i = 0; i < num_tasks; ++i) {
+            pool.submit([&runs]() { ++runs; });
+        }
+
+        closed.unlock();
+    }
+
+    CHECK(runs == num_tasks + 1);
+}
+
+// a callable that can only be moved
+struct move_only_task {
+
+    move_only_task(std::unique_ptr<int> value, 
+                   std::atomic<int>& sum, 
+                   latch& done) :
+        m_value(std::move(value)),
+        m_sum(sum),
+        m_done(done) { }
+
+    move_only_task(move_only_task&&) = default;
+    move_only_task(const move_only_task&) = delete;
+
+    void
+    operator()() {
+        m_sum += *m_value;
+        m_done.count_down();
+    }
+
+    std::unique_ptr<int> m_value;
+    std::atomic<int>& m_sum;
+    latch& m_done;
+};
+
+void
+test_move_only_tasks() {
+
+    thread_pool pool(2);
+    std::atomic<int> sum(0);
+    latch done(100);
+
+    for(int i = 0; i < 100; ++i) {
+        pool.submit(move_only_task(std::unique_ptr<int>(new int(i)), 
+                                   sum, done));
+    }
+
+    CHECK(done.wait_for(timeout));
+    CHECK(sum == 99 * 100 / 2);
+}
+
+// an exception escaping a task must not take its worker down
+void
+test_throwing_tasks() {
+
+    thread_pool pool(1);
+    latch done(1);
+
+    pool.submit([]() { throw std::runtime_error("task failed"); });
+    pool.submit([&done]() { done.count_down(); });
+
+    CHECK(done.wait_for(timeout));
+}
+
+} // anonymous namespace
+
+int
+main() {
+
+    CHECK_THROWS(thread_pool(0), std::invalid_argument);
+
+    test_external_submissions();
+    test_worker_submissions();
+    test_stealing();
+    test_no_lost_wakeups();
+    test_drain_at_shutdown();
+    test_move_only_tasks();
+    test_throwing_tasks();
+    return 0;
+}